@@ -0,0 +1,54 @@
+#include <gflags/gflags.h>
+
+#include <fstream>
+#include <iostream>
+
+#include "core/log/logging.h"
+#include "core/memory/coverage.h"
+
+DEFINE_string(output, "", "File to write the merged coverage to");
+DEFINE_string(json, "", "File to write the merged coverage to as json");
+
+// Merges the coverage files given as arguments.
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (argc < 2) {
+    std::cerr << "No coverage files given." << std::endl;
+    return 1;
+  }
+
+  gbeml::Coverage merged(0);
+  for (int i = 1; i < argc; ++i) {
+    gbeml::Coverage coverage(0);
+    if (!gbeml::Coverage::load(argv[i], &coverage)) {
+      std::cerr << "Failed to read " << argv[i] << "." << std::endl;
+      return 1;
+    }
+    if (i == 1) {
+      merged = coverage;
+    } else if (!merged.merge(coverage)) {
+      std::cerr << argv[i] << " is for another rom." << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "executed: " << merged.getExecutedCount()
+            << " bytes, read: " << merged.getReadCount() << " bytes of "
+            << merged.getRomSize() << std::endl;
+
+  if (!FLAGS_output.empty() && !merged.save(FLAGS_output)) {
+    std::cerr << "Failed to write " << FLAGS_output << "." << std::endl;
+    return 1;
+  }
+  if (!FLAGS_json.empty()) {
+    std::ofstream fout(FLAGS_json);
+    merged.writeJson(fout);
+    if (!fout) {
+      std::cerr << "Failed to write " << FLAGS_json << "." << std::endl;
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -1,17 +1,87 @@
 #include <gflags/gflags.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 #include "core/gameboy.h"
 #include "core/log/logging.h"
 #include "driver/sdl/sdl_window.h"
 
 DEFINE_string(filename, "", "Rom filename");
-DEFINE_int32(breakpoint, -1, "PC at breakpoint");
+DEFINE_string(breakpoint, "",
+              "Comma-separated breakpoints, each a pc in hex with an optional "
+              "rom bank prefix (e.g. 150,3:4a2c)");
+DEFINE_bool(log_breakpoints, false,
+            "Log breakpoint hits instead of breaking into the debugger");
 DEFINE_bool(stub, false, "Use stub display");
 DEFINE_bool(sdl, false, "Use sdl display");
 DEFINE_int32(n_frame, -1, "Number of frames to update");
+DEFINE_bool(lazy_flags, false, "Evaluate cpu flags lazily");
+DEFINE_bool(alu_tables, false, "Use precomputed alu tables");
+DEFINE_string(accuracy, "tcycle",
+              "Timing accuracy: tcycle, mcycle or instruction (fastest, "
+              "renders whole scanlines)");
+DEFINE_bool(block_cache, false, "Fetch instructions from a decoded code cache");
+DEFINE_bool(jit, false, "Translate hot code to native code");
+DEFINE_bool(jit_differential, false,
+            "Check translated code against the interpreter");
+DEFINE_bool(fast_forward_halt, true,
+            "Skip ahead to the next interrupt while the cpu is halted");
+DEFINE_int32(cpu_clock_multiplier, 1,
+             "Cpu cycles per cycle of the rest of the system, above 1 to "
+             "overclock the cpu");
+DEFINE_bool(skip_idle_loops, false,
+            "Skip loops polling for a change up to when it may happen");
+DEFINE_string(aot_library, "",
+              "Shared library built from gbeml_recompile output for the rom");
+DEFINE_bool(analyze_rom, false,
+            "Decode the reachable code of the rom into the block cache at "
+            "load");
+DEFINE_int32(trace_size, 0,
+             "Number of instructions kept in the trace, 0 to disable tracing");
+DEFINE_string(trace_file, "gbeml.trace",
+              "File the trace is dumped to at exit, on a crash or on SIGUSR1. "
+              "Read it with gbeml_trace");
+DEFINE_string(profile_report, "",
+              "File to write the cycles spent per guest pc and label to");
+DEFINE_string(profile_folded, "",
+              "File to write guest call stacks to, for flamegraph.pl");
+DEFINE_string(symbols, "", "RGBDS .sym file to label profiles with");
+DEFINE_string(coverage_file, "",
+              "File to write the rom bytes executed and read to. Merge and "
+              "export them with gbeml_coverage");
+
+namespace {
+
+gbeml::TraceBuffer *trace = nullptr;
+// FLAGS_trace_file, copied before the handlers are installed. A std::string
+// is not safe to touch from a signal handler.
+char trace_path[PATH_MAX];
+
+void dumpTrace(int signal) {
+  int fd = open(trace_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd >= 0) {
+    trace->dump(fd);
+    close(fd);
+  }
+  if (signal != SIGUSR1) {
+    std::signal(signal, SIG_DFL);
+    std::raise(signal);
+  }
+}
+
+}  // namespace
 
 void runSdl(gbeml::GameBoy *gb) {
   gbeml::SdlWindow window(gb);
@@ -38,13 +108,54 @@ void runSdl(gbeml::GameBoy *gb) {
 }
 
 void runStub(gbeml::GameBoy *gb) {
+  auto start = std::chrono::steady_clock::now();
+
   int n = FLAGS_n_frame;
   while (n > 0) {
-    for (int i = 0; i < 70224; ++i) {
-      gb->tick();
-    }
+    gb->advance(70224);
     n--;
   }
+
+  auto end = std::chrono::steady_clock::now();
+  double elapsed = std::chrono::duration<double>(end - start).count();
+  gbeml::u64 instructions = gb->getCpu()->getRetiredInstructions();
+  std::cout << "frames: " << FLAGS_n_frame << ", elapsed: " << elapsed
+            << "s, frames/s: " << FLAGS_n_frame / elapsed
+            << ", instructions/s: " << instructions / elapsed << std::endl;
+
+  if (FLAGS_skip_idle_loops) {
+    std::cout << "skipped idle cycles: "
+              << gb->getCpu()->getSkippedIdleCycles() << std::endl;
+  }
+}
+
+bool parseHex(const std::string &text, gbeml::u32 max, gbeml::u32 *value) {
+  char *end;
+  unsigned long n = std::strtoul(text.c_str(), &end, 16);
+  if (text.empty() || *end != '\0' || n > max) {
+    return false;
+  }
+  *value = n;
+  return true;
+}
+
+bool addBreakpoints(gbeml::Cpu *cpu, const std::string &list) {
+  std::stringstream ss(list);
+  std::string item;
+  while (std::getline(ss, item, ',')) {
+    std::size_t colon = item.find(':');
+    gbeml::u32 bank = gbeml::Breakpoints::kAnyBank;
+    gbeml::u32 addr;
+    if (colon != std::string::npos &&
+        !parseHex(item.substr(0, colon), 0x1ff, &bank)) {
+      return false;
+    }
+    if (!parseHex(item.substr(colon + 1), 0xffff, &addr)) {
+      return false;
+    }
+    cpu->addBreakpoint(addr, bank);
+  }
+  return true;
 }
 
 int main(int argc, char *argv[]) {
@@ -56,16 +167,69 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  int breakpoint;
-  std::stringstream ss;
-  ss << std::hex << FLAGS_breakpoint;
-  ss >> breakpoint;
+  gbeml::GameBoyOptions options;
+  options.lazy_flags = FLAGS_lazy_flags;
+  options.alu_tables = FLAGS_alu_tables;
+  if (FLAGS_accuracy == "tcycle") {
+    options.accuracy = gbeml::Accuracy::TCycle;
+  } else if (FLAGS_accuracy == "mcycle") {
+    options.accuracy = gbeml::Accuracy::MCycle;
+  } else if (FLAGS_accuracy == "instruction") {
+    options.accuracy = gbeml::Accuracy::Instruction;
+  } else {
+    std::cerr << "Unknown accuracy " << FLAGS_accuracy << "." << std::endl;
+    return 1;
+  }
+  options.block_cache = FLAGS_block_cache;
+  options.jit = FLAGS_jit;
+  options.jit_differential = FLAGS_jit_differential;
+  options.fast_forward_halt = FLAGS_fast_forward_halt;
+  options.skip_idle_loops = FLAGS_skip_idle_loops;
+  if (FLAGS_cpu_clock_multiplier < 1) {
+    std::cerr << "cpu_clock_multiplier must be at least 1." << std::endl;
+    return 1;
+  }
+  options.cpu_clock_multiplier = FLAGS_cpu_clock_multiplier;
+  options.aot_library = FLAGS_aot_library;
+  options.analyze_rom = FLAGS_analyze_rom;
+  options.coverage = !FLAGS_coverage_file.empty();
 
-  gbeml::GameBoy gb(breakpoint);
+  gbeml::GameBoy gb(options);
   if (!gb.init(FLAGS_filename)) {
     std::cerr << "Failed to initialize gb." << std::endl;
     return 1;
   }
+  if (!addBreakpoints(gb.getCpu(), FLAGS_breakpoint)) {
+    std::cerr << "Invalid breakpoint: " << FLAGS_breakpoint << std::endl;
+    return 1;
+  }
+  if (FLAGS_trace_size > 0) {
+    if (FLAGS_trace_file.size() >= sizeof(trace_path)) {
+      std::cerr << "trace_file is too long." << std::endl;
+      return 1;
+    }
+    std::strcpy(trace_path, FLAGS_trace_file.c_str());
+    trace = new gbeml::TraceBuffer(FLAGS_trace_size);
+    gb.getCpu()->setTrace(trace);
+    for (int signal : {SIGSEGV, SIGABRT, SIGFPE, SIGUSR1}) {
+      std::signal(signal, dumpTrace);
+    }
+  }
+  gbeml::Profiler *profiler = nullptr;
+  if (!FLAGS_profile_report.empty() || !FLAGS_profile_folded.empty()) {
+    profiler = new gbeml::Profiler();
+    if (!FLAGS_symbols.empty() && !profiler->loadSymbols(FLAGS_symbols)) {
+      std::cerr << "Failed to read " << FLAGS_symbols << "." << std::endl;
+      return 1;
+    }
+    gb.getCpu()->setProfiler(profiler);
+  }
+  if (FLAGS_log_breakpoints) {
+    gb.getCpu()->setBreakpointCallback([](gbeml::u16 addr, gbeml::u32 bank) {
+      std::cout << "breakpoint: " << std::hex << bank << ":" << addr
+                << std::dec << std::endl;
+    });
+  }
   std::cout << "GB init OK" << std::endl;
 
   if (FLAGS_stub) {
@@ -74,6 +238,22 @@ int main(int argc, char *argv[]) {
     runSdl(&gb);
   }
 
+  if (!FLAGS_profile_report.empty()) {
+    std::ofstream fout(FLAGS_profile_report);
+    profiler->writeReport(fout, 100);
+  }
+  if (!FLAGS_profile_folded.empty()) {
+    std::ofstream fout(FLAGS_profile_folded);
+    profiler->writeFoldedStacks(fout);
+  }
+  if (!FLAGS_coverage_file.empty() &&
+      !gb.getCoverage()->save(FLAGS_coverage_file)) {
+    std::cerr << "Failed to write " << FLAGS_coverage_file << "." << std::endl;
+  }
+  if (trace != nullptr && !trace->save(FLAGS_trace_file)) {
+    std::cerr << "Failed to write " << FLAGS_trace_file << "." << std::endl;
+  }
+
   std::cout << "OK" << std::endl;
   return 0;
 }
@@ -0,0 +1,44 @@
+#include <gflags/gflags.h>
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "core/cpu/recompiler.h"
+#include "core/log/logging.h"
+#include "core/memory/rom.h"
+
+DEFINE_string(filename, "", "Rom filename");
+DEFINE_string(output, "", "Output C++ filename");
+
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  if (FLAGS_filename.empty() || FLAGS_output.empty()) {
+    std::cerr << "Rom and output filenames are required." << std::endl;
+    return 1;
+  }
+
+  gbeml::Rom rom;
+  rom.load(FLAGS_filename);
+  if (!rom.isValid()) {
+    std::cerr << "Invalid rom." << std::endl;
+    return 1;
+  }
+
+  gbeml::Recompiler recompiler(rom);
+  std::ofstream fout(FLAGS_output);
+  if (!fout) {
+    std::cerr << "Failed to open " << FLAGS_output << "." << std::endl;
+    return 1;
+  }
+  std::vector<gbeml::RecompiledBlock> blocks = recompiler.recompile();
+  fout << recompiler.generate(blocks);
+
+  std::cout << "Recompiled " << blocks.size()
+            << " blocks. Build with:" << std::endl
+            << "  c++ -std=c++20 -O2 -shared -fPIC -Isrc " << FLAGS_output
+            << " -o rom.so" << std::endl;
+  return 0;
+}
@@ -0,0 +1,45 @@
+#include <gflags/gflags.h>
+
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "core/cpu/decoder.h"
+#include "core/cpu/disassembler.h"
+#include "core/cpu/trace.h"
+#include "core/log/logging.h"
+
+DEFINE_string(filename, "", "Trace filename");
+DEFINE_uint64(last, 0, "Number of last entries to print, 0 for all");
+
+int main(int argc, char *argv[]) {
+  google::InitGoogleLogging(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+
+  std::vector<gbeml::TraceEntry> entries;
+  if (!gbeml::TraceBuffer::load(FLAGS_filename, &entries)) {
+    std::cerr << "Failed to read trace " << FLAGS_filename << "." << std::endl;
+    return 1;
+  }
+
+  std::size_t start = 0;
+  if (FLAGS_last > 0 && FLAGS_last < entries.size()) {
+    start = entries.size() - FLAGS_last;
+  }
+  for (std::size_t i = start; i < entries.size(); ++i) {
+    const gbeml::TraceEntry &entry = entries[i];
+    const gbeml::Registers &r = entry.regs;
+    gbeml::u8 length = gbeml::getInstructionLength(entry.code[0]);
+    char bytes[10] = "";
+    for (gbeml::u8 j = 0; j < length; ++j) {
+      std::snprintf(bytes + 3 * j, 4, "%02x ", entry.code[j]);
+    }
+    std::printf(
+        "%12llu %02x:%04x  %-9s %-20s a=%02x f=%02x bc=%04x de=%04x "
+        "hl=%04x sp=%04x ime=%d\n",
+        static_cast<unsigned long long>(entry.cycle), entry.bank, r.pc, bytes,
+        gbeml::disassemble(entry.code, r.pc).c_str(), r.a, r.f, r.bc(), r.de(),
+        r.hl(), r.sp, entry.ime);
+  }
+  return 0;
+}
@@ -78,7 +78,7 @@ void releaseButton(int id) {
 void mainLoop() { window->runLoop(); }
 
 int main(int argc, char *argv[]) {
-  gb = new gbeml::GameBoy(-1);
+  gb = new gbeml::GameBoy();
   if (!gb->init("/rom/PLUTOS_CORNER.gb")) {
     std::cerr << "Failed to initialize gb." << std::endl;
     return 1;
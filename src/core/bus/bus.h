@@ -10,7 +10,23 @@ class Bus {
   virtual ~Bus() {}
   virtual u8 read(u16 addr) const = 0;
   virtual void write(u16 addr, u8 value) = 0;
+  // Reads addr without side effects, such as coverage marks, for debugging
+  // tools. Oam dma does not block it.
+  virtual u8 peek(u16 addr) const { return read(addr); }
+  // Returns the number of the rom bank mapped at addr (<= 0x7fff).
+  virtual u32 getRomBank(u16 addr) const = 0;
   virtual void tick() = 0;
+  // Equivalent to calling tick() n times.
+  virtual void advance(u64 n) = 0;
+  // Lower bound on the number of tick() calls of the whole system before the
+  // value read at addr may change other than by a cpu write or an interrupt
+  // handler. 0 if unknown.
+  virtual u64 getCyclesUntilChange(u16 addr) const = 0;
+  // Whether oam dma keeps the cpu from reading addr, so that it reads the
+  // bytes dma transfers instead.
+  virtual bool isBlockedByDma([[maybe_unused]] u16 addr) const {
+    return false;
+  }
 };
 
 }  // namespace gbeml
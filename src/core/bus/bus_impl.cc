@@ -2,11 +2,53 @@
 
 #include "core/log/logging.h"
 
+#include <algorithm>
 #include <iostream>
 
 namespace gbeml {
 
 u8 BusImpl::read(u16 addr) const {
+  const u8* page = read_pages[addr >> 8];
+  if (page != nullptr) {
+    return page[addr & 0xff];
+  }
+  return readSlow(addr);
+}
+
+void BusImpl::write(u16 addr, u8 value) {
+  u8* page = write_pages[addr >> 8];
+  if (page != nullptr) {
+    page[addr & 0xff] = value;
+    return;
+  }
+  writeSlow(addr, value);
+}
+
+u8 BusImpl::readSlow(u16 addr) const {
+  if (isBlockedByDma(addr)) {
+    if (addr >= 0xfe00) {
+      return 0xff;
+    }
+    return dma_data[std::min<u32>((dma_length - dma_cycles) * 160 / dma_length,
+                                  159)];
+  }
+  return readMemory(addr);
+}
+
+u8 BusImpl::peek(u16 addr) const {
+  const u8* page = read_pages[addr >> 8];
+  if (page != nullptr) {
+    return page[addr & 0xff];
+  }
+  return readMemory(addr);
+}
+
+u8 BusImpl::readMemory(u16 addr) const {
+  // Hram shares its page with io, and is the most used of the two.
+  if (addr >= 0xff80 && addr <= 0xfffe) {
+    return hram->read(addr - 0xff80);
+  }
+
   if (addr <= 0x7fff) {
     return mbc->readRom(addr);
   } else if (addr <= 0x9fff) {
@@ -22,47 +64,8 @@ u8 BusImpl::read(u16 addr) const {
   } else if (addr <= 0xfeff) {
     DLOG(WARNING) << "Address " << addr << " is not usable" << std::endl;
     return 0x00;
-  } else if (addr == 0xff00) {
-    return joypad->read();
-  } else if (addr == 0xff04) {
-    return timer->readDivider();
-  } else if (addr == 0xff05) {
-    return timer->readCounter();
-  } else if (addr == 0xff06) {
-    return timer->readModulo();
-  } else if (addr == 0xff07) {
-    return timer->readControl();
-  } else if (addr == 0xff0f) {
-    return ic->readInterruptFlag();
-  } else if (addr == 0xff40) {
-    return ppu->readLcdc();
-  } else if (addr == 0xff41) {
-    return ppu->readLcdStat();
-  } else if (addr == 0xff42) {
-    return ppu->readScy();
-  } else if (addr == 0xff43) {
-    return ppu->readScx();
-  } else if (addr == 0xff44) {
-    return ppu->readLy();
-  } else if (addr == 0xff45) {
-    return ppu->readLyc();
-  } else if (addr == 0xff46) {
-    return static_cast<u8>(dma_source_address >> 8);
-  } else if (addr == 0xff47) {
-    return ppu->readBgp();
-  } else if (addr == 0xff48) {
-    return ppu->readObp0();
-  } else if (addr == 0xff49) {
-    return ppu->readObp1();
-  } else if (addr == 0xff4a) {
-    return ppu->readWy();
-  } else if (addr == 0xff4b) {
-    return ppu->readWx();
   } else if (addr <= 0xff7f) {
-    DLOG(WARNING) << "Not implemented to read " << addr << "." << std::endl;
-    return 0x00;
-  } else if (addr <= 0xfffe) {
-    return hram->read(addr - 0xff80);
+    return io.read(addr);
   } else if (addr == 0xffff) {
     return ic->readInterruptEnable();
   } else {
@@ -71,9 +74,18 @@ u8 BusImpl::read(u16 addr) const {
   }
 }
 
-void BusImpl::write(u16 addr, u8 value) {
+void BusImpl::writeSlow(u16 addr, u8 value) {
+  if (isBlockedByDma(addr)) {
+    return;
+  }
+  if (addr >= 0xff80 && addr <= 0xfffe) {
+    hram->write(addr - 0xff80, value);
+    return;
+  }
+
   if (addr <= 0x7fff) {
     mbc->writeRom(addr, value);
+    mapCartridge();
   } else if (addr <= 0x9fff) {
     ppu->writeVram(addr - 0x8000, value);
   } else if (addr <= 0xbfff) {
@@ -86,50 +98,8 @@ void BusImpl::write(u16 addr, u8 value) {
     ppu->writeOam(addr - 0xfe00, value);
   } else if (addr <= 0xfeff) {
     DLOG(WARNING) << "Address " << addr << " is not usable." << std::endl;
-  } else if (addr == 0xff00) {
-    joypad->write(value);
-  } else if (addr == 0xff01) {
-    DLOG(WARNING) << "Not implemented to write " << addr << "." << std::endl;
-  } else if (addr == 0xff02) {
-    DLOG(WARNING) << "Not implemented to write " << addr << "." << std::endl;
-  } else if (addr == 0xff04) {
-    timer->resetDivider();
-  } else if (addr == 0xff05) {
-    timer->writeCounter(value);
-  } else if (addr == 0xff06) {
-    timer->writeModulo(value);
-  } else if (addr == 0xff07) {
-    timer->writeControl(value);
-  } else if (addr == 0xff0f) {
-    ic->writeInterruptFlag(value);
-  } else if (addr == 0xff40) {
-    ppu->writeLcdc(value);
-  } else if (addr == 0xff41) {
-    ppu->writeLcdStat(value);
-  } else if (addr == 0xff42) {
-    ppu->writeScy(value);
-  } else if (addr == 0xff43) {
-    ppu->writeScx(value);
-  } else if (addr == 0xff44) {
-    ppu->writeLy(value);
-  } else if (addr == 0xff45) {
-    ppu->writeLyc(value);
-  } else if (addr == 0xff46) {
-    enterDma(value);
-  } else if (addr == 0xff47) {
-    ppu->writeBgp(value);
-  } else if (addr == 0xff48) {
-    ppu->writeObp0(value);
-  } else if (addr == 0xff49) {
-    ppu->writeObp1(value);
-  } else if (addr == 0xff4a) {
-    ppu->writeWy(value);
-  } else if (addr == 0xff4b) {
-    ppu->writeWx(value);
   } else if (addr <= 0xff7f) {
-    DLOG(WARNING) << "Not implemented to write " << addr << "." << std::endl;
-  } else if (addr <= 0xfffe) {
-    hram->write(addr - 0xff80, value);
+    io.write(addr, value);
   } else if (addr == 0xffff) {
     ic->writeInterruptEnable(value);
   } else {
@@ -137,36 +107,126 @@ void BusImpl::write(u16 addr, u8 value) {
   }
 }
 
+u32 BusImpl::getRomBank(u16 addr) const { return mbc->getRomBank(addr); }
+
+void BusImpl::setCoverage(Coverage* coverage_) { coverage = coverage_; }
+
+void BusImpl::mapPages() {
+  mapCartridge();
+  mapVram();
+  u8* data = isBlockedByDma(0xc000) ? nullptr : wram->getData();
+  for (u32 page = 0xc0; page <= 0xfd; ++page) {
+    // Echo ram from 0xe000 mirrors wram.
+    u8* mapped = data != nullptr ? data + ((page - 0xc0) & 0x1f) * 0x100
+                                 : nullptr;
+    read_pages[page] = mapped;
+    write_pages[page] = mapped;
+  }
+}
+
+void BusImpl::mapCartridge() {
+  bool direct = !isBlockedByDma(0x0000);
+  const u8* low = direct ? mbc->getRomData(0x0000) : nullptr;
+  const u8* high = direct ? mbc->getRomData(0x4000) : nullptr;
+  for (u32 page = 0; page < 0x40; ++page) {
+    read_pages[page] = low != nullptr ? low + page * 0x100 : nullptr;
+    read_pages[0x40 + page] = high != nullptr ? high + page * 0x100 : nullptr;
+  }
+
+  u8* ram = isBlockedByDma(0xa000) ? nullptr : mbc->getRamData();
+  for (u32 page = 0; page < 0x20; ++page) {
+    u8* mapped = ram != nullptr ? ram + page * 0x100 : nullptr;
+    read_pages[0xa0 + page] = mapped;
+    write_pages[0xa0 + page] = mapped;
+  }
+}
+
+void BusImpl::mapVram() {
+  u8* data = isBlockedByDma(0x8000) ? nullptr : ppu->getCpuVram();
+  for (u32 page = 0; page < 0x20; ++page) {
+    u8* mapped = data != nullptr ? data + page * 0x100 : nullptr;
+    read_pages[0x80 + page] = mapped;
+    write_pages[0x80 + page] = mapped;
+  }
+}
+
+void BusImpl::registerDma() {
+  io.add(0xff46, [this] { return static_cast<u8>(dma_source_address >> 8); },
+         [this](u8 value) { enterDma(value); });
+}
+
+u64 BusImpl::getCyclesUntilChange(u16 addr) const {
+  if (isBlockedByDma(addr)) {
+    // What the cpu reads follows the progress of dma.
+    return 0;
+  } else if (addr <= 0x7fff || (addr >= 0xc000 && addr <= 0xfdff)) {
+    // Rom only changes by writes to the mbc.
+    return UINT64_MAX;
+  } else if (addr == 0xff04 || addr == 0xff05) {
+    return timer->getCyclesUntilRegisterChange();
+  } else if (addr == 0xff41 || addr == 0xff44) {
+    return ppu->getCyclesUntilRegisterChange();
+  } else if (addr == 0xff00 || addr == 0xff0f || addr == 0xff40 ||
+             (addr >= 0xff42 && addr <= 0xff4b) || addr >= 0xff80) {
+    // Joypad input only changes between calls to advance(), and the rest only
+    // by cpu writes or interrupts.
+    return UINT64_MAX;
+  }
+  return 0;
+}
+
 void BusImpl::tick() {
-  if (stalls > 0) {
-    stalls--;
-    return;
+  if (dma_cycles > 0 && --dma_cycles == 0) {
+    exitDma();
   }
+}
 
-  switch (mode) {
-    case BusMode::Dma:
-      transfer();
-      break;
-    case BusMode::Normal:
-      break;
+void BusImpl::advance(u64 n) {
+  if (dma_cycles > 0) {
+    dma_cycles -= static_cast<u32>(std::min<u64>(n, dma_cycles));
+    if (dma_cycles == 0) {
+      exitDma();
+    }
   }
 }
 
 void BusImpl::enterDma(u8 value) {
-  mode = BusMode::Dma;
   dma_source_address = concat(value, 0x00);
-  transfer();
+  // The source cannot change while dma blocks its bus, so it is copied at
+  // once.
+  const u8* page = read_pages[value];
+  for (u16 i = 0; i < 160; ++i) {
+    dma_data[i] = page != nullptr ? page[i]
+                                  : readMemory(dma_source_address + i);
+  }
+  if (coverage != nullptr && dma_source_address <= 0x7fff) {
+    u32 rom_start = Coverage::getRomAddress(mbc->getRomBank(dma_source_address),
+                                            dma_source_address);
+    for (u32 i = 0; i < 160; ++i) {
+      coverage->markRead(rom_start + i);
+    }
+  }
+  ppu->writeOamDma(dma_data.data());
+
+  dma_cycles = dma_length;
+  dma_from_vram = value >= 0x80 && value <= 0x9f;
+  mapPages();
 }
 
-void BusImpl::transfer() {
-  u16 addr = dma_source_address & 0xff;
-  ppu->writeOam(addr, read(dma_source_address));
-  if ((dma_source_address & 0xff) == 0x9f) {
-    mode = BusMode::Normal;
-    return;
+void BusImpl::exitDma() {
+  dma_cycles = 0;
+  mapPages();
+}
+
+bool BusImpl::isBlockedByDma(u16 addr) const {
+  if (dma_cycles == 0) {
+    return false;
+  }
+  if (addr >= 0xfe00) {
+    // Io and hram stay accessible.
+    return addr <= 0xfeff;
   }
-  dma_source_address++;
-  stalls += 3;
+  return (addr >= 0x8000 && addr <= 0x9fff) == dma_from_vram;
 }
 
 }  // namespace gbeml
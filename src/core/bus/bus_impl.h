@@ -1,10 +1,14 @@
 #ifndef GBEML_BUS_IMPL_H_
 #define GBEML_BUS_IMPL_H_
 
+#include <array>
+
 #include "core/bus/bus.h"
+#include "core/bus/io_table.h"
 #include "core/graphics/ppu.h"
 #include "core/interrupt/interrupt_controller.h"
 #include "core/joypad/joypad.h"
+#include "core/memory/coverage.h"
 #include "core/memory/mbc.h"
 #include "core/memory/ram.h"
 #include "core/timer/timer.h"
@@ -12,9 +16,7 @@
 
 namespace gbeml {
 
-enum class BusMode { Normal, Dma };
-
-class BusImpl : public Bus {
+class BusImpl final : public Bus {
  public:
   BusImpl(Mbc* mbc_, Ram* wram_, Ram* hram_, Ppu* ppu_, Timer* timer_,
           InterruptController* ic_, Joypad* joypad_)
@@ -24,11 +26,30 @@ class BusImpl : public Bus {
         ppu(ppu_),
         timer(timer_),
         ic(ic_),
-        joypad(joypad_) {}
+        joypad(joypad_) {
+    mapPages();
+    registerDma();
+    ppu->setAccessListener([this] { mapVram(); });
+  }
 
   u8 read(u16 addr) const override;
   void write(u16 addr, u8 value) override;
+  u8 peek(u16 addr) const override;
+  u32 getRomBank(u16 addr) const override;
   void tick() override;
+  void advance(u64 n) override;
+  u64 getCyclesUntilChange(u16 addr) const override;
+  bool isBlockedByDma(u16 addr) const override;
+
+  // Marks the rom bytes oam dma copies as read. The cpu marks its own reads.
+  // Pass nullptr to stop.
+  void setCoverage(Coverage* coverage_);
+  // Oam dma runs at the speed of the cpu, so it takes fewer cycles of the
+  // rest with a faster cpu.
+  void setCpuClockMultiplier(u32 multiplier) { dma_length = 640 / multiplier; }
+  // For the timer, the ppu, the joypad and the interrupt controller to add
+  // their registers to. The bus adds DMA itself.
+  IoTable* getIoTable() { return &io; }
 
  private:
   Mbc* mbc;
@@ -38,14 +59,39 @@ class BusImpl : public Bus {
   Timer* timer;
   InterruptController* ic;
   Joypad* joypad;
+  Coverage* coverage = nullptr;
 
-  u32 stalls = 0;
-  u16 dma_source_address;
-  BusMode mode = BusMode::Normal;
+  // The memory of each 256-byte page for direct reads and writes, indexed by
+  // addr & 0xff, or nullptr where accesses go through readSlow() and
+  // writeSlow(): io, hram and oam, rom for writes, and rom, vram and
+  // cartridge ram while they are not directly accessible.
+  std::array<const u8*, 256> read_pages = {};
+  std::array<u8*, 256> write_pages = {};
+  // The registers from 0xff00 to 0xff7f.
+  IoTable io;
 
-  void enterDma(u8 source);
+  // Oam dma copies all bytes when it starts, and for dma_cycles after that
+  // blocks the cpu from oam and the bus it reads from, where the cpu reads
+  // the byte dma would be transferring.
+  u16 dma_source_address = 0x0000;
+  u32 dma_cycles = 0;
+  u32 dma_length = 640;
+  bool dma_from_vram = false;
+  std::array<u8, 160> dma_data = {};
+
+  u8 readSlow(u16 addr) const;
+  // Reads addr as if no dma were running.
+  u8 readMemory(u16 addr) const;
+  void writeSlow(u16 addr, u8 value);
+  void mapPages();
+  // Called when the banks the mbc maps change.
+  void mapCartridge();
+  // Called when the cpu gains or loses access to vram.
+  void mapVram();
+  void registerDma();
 
-  void transfer();
+  void enterDma(u8 source);
+  void exitDma();
 };
 
 }  // namespace gbeml
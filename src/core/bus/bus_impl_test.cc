@@ -3,12 +3,18 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <vector>
+
+#include "core/bus/io_table.h"
 #include "core/display/display.h"
 #include "core/graphics/ppu.h"
+#include "core/graphics/ppu_impl.h"
 #include "core/interrupt/interrupt_controller.h"
 #include "core/joypad/joypad.h"
 #include "core/memory/mbc.h"
 #include "core/memory/ram.h"
+#include "core/memory/ram_impl.h"
+#include "core/memory/rom.h"
 #include "core/timer/timer.h"
 
 namespace gbeml {
@@ -25,6 +31,7 @@ class MockMbc : public Mbc {
   MOCK_METHOD2(writeRam, void(u16 addr, u8 value));
   MOCK_CONST_METHOD1(readRom, u8(u16 addr));
   MOCK_CONST_METHOD1(readRam, u8(u16 addr));
+  MOCK_CONST_METHOD1(getRomBank, u32(u16 addr));
 };
 
 class MockRam : public Ram {
@@ -46,6 +53,9 @@ class MockTimer : public Timer {
   MOCK_METHOD1(writeControl, void(u8 value));
 
   MOCK_METHOD0(tick, void());
+  MOCK_METHOD1(advance, void(u64 n));
+  MOCK_CONST_METHOD0(getCyclesUntilInterrupt, u64());
+  MOCK_CONST_METHOD0(getCyclesUntilRegisterChange, u64());
 };
 
 class MockInterruptController : public InterruptController {
@@ -83,11 +93,15 @@ class MockJoypad : public Joypad {
 
   MOCK_METHOD1(press, void(JoypadButton button));
   MOCK_METHOD1(release, void(JoypadButton button));
+  MOCK_CONST_METHOD0(getPollCount, u64());
 };
 
 class MockPpu : public Ppu {
  public:
   MOCK_METHOD0(tick, void());
+  MOCK_METHOD1(advance, void(u64 n));
+  MOCK_CONST_METHOD0(getCyclesUntilInterrupt, u64());
+  MOCK_CONST_METHOD0(getCyclesUntilRegisterChange, u64());
   MOCK_METHOD0(init, void());
 
   MOCK_CONST_METHOD1(readVram, u8(u16 addr));
@@ -107,6 +121,7 @@ class MockPpu : public Ppu {
 
   MOCK_METHOD2(writeVram, void(u16 addr, u8 value));
   MOCK_METHOD2(writeOam, void(u16 addr, u8 value));
+  MOCK_METHOD1(writeOamDma, void(const u8* data));
 
   MOCK_METHOD1(writeLcdc, void(u8 value));
   MOCK_METHOD1(writeLcdStat, void(u8 value));
@@ -121,7 +136,51 @@ class MockPpu : public Ppu {
   MOCK_METHOD1(writeObp1, void(u8 value));
 };
 
-TEST(BusImplTest, read) {
+class BusImplTest : public testing::Test {
+ protected:
+  // Adds the registers of the mocks, as the implementations do in GameBoy.
+  static void registerIo(BusImpl* bus, MockTimer* timer,
+                         MockInterruptController* ic, MockJoypad* joypad,
+                         MockPpu* ppu) {
+    IoTable* io = bus->getIoTable();
+    io->add(0xff00, [joypad] { return joypad->read(); },
+            [joypad](u8 value) { joypad->write(value); }, 0xc0);
+    io->add(0xff04, [timer] { return timer->readDivider(); },
+            [timer](u8) { timer->resetDivider(); });
+    io->add(0xff05, [timer] { return timer->readCounter(); },
+            [timer](u8 value) { timer->writeCounter(value); });
+    io->add(0xff06, [timer] { return timer->readModulo(); },
+            [timer](u8 value) { timer->writeModulo(value); });
+    io->add(0xff07, [timer] { return timer->readControl(); },
+            [timer](u8 value) { timer->writeControl(value); }, 0xf8);
+    io->add(0xff0f, [ic] { return ic->readInterruptFlag(); },
+            [ic](u8 value) { ic->writeInterruptFlag(value); }, 0xe0);
+    io->add(0xff40, [ppu] { return ppu->readLcdc(); },
+            [ppu](u8 value) { ppu->writeLcdc(value); });
+    io->add(0xff41, [ppu] { return ppu->readLcdStat(); },
+            [ppu](u8 value) { ppu->writeLcdStat(value); }, 0x80);
+    io->add(0xff42, [ppu] { return ppu->readScy(); },
+            [ppu](u8 value) { ppu->writeScy(value); });
+    io->add(0xff43, [ppu] { return ppu->readScx(); },
+            [ppu](u8 value) { ppu->writeScx(value); });
+    io->add(0xff44, [ppu] { return ppu->readLy(); },
+            [ppu](u8 value) { ppu->writeLy(value); });
+    io->add(0xff45, [ppu] { return ppu->readLyc(); },
+            [ppu](u8 value) { ppu->writeLyc(value); });
+    io->add(0xff47, [ppu] { return ppu->readBgp(); },
+            [ppu](u8 value) { ppu->writeBgp(value); });
+    io->add(0xff48, [ppu] { return ppu->readObp0(); },
+            [ppu](u8 value) { ppu->writeObp0(value); });
+    io->add(0xff49, [ppu] { return ppu->readObp1(); },
+            [ppu](u8 value) { ppu->writeObp1(value); });
+    io->add(0xff4a, [ppu] { return ppu->readWy(); },
+            [ppu](u8 value) { ppu->writeWy(value); });
+    io->add(0xff4b, [ppu] { return ppu->readWx(); },
+            [ppu](u8 value) { ppu->writeWx(value); });
+  }
+};
+
+TEST_F(BusImplTest, read) {
   MockDisplay display;
   MockRam hram;
   MockRam wram;
@@ -132,6 +191,7 @@ TEST(BusImplTest, read) {
   MockPpu ppu;
 
   BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+  registerIo(&bus_impl, &timer, &ic, &joypad, &ppu);
 
   EXPECT_CALL(mbc, readRom(0x0000)).WillOnce(testing::Return(1));
   EXPECT_CALL(mbc, readRom(0x7fff)).WillOnce(testing::Return(2));
@@ -179,14 +239,14 @@ TEST(BusImplTest, read) {
   EXPECT_EQ(10, bus_impl.read(0xfdff));
   EXPECT_EQ(11, bus_impl.read(0xfe00));
   EXPECT_EQ(12, bus_impl.read(0xfe9f));
-  EXPECT_EQ(13, bus_impl.read(0xff00));
+  EXPECT_EQ(0xc0 | 13, bus_impl.read(0xff00));
   EXPECT_EQ(14, bus_impl.read(0xff04));
   EXPECT_EQ(15, bus_impl.read(0xff05));
   EXPECT_EQ(16, bus_impl.read(0xff06));
-  EXPECT_EQ(17, bus_impl.read(0xff07));
-  EXPECT_EQ(18, bus_impl.read(0xff0f));
+  EXPECT_EQ(0xf8 | 17, bus_impl.read(0xff07));
+  EXPECT_EQ(0xe0 | 18, bus_impl.read(0xff0f));
   EXPECT_EQ(19, bus_impl.read(0xff40));
-  EXPECT_EQ(20, bus_impl.read(0xff41));
+  EXPECT_EQ(0x80 | 20, bus_impl.read(0xff41));
   EXPECT_EQ(21, bus_impl.read(0xff42));
   EXPECT_EQ(22, bus_impl.read(0xff43));
   EXPECT_EQ(23, bus_impl.read(0xff44));
@@ -201,7 +261,7 @@ TEST(BusImplTest, read) {
   EXPECT_EQ(32, bus_impl.read(0xffff));
 }
 
-TEST(BusImplTest, write) {
+TEST_F(BusImplTest, write) {
   MockDisplay display;
   MockRam hram;
   MockRam wram;
@@ -212,6 +272,7 @@ TEST(BusImplTest, write) {
   MockPpu ppu;
 
   BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+  registerIo(&bus_impl, &timer, &ic, &joypad, &ppu);
 
   EXPECT_CALL(mbc, writeRom(0x0000, 1)).Times(1);
   EXPECT_CALL(mbc, writeRom(0x7fff, 2)).Times(1);
@@ -280,4 +341,194 @@ TEST(BusImplTest, write) {
   bus_impl.write(0xffff, 32);
 }
 
+TEST_F(BusImplTest, getCyclesUntilChange) {
+  MockRam hram;
+  MockRam wram;
+  MockMbc mbc;
+  MockTimer timer;
+  MockInterruptController ic;
+  MockJoypad joypad;
+  MockPpu ppu;
+
+  BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+
+  EXPECT_CALL(timer, getCyclesUntilRegisterChange())
+      .WillRepeatedly(testing::Return(100));
+  EXPECT_CALL(ppu, getCyclesUntilRegisterChange())
+      .WillRepeatedly(testing::Return(200));
+
+  EXPECT_EQ(UINT64_MAX, bus_impl.getCyclesUntilChange(0x4000));
+  EXPECT_EQ(0, bus_impl.getCyclesUntilChange(0x8000));
+  EXPECT_EQ(0, bus_impl.getCyclesUntilChange(0xa000));
+  EXPECT_EQ(0, bus_impl.getCyclesUntilChange(0xfe00));
+  EXPECT_EQ(UINT64_MAX, bus_impl.getCyclesUntilChange(0xc000));
+  EXPECT_EQ(UINT64_MAX, bus_impl.getCyclesUntilChange(0xff00));
+  EXPECT_EQ(100, bus_impl.getCyclesUntilChange(0xff04));
+  EXPECT_EQ(100, bus_impl.getCyclesUntilChange(0xff05));
+  EXPECT_EQ(200, bus_impl.getCyclesUntilChange(0xff41));
+  EXPECT_EQ(200, bus_impl.getCyclesUntilChange(0xff44));
+  EXPECT_EQ(UINT64_MAX, bus_impl.getCyclesUntilChange(0xff45));
+  EXPECT_EQ(UINT64_MAX, bus_impl.getCyclesUntilChange(0xff80));
+}
+
+TEST_F(BusImplTest, dma_marksCoverage) {
+  MockRam hram;
+  MockRam wram;
+  testing::NiceMock<MockMbc> mbc;
+  MockTimer timer;
+  MockInterruptController ic;
+  MockJoypad joypad;
+  testing::NiceMock<MockPpu> ppu;
+
+  BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+  Coverage coverage(0x10000);
+  bus_impl.setCoverage(&coverage);
+
+  EXPECT_CALL(mbc, readRom(testing::_)).WillRepeatedly(testing::Return(0));
+  EXPECT_CALL(mbc, getRomBank(0x4100)).WillRepeatedly(testing::Return(3));
+
+  // The cpu marks its own reads.
+  bus_impl.read(0x4100);
+  EXPECT_EQ(0, coverage.getReadCount());
+
+  bus_impl.write(0xff46, 0x41);
+  EXPECT_TRUE(coverage.isRead(0xc100));
+  EXPECT_TRUE(coverage.isRead(0xc19f));
+  EXPECT_FALSE(coverage.isRead(0xc1a0));
+  EXPECT_EQ(160, coverage.getReadCount());
+}
+
+TEST_F(BusImplTest, peek) {
+  MockRam hram;
+  RamImpl wram(8 * 1024);
+  testing::NiceMock<MockMbc> mbc;
+  MockTimer timer;
+  MockInterruptController ic;
+  MockJoypad joypad;
+  testing::NiceMock<MockPpu> ppu;
+
+  BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+  Coverage coverage(0x10000);
+  bus_impl.setCoverage(&coverage);
+
+  EXPECT_CALL(mbc, readRom(0x0100)).WillRepeatedly(testing::Return(0x12));
+  EXPECT_EQ(0x12, bus_impl.peek(0x0100));
+  EXPECT_EQ(0, coverage.getReadCount());
+
+  // Oam dma does not block it.
+  wram.write(0x0010, 0x34);
+  bus_impl.write(0xff46, 0xc0);
+  EXPECT_EQ(0x00, bus_impl.read(0xc010));
+  EXPECT_EQ(0x34, bus_impl.peek(0xc010));
+}
+
+TEST_F(BusImplTest, pageTable) {
+  std::vector<u8> data(0x10000);
+  data[0x147] = 0x01;
+  data[0x148] = 0x01;
+  for (u32 bank = 0; bank < 4; ++bank) {
+    data[0x4000 * bank + 0x123] = static_cast<u8>(bank);
+  }
+  Rom rom;
+  rom.load(data);
+  Mbc1 mbc(rom);
+  RamImpl wram(8 * 1024);
+  RamImpl hram(128);
+  RamImpl vram(8 * 1024);
+  RamImpl oam(160);
+  testing::NiceMock<MockDisplay> display;
+  testing::NiceMock<MockInterruptController> ic;
+  PpuImpl ppu(&display, &vram, &oam, &ic);
+  MockTimer timer;
+  MockJoypad joypad;
+  ppu.writeLy(0);
+  ppu.writeLcdc(0x80);
+  ppu.init();
+
+  BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+
+  EXPECT_EQ(0, bus_impl.read(0x0123));
+  EXPECT_EQ(1, bus_impl.read(0x4123));
+  bus_impl.write(0x2000, 3);
+  EXPECT_EQ(3, bus_impl.read(0x4123));
+
+  // Cartridge ram is mapped while enabled.
+  EXPECT_EQ(0x00, bus_impl.read(0xa010));
+  bus_impl.write(0x0000, 0x0a);
+  bus_impl.write(0xa010, 0x24);
+  EXPECT_EQ(0x24, bus_impl.read(0xa010));
+  bus_impl.write(0x0000, 0x00);
+  EXPECT_EQ(0x00, bus_impl.read(0xa010));
+
+  bus_impl.write(0xc010, 0x42);
+  EXPECT_EQ(0x42, wram.read(0x0010));
+  EXPECT_EQ(0x42, bus_impl.read(0xe010));
+  bus_impl.write(0xff90, 0x07);
+  EXPECT_EQ(0x07, hram.read(0x0010));
+  EXPECT_EQ(0x07, bus_impl.read(0xff90));
+
+  // Vram is blocked while the ppu draws.
+  bus_impl.write(0x8000, 0x05);
+  EXPECT_EQ(0x05, vram.read(0x0000));
+  for (u32 i = 0; i < 80; ++i) {
+    ppu.tick();
+  }
+  EXPECT_EQ(0xff, bus_impl.read(0x8000));
+  bus_impl.write(0x8001, 0x09);
+  EXPECT_EQ(0x00, vram.read(0x0001));
+  for (u32 i = 0; i < 376; ++i) {
+    ppu.tick();
+  }
+  EXPECT_EQ(0x05, bus_impl.read(0x8000));
+}
+
+TEST_F(BusImplTest, dma) {
+  RamImpl wram(8 * 1024);
+  RamImpl hram(128);
+  testing::NiceMock<MockMbc> mbc;
+  MockTimer timer;
+  MockInterruptController ic;
+  MockJoypad joypad;
+  MockPpu ppu;
+  for (u16 i = 0; i < 160; ++i) {
+    wram.write(0x0100 + i, static_cast<u8>(i));
+  }
+
+  BusImpl bus_impl(&mbc, &wram, &hram, &ppu, &timer, &ic, &joypad);
+
+  std::vector<u8> oam;
+  EXPECT_CALL(ppu, writeOamDma(testing::_))
+      .WillOnce([&oam](const u8* data) { oam.assign(data, data + 160); });
+  bus_impl.write(0xff46, 0xc1);
+  ASSERT_EQ(160, oam.size());
+  for (u16 i = 0; i < 160; ++i) {
+    EXPECT_EQ(i, oam[i]);
+  }
+  EXPECT_EQ(0xc1, bus_impl.read(0xff46));
+
+  // The cpu reads the byte being transferred from the bus dma uses, and 0xff
+  // from oam.
+  EXPECT_EQ(0, bus_impl.read(0xd000));
+  bus_impl.advance(8);
+  EXPECT_EQ(2, bus_impl.read(0x4000));
+  EXPECT_EQ(2, bus_impl.read(0xe000));
+  EXPECT_EQ(0xff, bus_impl.read(0xfe00));
+  EXPECT_EQ(0, bus_impl.getCyclesUntilChange(0xc000));
+  bus_impl.write(0xc000, 0x42);
+  EXPECT_EQ(0x00, wram.read(0x0000));
+
+  // Vram, io and hram stay accessible.
+  EXPECT_CALL(ppu, readVram(0x0000)).WillOnce(testing::Return(7));
+  EXPECT_EQ(7, bus_impl.read(0x8000));
+  bus_impl.write(0xff90, 0x09);
+  EXPECT_EQ(0x09, bus_impl.read(0xff90));
+
+  for (u32 i = 0; i < 632; ++i) {
+    bus_impl.tick();
+  }
+  EXPECT_EQ(0x50, bus_impl.read(0xc150));
+  bus_impl.write(0xc000, 0x42);
+  EXPECT_EQ(0x42, wram.read(0x0000));
+}
+
 }  // namespace gbeml
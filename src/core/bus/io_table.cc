@@ -0,0 +1,36 @@
+#include "core/bus/io_table.h"
+
+#include <iostream>
+#include <utility>
+
+#include "core/log/logging.h"
+
+namespace gbeml {
+
+void IoTable::add(u16 addr, Read read, Write write, u8 unused_bits) {
+  DCHECK(addr >= 0xff00 && addr <= 0xff7f);
+  Entry& entry = entries[addr & 0x7f];
+  entry.read = std::move(read);
+  entry.write = std::move(write);
+  entry.unused_bits = unused_bits;
+}
+
+u8 IoTable::read(u16 addr) const {
+  const Entry& entry = entries[addr & 0x7f];
+  if (!entry.read) {
+    DLOG(WARNING) << "Not implemented to read " << addr << "." << std::endl;
+    return 0x00;
+  }
+  return entry.read() | entry.unused_bits;
+}
+
+void IoTable::write(u16 addr, u8 value) {
+  Entry& entry = entries[addr & 0x7f];
+  if (!entry.write) {
+    DLOG(WARNING) << "Not implemented to write " << addr << "." << std::endl;
+    return;
+  }
+  entry.write(value);
+}
+
+}  // namespace gbeml
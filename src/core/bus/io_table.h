@@ -0,0 +1,37 @@
+#ifndef GBEML_IO_TABLE_H_
+#define GBEML_IO_TABLE_H_
+
+#include <array>
+#include <functional>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Handlers of the io registers from 0xff00 to 0xff7f, registered by the
+// components owning them.
+class IoTable {
+ public:
+  using Read = std::function<u8()>;
+  using Write = std::function<void(u8)>;
+
+  // Bits set in unused_bits always read as 1. A register without a read or
+  // write handler ignores the access.
+  void add(u16 addr, Read read, Write write, u8 unused_bits = 0x00);
+
+  u8 read(u16 addr) const;
+  void write(u16 addr, u8 value);
+
+ private:
+  struct Entry {
+    Read read;
+    Write write;
+    u8 unused_bits = 0x00;
+  };
+
+  std::array<Entry, 0x80> entries;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_IO_TABLE_H_
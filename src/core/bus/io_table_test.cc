@@ -0,0 +1,39 @@
+#include "core/bus/io_table.h"
+
+#include <gtest/gtest.h>
+
+namespace gbeml {
+
+TEST(IoTableTest, readWrite) {
+  IoTable io;
+  u8 reg = 0x00;
+  io.add(0xff42, [&reg] { return reg; }, [&reg](u8 value) { reg = value; });
+
+  io.write(0xff42, 0x12);
+  EXPECT_EQ(0x12, reg);
+  EXPECT_EQ(0x12, io.read(0xff42));
+}
+
+TEST(IoTableTest, read_setsUnusedBits) {
+  IoTable io;
+  u8 reg = 0x05;
+  io.add(0xff07, [&reg] { return reg; }, [&reg](u8 value) { reg = value; },
+         0xf8);
+
+  EXPECT_EQ(0xfd, io.read(0xff07));
+  io.write(0xff07, 0xff);
+  EXPECT_EQ(0xff, reg);
+}
+
+TEST(IoTableTest, unregistered) {
+  IoTable io;
+  u8 reg = 0x00;
+  io.add(0xff44, [&reg] { return reg; }, nullptr);
+
+  EXPECT_EQ(0x00, io.read(0xff01));
+  io.write(0xff01, 0x12);
+  io.write(0xff44, 0x12);
+  EXPECT_EQ(0x00, io.read(0xff44));
+}
+
+}  // namespace gbeml
@@ -1,22 +1,165 @@
 #include "core/cpu/alu.h"
 
+#include "core/cpu/alu_table.h"
+#include "core/log/logging.h"
+
 namespace gbeml {
 
-u8 Alu::get_a() { return af->getHigh()->get(); }
-bool Alu::get_z() { return af->getLow()->getAt(7); }
-bool Alu::get_n() { return af->getLow()->getAt(6); }
-bool Alu::get_h() { return af->getLow()->getAt(5); }
-bool Alu::get_c() { return af->getLow()->getAt(4); }
+void Alu::setBackend(AluBackend backend_) { backend = backend_; }
+
+void Alu::setLazyFlags(bool enabled) {
+  materialize();
+  lazy_flags = enabled;
+}
+
+u8 Alu::get_a() { return regs->a; }
+
+u8 Alu::get_f() {
+  materialize();
+  return regs->f;
+}
+
+bool Alu::get_z() {
+  if (last_op != AluOp::None) {
+    return last_result == 0;
+  }
+  return regs->f >> 7 & 1;
+}
+
+bool Alu::get_n() {
+  materialize();
+  return regs->f >> 6 & 1;
+}
+
+bool Alu::get_h() {
+  materialize();
+  return regs->f >> 5 & 1;
+}
+
+bool Alu::get_c() {
+  if (last_op != AluOp::None) {
+    return carry();
+  }
+  return regs->f >> 4 & 1;
+}
+
+void Alu::set_a(u8 n) { regs->a = n; }
+
+void Alu::set_f(u8 n) {
+  last_op = AluOp::None;
+  regs->f = n;
+}
+
+void Alu::set_z(bool b) {
+  materialize();
+  regs->f = (regs->f & ~0x80) | b << 7;
+}
+
+void Alu::set_n(bool b) {
+  materialize();
+  regs->f = (regs->f & ~0x40) | b << 6;
+}
+
+void Alu::set_h(bool b) {
+  materialize();
+  regs->f = (regs->f & ~0x20) | b << 5;
+}
+
+void Alu::set_c(bool b) {
+  materialize();
+  regs->f = (regs->f & ~0x10) | b << 4;
+}
+
+void Alu::defer(AluOp op, u8 x, u8 y, u8 result, bool carry) {
+  last_op = op;
+  last_x = x;
+  last_y = y;
+  last_result = result;
+  last_carry = carry;
+}
+
+void Alu::materialize() {
+  if (last_op == AluOp::None) {
+    return;
+  }
+
+  bool n = false;
+  bool h = false;
+  u8 x = last_x & 0xf;
+  u8 y = last_y & 0xf;
+  switch (last_op) {
+    case AluOp::Add:
+      h = x + y > 0xf;
+      break;
+    case AluOp::Adc:
+      h = x + y + last_carry > 0xf;
+      break;
+    case AluOp::Sub:
+      n = true;
+      h = x < y;
+      break;
+    case AluOp::Sbc:
+      n = true;
+      h = x < y + last_carry;
+      break;
+    case AluOp::And:
+      h = true;
+      break;
+    case AluOp::Or:
+    case AluOp::Xor:
+      break;
+    case AluOp::Inc:
+      h = x == 0xf;
+      break;
+    case AluOp::Dec:
+      n = true;
+      h = x == 0;
+      break;
+    case AluOp::None:
+      DCHECK(false);
+      break;
+  }
+
+  bool c = carry();
+  bool z = last_result == 0;
+  regs->f = (regs->f & 0x0f) | z << 7 | n << 6 | h << 5 | c << 4;
+  last_op = AluOp::None;
+}
 
-void Alu::set_a(u8 n) { af->getHigh()->set(n); }
-void Alu::set_f(u8 n) { af->getLow()->set(n); }
-void Alu::set_z(bool b) { af->getLow()->setAt(7, b); }
-void Alu::set_n(bool b) { af->getLow()->setAt(6, b); }
-void Alu::set_h(bool b) { af->getLow()->setAt(5, b); }
-void Alu::set_c(bool b) { af->getLow()->setAt(4, b); }
+bool Alu::carry() const {
+  switch (last_op) {
+    case AluOp::Add:
+      return last_x + last_y > 0xff;
+    case AluOp::Adc:
+      return last_x + last_y + last_carry > 0xff;
+    case AluOp::Sub:
+      return last_x < last_y;
+    case AluOp::Sbc:
+      return last_x < last_y + last_carry;
+    case AluOp::And:
+    case AluOp::Or:
+    case AluOp::Xor:
+      return false;
+    case AluOp::Inc:
+    case AluOp::Dec:
+      return last_carry;
+    case AluOp::None:
+      break;
+  }
+  return regs->f >> 4 & 1;
+}
 
 void Alu::add_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::Add, a, n, a + n, false);
+    set_a(a + n);
+    return;
+  }
+  if (backend == AluBackend::Table) {
+    set_a(addWithTable(a, n, false));
+    return;
+  }
   set_c(a + n > 0xff);
   set_h((a & 0xf) + (n & 0xf) > 0xf);
   set_z(static_cast<u8>(a + n) == 0);
@@ -27,6 +170,15 @@ void Alu::add_n(u8 n) {
 void Alu::addc_n(u8 n) {
   u8 a = get_a();
   bool c = get_c();
+  if (lazy_flags) {
+    defer(AluOp::Adc, a, n, a + n + c, c);
+    set_a(a + n + c);
+    return;
+  }
+  if (backend == AluBackend::Table) {
+    set_a(addWithTable(a, n, c));
+    return;
+  }
   set_a(a + c);
   add_n(n);
   if (c) {
@@ -41,6 +193,11 @@ void Alu::addc_n(u8 n) {
 
 void Alu::sub_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::Sub, a, n, a - n, false);
+    set_a(a - n);
+    return;
+  }
   cp_n(n);
   set_a(a - n);
 }
@@ -48,6 +205,15 @@ void Alu::sub_n(u8 n) {
 void Alu::subc_n(u8 n) {
   u8 a = get_a();
   bool c = get_c();
+  if (lazy_flags) {
+    defer(AluOp::Sbc, a, n, a - n - c, c);
+    set_a(a - n - c);
+    return;
+  }
+  if (backend == AluBackend::Table) {
+    set_a(subWithTable(a, n, c));
+    return;
+  }
   set_a(a - c);
   sub_n(n);
   if (c) {
@@ -62,6 +228,11 @@ void Alu::subc_n(u8 n) {
 
 void Alu::and_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::And, a, n, a & n, false);
+    set_a(a & n);
+    return;
+  }
   set_c(false);
   set_h(true);
   set_z((a & n) == 0);
@@ -71,6 +242,11 @@ void Alu::and_n(u8 n) {
 
 void Alu::or_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::Or, a, n, a | n, false);
+    set_a(a | n);
+    return;
+  }
   set_c(false);
   set_h(false);
   set_z((a | n) == 0);
@@ -80,6 +256,11 @@ void Alu::or_n(u8 n) {
 
 void Alu::xor_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::Xor, a, n, a ^ n, false);
+    set_a(a ^ n);
+    return;
+  }
   set_c(false);
   set_h(false);
   set_z((a ^ n) == 0);
@@ -89,22 +270,30 @@ void Alu::xor_n(u8 n) {
 
 void Alu::cp_n(u8 n) {
   u8 a = get_a();
+  if (lazy_flags) {
+    defer(AluOp::Sub, a, n, a - n, false);
+    return;
+  }
+  if (backend == AluBackend::Table) {
+    subWithTable(a, n, false);
+    return;
+  }
   set_c(a < n);
   set_h((a & 0xf) < (n & 0xf));
   set_z(a - n == 0);
   set_n(true);
 }
 
-void Alu::add_hl_n16(RegisterPair* r, u16 n) {
-  u16 hl = r->get();
+void Alu::add_hl_n16(u16 n) {
+  u16 hl = regs->hl();
   set_c(hl + n > 0xffff);
   set_h((hl & 0xfff) + (n & 0xfff) > 0xfff);
   set_n(false);
-  r->set(hl + n);
+  regs->set_hl(hl + n);
 }
 
-u16 Alu::add_sp_n8(RegisterPair* r, i8 n) {
-  u16 sp = r->get();
+u16 Alu::add_sp_n8(i8 n) {
+  u16 sp = regs->sp;
   set_c((sp & 0xff) + static_cast<u8>(n) > 0xff);
   set_h((sp & 0xf) + (static_cast<u8>(n) & 0xf) > 0xf);
   set_z(false);
@@ -113,6 +302,14 @@ u16 Alu::add_sp_n8(RegisterPair* r, i8 n) {
 }
 
 u8 Alu::inc(u8 n) {
+  if (lazy_flags) {
+    defer(AluOp::Inc, n, 1, n + 1, get_c());
+    return n + 1;
+  }
+  if (backend == AluBackend::Table) {
+    applyFlags(kAluTable.inc[n], 0x10);
+    return n + 1;
+  }
   set_h((n & 0xf) == 0xf);
   set_z(static_cast<u8>(n + 1) == 0);
   set_n(false);
@@ -120,6 +317,14 @@ u8 Alu::inc(u8 n) {
 }
 
 u8 Alu::dec(u8 n) {
+  if (lazy_flags) {
+    defer(AluOp::Dec, n, 1, n - 1, get_c());
+    return n - 1;
+  }
+  if (backend == AluBackend::Table) {
+    applyFlags(kAluTable.dec[n], 0x10);
+    return n - 1;
+  }
   set_h((n & 0xf) < 1);
   set_z(static_cast<u8>(n - 1) == 0);
   set_n(true);
@@ -127,6 +332,10 @@ u8 Alu::dec(u8 n) {
 }
 
 u8 Alu::swap(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.swap[n]);
+  }
+
   set_z(n == 0);
   set_n(false);
   set_h(false);
@@ -141,6 +350,12 @@ u8 Alu::swap(u8 n) {
 void Alu::daa() {
   u8 a = get_a();
 
+  if (backend == AluBackend::Table) {
+    u16 index = (get_f() & 0x70) << 4 | a;
+    set_a(applyEntry(kAluTable.daa[index]));
+    return;
+  }
+
   if (get_n()) {
     if (get_c()) {
       a -= 0x60;
@@ -240,6 +455,10 @@ u8 Alu::res_b(u8 i, u8 n) {
 }
 
 u8 Alu::rotateLeft(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.rlc[n]);
+  }
+
   u8 res = static_cast<u8>(n << 1) | (n >> 7);
   set_z(res == 0);
   set_n(false);
@@ -249,6 +468,10 @@ u8 Alu::rotateLeft(u8 n) {
 }
 
 u8 Alu::rotateLeftThroughCarry(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.rl[get_c() << 8 | n]);
+  }
+
   u8 res = static_cast<u8>(n << 1) | get_c();
   set_z(res == 0);
   set_n(false);
@@ -258,6 +481,10 @@ u8 Alu::rotateLeftThroughCarry(u8 n) {
 }
 
 u8 Alu::rotateRight(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.rrc[n]);
+  }
+
   u8 res = (n >> 1) | static_cast<u8>(n << 7);
   set_z(res == 0);
   set_n(false);
@@ -267,6 +494,10 @@ u8 Alu::rotateRight(u8 n) {
 }
 
 u8 Alu::rotateRightThroughCarry(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.rr[get_c() << 8 | n]);
+  }
+
   u8 res = (n >> 1) | static_cast<u8>(get_c() << 7);
   set_z(res == 0);
   set_n(false);
@@ -276,6 +507,10 @@ u8 Alu::rotateRightThroughCarry(u8 n) {
 }
 
 u8 Alu::shiftLeft(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.sla[n]);
+  }
+
   u8 res = static_cast<u8>(n << 1);
   set_z(res == 0);
   set_n(false);
@@ -285,6 +520,10 @@ u8 Alu::shiftLeft(u8 n) {
 }
 
 u8 Alu::shiftRightArithmetic(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.sra[n]);
+  }
+
   u8 res = (n >> 1) | (n & 0b10000000);
   set_z(res == 0);
   set_n(false);
@@ -294,6 +533,10 @@ u8 Alu::shiftRightArithmetic(u8 n) {
 }
 
 u8 Alu::shiftRightLogical(u8 n) {
+  if (backend == AluBackend::Table) {
+    return applyEntry(kAluTable.srl[n]);
+  }
+
   u8 res = n >> 1;
   set_z(res == 0);
   set_n(false);
@@ -302,4 +545,25 @@ u8 Alu::shiftRightLogical(u8 n) {
   return res;
 }
 
+u8 Alu::addWithTable(u8 a, u8 n, bool c) {
+  u16 sum = a + n + c;
+  applyFlags(kAluTable.add[((a ^ n ^ sum) & 0x10) << 5 | (sum & 0x1ff)], 0);
+  return static_cast<u8>(sum);
+}
+
+u8 Alu::subWithTable(u8 a, u8 n, bool c) {
+  u16 diff = a - n - c;
+  applyFlags(kAluTable.sub[((a ^ n ^ diff) & 0x10) << 5 | (diff & 0x1ff)], 0);
+  return static_cast<u8>(diff);
+}
+
+void Alu::applyFlags(u8 flags, u8 keep) {
+  regs->f = (get_f() & (keep | 0x0f)) | flags;
+}
+
+u8 Alu::applyEntry(u16 entry) {
+  applyFlags(entry & 0xff, 0);
+  return entry >> 8;
+}
+
 }  // namespace gbeml
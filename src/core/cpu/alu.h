@@ -1,15 +1,20 @@
 #ifndef GBEML_ALU_H_
 #define GBEML_ALU_H_
 
-#include "core/bus/bus.h"
-#include "core/register/register.h"
+#include "core/cpu/registers.h"
 #include "core/types/types.h"
 
 namespace gbeml {
 
+enum class AluOp { None, Add, Adc, Sub, Sbc, And, Or, Xor, Inc, Dec };
+
+// Logic computes results and flags with arithmetic, Table looks them up in
+// precomputed tables (see alu_table.h).
+enum class AluBackend { Logic, Table };
+
 class Alu {
  public:
-  Alu(RegisterPair* af_) : af(af_) {}
+  Alu(Registers* regs_) : regs(regs_) {}
 
   void add_n(u8 n);
   void addc_n(u8 n);
@@ -19,8 +24,8 @@ class Alu {
   void or_n(u8 n);
   void xor_n(u8 n);
   void cp_n(u8 n);
-  void add_hl_n16(RegisterPair* r, u16 n);
-  u16 add_sp_n8(RegisterPair* r, i8 n);
+  void add_hl_n16(u16 n);
+  u16 add_sp_n8(i8 n);
 
   u8 inc(u8 n);
   u8 dec(u8 n);
@@ -50,7 +55,11 @@ class Alu {
   u8 set_b(u8 i, u8 n);
   u8 res_b(u8 i, u8 n);
 
+  void setBackend(AluBackend backend_);
+  void setLazyFlags(bool enabled);
+
   u8 get_a();
+  u8 get_f();
   bool get_z();
   bool get_n();
   bool get_h();
@@ -64,7 +73,21 @@ class Alu {
   void set_c(bool b);
 
  private:
-  RegisterPair* af;
+  Registers* regs;
+  AluBackend backend = AluBackend::Logic;
+
+  // In lazy flags mode, the last flag-producing operation is recorded here
+  // and F is updated only when it is read.
+  bool lazy_flags = false;
+  AluOp last_op = AluOp::None;
+  u8 last_x = 0;
+  u8 last_y = 0;
+  u8 last_result = 0;
+  bool last_carry = false;
+
+  void defer(AluOp op, u8 x, u8 y, u8 result, bool carry);
+  void materialize();
+  bool carry() const;
 
   u8 rotateLeft(u8 n);
   u8 rotateLeftThroughCarry(u8 n);
@@ -74,6 +97,11 @@ class Alu {
   u8 shiftLeft(u8 n);
   u8 shiftRightArithmetic(u8 n);
   u8 shiftRightLogical(u8 n);
+
+  u8 addWithTable(u8 a, u8 n, bool c);
+  u8 subWithTable(u8 a, u8 n, bool c);
+  void applyFlags(u8 flags, u8 keep);
+  u8 applyEntry(u16 entry);
 };
 
 }  // namespace gbeml
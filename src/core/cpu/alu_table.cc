@@ -0,0 +1,78 @@
+#include "core/cpu/alu_table.h"
+
+namespace gbeml {
+
+namespace {
+
+constexpr u8 flags(bool z, bool n, bool h, bool c) {
+  return static_cast<u8>(z << 7 | n << 6 | h << 5 | c << 4);
+}
+
+constexpr u16 entry(u8 result, bool c) {
+  return static_cast<u16>(result << 8 | flags(result == 0, false, false, c));
+}
+
+constexpr u16 daa(u8 a, bool n, bool h, bool c) {
+  if (n) {
+    if (c) {
+      a -= 0x60;
+    }
+    if (h) {
+      a -= 6;
+    }
+  } else {
+    if (c || a > 0x99) {
+      a += 0x60;
+      c = true;
+    }
+    if (h || (a & 0xf) > 9) {
+      a += 6;
+    }
+  }
+  return static_cast<u16>(a << 8 | flags(a == 0, n, false, c));
+}
+
+constexpr AluTable buildAluTable() {
+  AluTable table{};
+
+  for (u16 i = 0; i < 256; ++i) {
+    u8 n = static_cast<u8>(i);
+
+    table.inc[n] = flags(static_cast<u8>(n + 1) == 0, false,
+                         (n & 0xf) == 0xf, false);
+    table.dec[n] = flags(static_cast<u8>(n - 1) == 0, true,
+                         (n & 0xf) == 0, false);
+
+    table.rlc[n] = entry(static_cast<u8>(n << 1 | n >> 7), n >> 7);
+    table.rrc[n] = entry(static_cast<u8>(n >> 1 | n << 7), n & 1);
+    table.rl[n] = entry(static_cast<u8>(n << 1), n >> 7);
+    table.rl[0x100 | n] = entry(static_cast<u8>(n << 1 | 1), n >> 7);
+    table.rr[n] = entry(static_cast<u8>(n >> 1), n & 1);
+    table.rr[0x100 | n] = entry(static_cast<u8>(n >> 1 | 0x80), n & 1);
+    table.sla[n] = entry(static_cast<u8>(n << 1), n >> 7);
+    table.sra[n] = entry(static_cast<u8>(n >> 1 | (n & 0x80)), n & 1);
+    table.srl[n] = entry(static_cast<u8>(n >> 1), n & 1);
+    table.swap[n] = entry(static_cast<u8>(n << 4 | n >> 4), false);
+  }
+
+  for (u16 i = 0; i < 1024; ++i) {
+    bool z = (i & 0xff) == 0;
+    bool h = i >> 9 & 1;
+    bool c = i >> 8 & 1;
+    table.add[i] = flags(z, false, h, c);
+    table.sub[i] = flags(z, true, h, c);
+  }
+
+  for (u16 i = 0; i < 2048; ++i) {
+    table.daa[i] = daa(static_cast<u8>(i), i >> 10 & 1, i >> 9 & 1,
+                       i >> 8 & 1);
+  }
+
+  return table;
+}
+
+}  // namespace
+
+constexpr AluTable kAluTable = buildAluTable();
+
+}  // namespace gbeml
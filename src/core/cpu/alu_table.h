@@ -0,0 +1,42 @@
+#ifndef GBEML_ALU_TABLE_H_
+#define GBEML_ALU_TABLE_H_
+
+#include <array>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Precomputed results and flags of 8-bit alu operations.
+//
+// Flag entries hold Z/N/H/C in the upper nibble, as in F. Result entries hold
+// the result in the upper byte and the flags in the lower byte.
+struct AluTable {
+  // Indexed by the operand.
+  std::array<u8, 256> inc;
+  std::array<u8, 256> dec;
+
+  // Indexed by half carry << 9 | 9-bit sum (or difference) of a, n and the
+  // carry, where half carry is bit 4 of a ^ n ^ sum.
+  std::array<u8, 1024> add;
+  std::array<u8, 1024> sub;
+
+  // Indexed by n << 10 | h << 9 | c << 8 | a, i.e. (F & 0x70) << 4 | A.
+  std::array<u16, 2048> daa;
+
+  // Indexed by the operand, and by c << 8 | operand for rl and rr.
+  std::array<u16, 256> rlc;
+  std::array<u16, 256> rrc;
+  std::array<u16, 512> rl;
+  std::array<u16, 512> rr;
+  std::array<u16, 256> sla;
+  std::array<u16, 256> sra;
+  std::array<u16, 256> srl;
+  std::array<u16, 256> swap;
+};
+
+extern const AluTable kAluTable;
+
+}  // namespace gbeml
+
+#endif  // GBEML_ALU_TABLE_H_
@@ -5,8 +5,8 @@
 namespace gbeml {
 
 TEST(AluTest, add_n_setsZFlagIfResultIsZero) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.add_n(0xff);
   EXPECT_EQ(false, alu.get_z());
@@ -16,8 +16,8 @@ TEST(AluTest, add_n_setsZFlagIfResultIsZero) {
 }
 
 TEST(AluTest, add_n_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
   alu.add_n(1);
@@ -25,8 +25,8 @@ TEST(AluTest, add_n_resetsN) {
 }
 
 TEST(AluTest, add_n_setsHIfCarryFromBit3) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0b1110);
 
   alu.add_n(1);
@@ -36,8 +36,8 @@ TEST(AluTest, add_n_setsHIfCarryFromBit3) {
 }
 
 TEST(AluTest, add_n_setsCIfCarryFromBit7) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xfe);
 
   alu.add_n(1);
@@ -47,8 +47,8 @@ TEST(AluTest, add_n_setsCIfCarryFromBit7) {
 }
 
 TEST(AluTest, addc_n_addsNPlusC) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.addc_n(0xfe);
@@ -61,8 +61,9 @@ TEST(AluTest, addc_n_addsNPlusC) {
 }
 
 TEST(AluTest, addc_n_setsCarry) {
-  RegisterPair af(0xff, 0);
-  Alu alu(&af);
+  Registers regs;
+  regs.a = 0xff;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.addc_n(0);
@@ -71,8 +72,9 @@ TEST(AluTest, addc_n_setsCarry) {
 }
 
 TEST(AluTest, addc_n_setsHalfCarry) {
-  RegisterPair af(0xf, 0);
-  Alu alu(&af);
+  Registers regs;
+  regs.a = 0xf;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.addc_n(0);
@@ -81,8 +83,8 @@ TEST(AluTest, addc_n_setsHalfCarry) {
 }
 
 TEST(AluTest, sub_n_setsZFlagIfResultIsZero) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xff);
 
   alu.sub_n(0xfe);
@@ -93,8 +95,8 @@ TEST(AluTest, sub_n_setsZFlagIfResultIsZero) {
 }
 
 TEST(AluTest, sub_n_setsN) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   EXPECT_EQ(false, alu.get_n());
   alu.sub_n(1);
@@ -102,8 +104,8 @@ TEST(AluTest, sub_n_setsN) {
 }
 
 TEST(AluTest, sub_n_setsHIfNoBorrowBit4) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xff);
 
   alu.sub_n(1);
@@ -113,8 +115,8 @@ TEST(AluTest, sub_n_setsHIfNoBorrowBit4) {
 }
 
 TEST(AluTest, sub_n_setsCIfNoBorrow) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xff);
 
   alu.sub_n(1);
@@ -124,8 +126,8 @@ TEST(AluTest, sub_n_setsCIfNoBorrow) {
 }
 
 TEST(AluTest, subc_n_subtractsNPlusC) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xff);
   alu.set_c(true);
   alu.subc_n(0xfe);
@@ -138,8 +140,8 @@ TEST(AluTest, subc_n_subtractsNPlusC) {
 }
 
 TEST(AluTest, subc_n_setsCarry) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0x0);
 
   alu.set_c(true);
@@ -148,8 +150,8 @@ TEST(AluTest, subc_n_setsCarry) {
 }
 
 TEST(AluTest, subc_n_setsHalfCarry) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xf0);
 
   alu.set_c(true);
@@ -158,8 +160,8 @@ TEST(AluTest, subc_n_setsHalfCarry) {
 }
 
 TEST(AluTest, and_n_setsZIfResultIsZero) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
   alu.set_a(0xff);
 
   alu.and_n(0b10101010);
@@ -169,8 +171,8 @@ TEST(AluTest, and_n_setsZIfResultIsZero) {
 }
 
 TEST(AluTest, and_n_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
   alu.and_n(0);
@@ -178,8 +180,8 @@ TEST(AluTest, and_n_resetsN) {
 }
 
 TEST(AluTest, and_n_setsH) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   EXPECT_EQ(false, alu.get_h());
   alu.and_n(0);
@@ -187,8 +189,8 @@ TEST(AluTest, and_n_setsH) {
 }
 
 TEST(AluTest, and_n_resetsC) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.and_n(0);
@@ -196,8 +198,8 @@ TEST(AluTest, and_n_resetsC) {
 }
 
 TEST(AluTest, or_n_setsZIfResultIsZero) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.or_n(0);
   EXPECT_EQ(true, alu.get_z());
@@ -206,8 +208,8 @@ TEST(AluTest, or_n_setsZIfResultIsZero) {
 }
 
 TEST(AluTest, or_n_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
   alu.or_n(0);
@@ -215,8 +217,8 @@ TEST(AluTest, or_n_resetsN) {
 }
 
 TEST(AluTest, or_n_resetsH) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_h(true);
   alu.or_n(0);
@@ -224,8 +226,8 @@ TEST(AluTest, or_n_resetsH) {
 }
 
 TEST(AluTest, or_n_resetsC) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.or_n(0);
@@ -233,8 +235,8 @@ TEST(AluTest, or_n_resetsC) {
 }
 
 TEST(AluTest, xor_n_setsZIfResultIsZero) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.xor_n(0);
   EXPECT_EQ(true, alu.get_z());
@@ -247,8 +249,8 @@ TEST(AluTest, xor_n_setsZIfResultIsZero) {
 }
 
 TEST(AluTest, xor_n_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
   alu.xor_n(0);
@@ -256,8 +258,8 @@ TEST(AluTest, xor_n_resetsN) {
 }
 
 TEST(AluTest, xor_n_resetsH) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_h(true);
   alu.xor_n(0);
@@ -265,8 +267,8 @@ TEST(AluTest, xor_n_resetsH) {
 }
 
 TEST(AluTest, xor_n_resetsC) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_c(true);
   alu.xor_n(0);
@@ -274,89 +276,86 @@ TEST(AluTest, xor_n_resetsC) {
 }
 
 TEST(AluTest, add_hl_n16_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl;
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
-  alu.add_hl_n16(&hl, 0);
+  alu.add_hl_n16(0);
   EXPECT_EQ(false, alu.get_n());
 }
 
 TEST(AluTest, add_hl_n16_setsHIfCarryFromBit11) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl(0x0f, 0);
+  Registers regs;
+  Alu alu(&regs);
+  regs.set_hl(0x0f00);
 
   EXPECT_EQ(false, alu.get_h());
-  alu.add_hl_n16(&hl, 0x0100);
+  alu.add_hl_n16(0x0100);
   EXPECT_EQ(true, alu.get_h());
 }
 
 TEST(AluTest, add_hl_n16_setsCIfCarryFromBit15) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl(0xff, 1);
+  Registers regs;
+  Alu alu(&regs);
+  regs.set_hl(0xff01);
 
   EXPECT_EQ(false, alu.get_c());
-  alu.add_hl_n16(&hl, 0xff);
+  alu.add_hl_n16(0xff);
   EXPECT_EQ(true, alu.get_c());
 }
 
 TEST(AluTest, add_sp_n8_resetsZ) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl;
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_z(true);
-  alu.add_sp_n8(&hl, 0);
+  alu.add_sp_n8(0);
   EXPECT_EQ(false, alu.get_z());
 }
 
 TEST(AluTest, add_sp_n8_resetsN) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl;
+  Registers regs;
+  Alu alu(&regs);
 
   alu.set_n(true);
-  alu.add_sp_n8(&hl, 0);
+  alu.add_sp_n8(0);
   EXPECT_EQ(false, alu.get_n());
 }
 
 TEST(AluTest, add_sp_n8_setsHIfCarryFromBit3) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl(0, 0x0f);
+  Registers regs;
+  Alu alu(&regs);
+  regs.sp = 0x000f;
 
   EXPECT_EQ(false, alu.get_h());
-  alu.add_sp_n8(&hl, 0x01);
+  alu.add_sp_n8(0x01);
   EXPECT_EQ(true, alu.get_h());
 }
 
 TEST(AluTest, add_sp_n8_setsCIfCarryFromBit7) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl(0, 0xff);
+  Registers regs;
+  Alu alu(&regs);
+  regs.sp = 0x00ff;
 
   EXPECT_EQ(false, alu.get_c());
-  alu.add_sp_n8(&hl, 0x01);
+  alu.add_sp_n8(0x01);
   EXPECT_EQ(true, alu.get_c());
 }
 
 TEST(AluTest, add_sp_n8_subtract) {
-  RegisterPair af;
-  Alu alu(&af);
-  RegisterPair hl(0xff, 0x01);
+  Registers regs;
+  Alu alu(&regs);
+  regs.sp = 0xff01;
 
-  u16 n = alu.add_sp_n8(&hl, 0xff);
+  u16 n = alu.add_sp_n8(0xff);
   EXPECT_EQ(0xff00, n);
   EXPECT_EQ(true, alu.get_c());
   EXPECT_EQ(true, alu.get_h());
 }
 
 TEST(AluTest, daa_decimalAdjustAfterAddition) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   // 10
   alu.set_a(0x0a);
@@ -415,8 +414,8 @@ TEST(AluTest, daa_decimalAdjustAfterAddition) {
 }
 
 TEST(AluTest, daa_decimalAdjustAfterSubtraction) {
-  RegisterPair af;
-  Alu alu(&af);
+  Registers regs;
+  Alu alu(&regs);
 
   // f
   alu.set_a(0x0f);
@@ -485,4 +484,164 @@ TEST(AluTest, daa_decimalAdjustAfterSubtraction) {
   EXPECT_EQ(false, alu.get_z());
 }
 
+TEST(AluTest, lazyFlags_matchEagerFlags) {
+  void (Alu::*ops[])(u8) = {&Alu::add_n, &Alu::addc_n, &Alu::sub_n,
+                            &Alu::subc_n, &Alu::and_n,  &Alu::or_n,
+                            &Alu::xor_n,  &Alu::cp_n};
+
+  for (auto op : ops) {
+    for (u16 a = 0; a < 256; ++a) {
+      for (u16 n = 0; n < 256; ++n) {
+        for (u8 f : {0x00, 0xf0}) {
+          Registers eager_regs;
+          eager_regs.a = static_cast<u8>(a);
+          eager_regs.f = f;
+          Registers lazy_regs = eager_regs;
+          Alu eager(&eager_regs);
+          Alu lazy(&lazy_regs);
+          lazy.setLazyFlags(true);
+
+          (eager.*op)(static_cast<u8>(n));
+          (lazy.*op)(static_cast<u8>(n));
+          ASSERT_EQ(eager.get_z(), lazy.get_z());
+          ASSERT_EQ(eager.get_c(), lazy.get_c());
+          ASSERT_EQ(eager.get_a(), lazy.get_a());
+          ASSERT_EQ(eager.get_f(), lazy.get_f());
+        }
+      }
+    }
+  }
+
+  u8 (Alu::*unary_ops[])(u8) = {&Alu::inc, &Alu::dec};
+
+  for (auto op : unary_ops) {
+    for (u16 n = 0; n < 256; ++n) {
+      for (u8 f : {0x00, 0xf0}) {
+        Registers eager_regs;
+        eager_regs.f = f;
+        Registers lazy_regs = eager_regs;
+        Alu eager(&eager_regs);
+        Alu lazy(&lazy_regs);
+        lazy.setLazyFlags(true);
+
+        ASSERT_EQ((eager.*op)(static_cast<u8>(n)),
+                  (lazy.*op)(static_cast<u8>(n)));
+        ASSERT_EQ(eager.get_f(), lazy.get_f());
+      }
+    }
+  }
+}
+
+TEST(AluTest, lazyFlags_incAndDecKeepC) {
+  Registers regs;
+  regs.a = 0xff;
+  Alu alu(&regs);
+  alu.setLazyFlags(true);
+
+  alu.add_n(1);
+  EXPECT_EQ(0x10, alu.inc(0x0f));
+  EXPECT_EQ(0b00110000, alu.get_f() & 0xf0);
+
+  alu.sub_n(1);
+  EXPECT_EQ(0x0f, alu.dec(0x10));
+  EXPECT_EQ(0b01110000, alu.get_f() & 0xf0);
+}
+
+TEST(AluTest, lazyFlags_setFlagAfterDeferredOperation) {
+  Registers regs;
+  Alu alu(&regs);
+  alu.setLazyFlags(true);
+
+  alu.cp_n(1);
+  alu.set_z(true);
+  EXPECT_EQ(0b11110000, alu.get_f() & 0xf0);
+
+  alu.xor_n(0);
+  alu.set_f(0x10);
+  EXPECT_EQ(true, alu.get_c());
+  EXPECT_EQ(false, alu.get_z());
+}
+
+TEST(AluTest, tableBackend_matchesLogic) {
+  void (Alu::*ops[])(u8) = {&Alu::add_n, &Alu::addc_n, &Alu::sub_n,
+                            &Alu::subc_n, &Alu::cp_n};
+
+  for (auto op : ops) {
+    for (u16 a = 0; a < 256; ++a) {
+      for (u16 n = 0; n < 256; ++n) {
+        for (u8 f : {0x00, 0xf0}) {
+          Registers logic_regs;
+          logic_regs.a = static_cast<u8>(a);
+          logic_regs.f = f;
+          Registers table_regs = logic_regs;
+          Alu logic(&logic_regs);
+          Alu table(&table_regs);
+          table.setBackend(AluBackend::Table);
+
+          (logic.*op)(static_cast<u8>(n));
+          (table.*op)(static_cast<u8>(n));
+          ASSERT_EQ(logic_regs.a, table_regs.a);
+          ASSERT_EQ(logic_regs.f, table_regs.f);
+        }
+      }
+    }
+  }
+
+  u8 (Alu::*unary_ops[])(u8) = {&Alu::inc, &Alu::dec, &Alu::swap,
+                                &Alu::rlc, &Alu::rl,  &Alu::rrc,
+                                &Alu::rr,  &Alu::sla, &Alu::sra,
+                                &Alu::srl};
+
+  for (auto op : unary_ops) {
+    for (u16 n = 0; n < 256; ++n) {
+      for (u8 f : {0x00, 0xf0}) {
+        Registers logic_regs;
+        logic_regs.f = f;
+        Registers table_regs = logic_regs;
+        Alu logic(&logic_regs);
+        Alu table(&table_regs);
+        table.setBackend(AluBackend::Table);
+
+        ASSERT_EQ((logic.*op)(static_cast<u8>(n)),
+                  (table.*op)(static_cast<u8>(n)));
+        ASSERT_EQ(logic_regs.f, table_regs.f);
+      }
+    }
+  }
+
+  void (Alu::*accumulator_ops[])() = {&Alu::daa, &Alu::rlca, &Alu::rla,
+                                      &Alu::rrca, &Alu::rra};
+
+  for (auto op : accumulator_ops) {
+    for (u16 a = 0; a < 256; ++a) {
+      for (u16 f = 0; f < 256; f += 0x10) {
+        Registers logic_regs;
+        logic_regs.a = static_cast<u8>(a);
+        logic_regs.f = static_cast<u8>(f);
+        Registers table_regs = logic_regs;
+        Alu logic(&logic_regs);
+        Alu table(&table_regs);
+        table.setBackend(AluBackend::Table);
+
+        (logic.*op)();
+        (table.*op)();
+        ASSERT_EQ(logic_regs.a, table_regs.a);
+        ASSERT_EQ(logic_regs.f, table_regs.f);
+      }
+    }
+  }
+}
+
+TEST(AluTest, tableBackend_withLazyFlags) {
+  Registers regs;
+  regs.a = 0xff;
+  Alu alu(&regs);
+  alu.setBackend(AluBackend::Table);
+  alu.setLazyFlags(true);
+
+  alu.add_n(1);
+  EXPECT_EQ(0x10, alu.inc(0x0f));
+  EXPECT_EQ(0b00110000, alu.get_f() & 0xf0);
+}
+
 }  // namespace gbeml
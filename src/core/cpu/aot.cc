@@ -0,0 +1,77 @@
+#include "core/cpu/aot.h"
+
+#ifndef __EMSCRIPTEN__
+#include <dlfcn.h>
+#endif
+
+#include "core/log/logging.h"
+
+namespace gbeml {
+
+AotLibrary::~AotLibrary() {
+#ifndef __EMSCRIPTEN__
+  if (handle != nullptr) {
+    dlclose(handle);
+  }
+#endif
+}
+
+bool AotLibrary::load([[maybe_unused]] const std::string& filename) {
+#ifndef __EMSCRIPTEN__
+  void* h = dlopen(filename.c_str(), RTLD_NOW | RTLD_LOCAL);
+  if (h == nullptr) {
+    LOG(ERROR) << "Failed to load " << filename << ": " << dlerror()
+               << std::endl;
+    return false;
+  }
+
+  auto code = static_cast<const AotBlock*>(dlsym(h, "gbeml_aot_blocks"));
+  auto num_blocks = static_cast<const u64*>(dlsym(h, "gbeml_aot_num_blocks"));
+  auto hash = static_cast<const u64*>(dlsym(h, "gbeml_aot_rom_hash"));
+  if (code == nullptr || num_blocks == nullptr || hash == nullptr) {
+    LOG(ERROR) << filename << " is not a recompiled rom." << std::endl;
+    dlclose(h);
+    return false;
+  }
+
+  if (handle != nullptr) {
+    dlclose(handle);
+  }
+  handle = h;
+  load(code, *num_blocks, *hash);
+  return true;
+#else
+  LOG(ERROR) << "Recompiled roms are not supported." << std::endl;
+  return false;
+#endif
+}
+
+void AotLibrary::load(const AotBlock* blocks_, u64 num_blocks,
+                      u64 rom_hash_) {
+  blocks.clear();
+  rom_hash = rom_hash_;
+  for (u64 i = 0; i < num_blocks; ++i) {
+    const AotBlock& block = blocks_[i];
+    blocks[block.bank << 16 | block.addr] = block;
+  }
+}
+
+const AotBlock* AotLibrary::find(u32 bank, u16 addr) const {
+  auto it = blocks.find(bank << 16 | addr);
+  return it != blocks.end() ? &it->second : nullptr;
+}
+
+u64 AotLibrary::getNumBlocks() const { return blocks.size(); }
+
+u64 AotLibrary::getRomHash() const { return rom_hash; }
+
+u64 AotLibrary::calcRomHash(const Rom& rom) {
+  // 64-bit FNV-1a.
+  u64 hash = 0xcbf29ce484222325;
+  for (u32 i = 0; i < rom.getRomSize(); ++i) {
+    hash = (hash ^ rom.read(i)) * 0x100000001b3;
+  }
+  return hash;
+}
+
+}  // namespace gbeml
@@ -0,0 +1,42 @@
+#ifndef GBEML_AOT_H_
+#define GBEML_AOT_H_
+
+#include <string>
+#include <unordered_map>
+
+#include "core/cpu/aot_ops.h"
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Code recompiled ahead of time by gbeml_recompile, either loaded from a
+// shared library or built into the binary. The block cache attaches it to the
+// blocks it covers.
+class AotLibrary {
+ public:
+  AotLibrary() {}
+  ~AotLibrary();
+  AotLibrary(const AotLibrary&) = delete;
+  AotLibrary& operator=(const AotLibrary&) = delete;
+
+  // Returns false if the library cannot be loaded. Not available on the web.
+  bool load(const std::string& filename);
+  void load(const AotBlock* blocks_, u64 num_blocks, u64 rom_hash_);
+
+  const AotBlock* find(u32 bank, u16 addr) const;
+  u64 getNumBlocks() const;
+  u64 getRomHash() const;
+
+  // Identifies the rom code was generated for, from all of its bytes.
+  static u64 calcRomHash(const Rom& rom);
+
+ private:
+  void* handle = nullptr;
+  u64 rom_hash = 0;
+  std::unordered_map<u32, AotBlock> blocks;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_AOT_H_
@@ -0,0 +1,300 @@
+#ifndef GBEML_AOT_OPS_H_
+#define GBEML_AOT_OPS_H_
+
+#include "core/cpu/registers.h"
+#include "core/types/types.h"
+
+// Operations used by code generated by the recompiler (see recompiler.h). The
+// generated code only depends on this header, so that it can be built into a
+// shared library on its own.
+
+namespace gbeml {
+
+// State shared by the cpu and recompiled code. The cpu sets it up before it
+// enters the code of a block and applies the results after.
+struct AotContext {
+  Registers* regs;
+  bool ime;
+  // T-cycles and instructions run.
+  u32 cycles;
+  u32 instructions;
+  // Address after the last instruction run.
+  u16 end;
+  // Cycles after which the other components may signal an interrupt. The code
+  // stops before the next instruction once they are reached, so that the cpu
+  // takes the interrupt where the interpreter would.
+  u64 limit;
+  // Set by an instruction the code has to stop after, such as a write to io
+  // or to the mbc.
+  bool stop;
+
+  void* cpu;
+  u8 (*read)(AotContext& c, u16 addr);
+  void (*write)(AotContext& c, u16 addr, u8 value);
+  // Whether addr reads (or takes writes) the same before the other components
+  // catch up on the cycles run as after.
+  bool (*canDefer)(AotContext& c, u16 addr, bool write);
+};
+
+// A block recompiled ahead of time, keyed by the rom bank and the address it
+// starts at. The code can be entered at any of its instructions.
+struct AotBlock {
+  u32 bank;
+  u16 addr;
+  // Size of the instructions recompiled.
+  u16 length;
+  void (*entry)(AotContext& c);
+};
+
+namespace aot {
+
+// Leaves the code before the instruction at pc.
+inline void leave(AotContext& c, u16 pc) {
+  c.regs->pc = pc;
+  c.end = pc;
+}
+
+// Returns false, leaving the code, if the instruction at pc has to wait for
+// the cpu. The first instruction always runs.
+inline bool begin(AotContext& c, u16 pc) {
+  if (c.cycles != 0 && (c.stop || c.cycles >= c.limit)) {
+    leave(c, pc);
+    return false;
+  }
+  return true;
+}
+
+// Returns false, leaving the code, if the instruction at pc cannot access
+// addr (and addr2) before the other components catch up.
+inline bool access(AotContext& c, u16 pc, u16 addr, bool write) {
+  if (c.cycles != 0 && !c.canDefer(c, addr, write)) {
+    leave(c, pc);
+    return false;
+  }
+  return true;
+}
+
+inline bool access(AotContext& c, u16 pc, u16 addr, u16 addr2, bool write) {
+  return access(c, pc, addr, write) && access(c, pc, addr2, write);
+}
+
+inline void retire(AotContext& c, u32 cycles) {
+  c.cycles += cycles;
+  c.instructions++;
+}
+
+inline u8 read(AotContext& c, u16 addr) { return c.read(c, addr); }
+
+inline void write(AotContext& c, u16 addr, u8 value) {
+  c.write(c, addr, value);
+}
+
+// Words are written low byte first, as by the interpreter.
+inline void writeWord(AotContext& c, u16 addr, u16 word) {
+  write(c, addr, static_cast<u8>(word));
+  write(c, static_cast<u16>(addr + 1), static_cast<u8>(word >> 8));
+}
+
+inline void push(AotContext& c, u16 word) {
+  c.regs->sp -= 2;
+  writeWord(c, c.regs->sp, word);
+}
+
+inline u16 pop(AotContext& c) {
+  u8 low = read(c, c.regs->sp);
+  u8 high = read(c, static_cast<u16>(c.regs->sp + 1));
+  c.regs->sp += 2;
+  return concat(high, low);
+}
+
+inline void setFlags(Registers& r, u8 keep, bool z, bool n, bool h, bool c) {
+  r.f = static_cast<u8>((r.f & keep) | z << 7 | n << 6 | h << 5 | c << 4);
+}
+
+inline bool carry(const Registers& r) { return r.f >> 4 & 1; }
+
+inline void add_a(Registers& r, u8 n) {
+  u16 sum = r.a + n;
+  setFlags(r, 0x0f, (sum & 0xff) == 0, false, (r.a & 0xf) + (n & 0xf) > 0xf,
+           sum > 0xff);
+  r.a = static_cast<u8>(sum);
+}
+
+inline void adc_a(Registers& r, u8 n) {
+  u8 c = carry(r);
+  u16 sum = r.a + n + c;
+  setFlags(r, 0x0f, (sum & 0xff) == 0, false,
+           (r.a & 0xf) + (n & 0xf) + c > 0xf, sum > 0xff);
+  r.a = static_cast<u8>(sum);
+}
+
+inline void cp_a(Registers& r, u8 n) {
+  setFlags(r, 0x0f, r.a == n, true, (r.a & 0xf) < (n & 0xf), r.a < n);
+}
+
+inline void sub_a(Registers& r, u8 n) {
+  cp_a(r, n);
+  r.a = static_cast<u8>(r.a - n);
+}
+
+inline void sbc_a(Registers& r, u8 n) {
+  u8 c = carry(r);
+  u8 diff = static_cast<u8>(r.a - n - c);
+  setFlags(r, 0x0f, diff == 0, true, (r.a & 0xf) < (n & 0xf) + c,
+           r.a < n + c);
+  r.a = diff;
+}
+
+inline void and_a(Registers& r, u8 n) {
+  r.a &= n;
+  setFlags(r, 0x0f, r.a == 0, false, true, false);
+}
+
+inline void xor_a(Registers& r, u8 n) {
+  r.a ^= n;
+  setFlags(r, 0x0f, r.a == 0, false, false, false);
+}
+
+inline void or_a(Registers& r, u8 n) {
+  r.a |= n;
+  setFlags(r, 0x0f, r.a == 0, false, false, false);
+}
+
+inline void inc(Registers& r, u8& x) {
+  setFlags(r, 0x1f, static_cast<u8>(x + 1) == 0, false, (x & 0xf) == 0xf,
+           false);
+  x++;
+}
+
+inline void dec(Registers& r, u8& x) {
+  setFlags(r, 0x1f, static_cast<u8>(x - 1) == 0, true, (x & 0xf) == 0, false);
+  x--;
+}
+
+inline void cpl(Registers& r) {
+  r.a = static_cast<u8>(~r.a);
+  r.f |= 0x60;
+}
+
+inline void scf(Registers& r) { r.f = (r.f & 0x8f) | 0x10; }
+
+inline void ccf(Registers& r) { r.f = (r.f & 0x9f) ^ 0x10; }
+
+inline void add_hl(Registers& r, u16 n) {
+  u16 hl = r.hl();
+  setFlags(r, 0x8f, false, false, (hl & 0xfff) + (n & 0xfff) > 0xfff,
+           hl + n > 0xffff);
+  r.set_hl(static_cast<u16>(hl + n));
+}
+
+// Returns sp plus the signed offset n, for add sp, n and ld hl, sp + n.
+inline u16 add_sp(Registers& r, u8 n) {
+  setFlags(r, 0x0f, false, false, (r.sp & 0xf) + (n & 0xf) > 0xf,
+           (r.sp & 0xff) + n > 0xff);
+  return static_cast<u16>(r.sp + static_cast<i8>(n));
+}
+
+inline void daa(Registers& r) {
+  bool n = r.f >> 6 & 1;
+  bool h = r.f >> 5 & 1;
+  bool c = carry(r);
+  u8 a = r.a;
+  if (n) {
+    if (c) {
+      a -= 0x60;
+    }
+    if (h) {
+      a -= 6;
+    }
+  } else {
+    if (c || a > 0x99) {
+      a += 0x60;
+      c = true;
+    }
+    if (h || (a & 0xf) > 9) {
+      a += 6;
+    }
+  }
+  setFlags(r, 0x4f, a == 0, false, false, c);
+  r.a = a;
+}
+
+// The rotates and shifts of the 0xcb prefix, which set Z from the result.
+inline u8 rlc(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x << 1 | x >> 7);
+  setFlags(r, 0x0f, res == 0, false, false, x >> 7);
+  return res;
+}
+
+inline u8 rrc(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x >> 1 | x << 7);
+  setFlags(r, 0x0f, res == 0, false, false, x & 1);
+  return res;
+}
+
+inline u8 rl(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x << 1 | carry(r));
+  setFlags(r, 0x0f, res == 0, false, false, x >> 7);
+  return res;
+}
+
+inline u8 rr(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x >> 1 | carry(r) << 7);
+  setFlags(r, 0x0f, res == 0, false, false, x & 1);
+  return res;
+}
+
+inline u8 sla(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x << 1);
+  setFlags(r, 0x0f, res == 0, false, false, x >> 7);
+  return res;
+}
+
+inline u8 sra(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x >> 1 | (x & 0x80));
+  setFlags(r, 0x0f, res == 0, false, false, x & 1);
+  return res;
+}
+
+inline u8 swap(Registers& r, u8 x) {
+  u8 res = static_cast<u8>(x << 4 | x >> 4);
+  setFlags(r, 0x0f, res == 0, false, false, false);
+  return res;
+}
+
+inline u8 srl(Registers& r, u8 x) {
+  u8 res = x >> 1;
+  setFlags(r, 0x0f, res == 0, false, false, x & 1);
+  return res;
+}
+
+// rlca, rrca, rla and rra clear Z instead.
+inline void rlca(Registers& r) {
+  r.a = rlc(r, r.a);
+  r.f &= 0x7f;
+}
+
+inline void rrca(Registers& r) {
+  r.a = rrc(r, r.a);
+  r.f &= 0x7f;
+}
+
+inline void rla(Registers& r) {
+  r.a = rl(r, r.a);
+  r.f &= 0x7f;
+}
+
+inline void rra(Registers& r) {
+  r.a = rr(r, r.a);
+  r.f &= 0x7f;
+}
+
+inline void bit(Registers& r, u8 i, u8 x) {
+  setFlags(r, 0x1f, (x >> i & 1) == 0, false, true, false);
+}
+
+}  // namespace aot
+
+}  // namespace gbeml
+
+#endif  // GBEML_AOT_OPS_H_
@@ -0,0 +1,315 @@
+#include "core/cpu/aot.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+#include "core/bus/bus.h"
+#include "core/cpu/aot_ops.h"
+#include "core/cpu/cpu.h"
+#include "core/cpu/decoder.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+namespace {
+
+class FlatBus : public Bus {
+ public:
+  FlatBus() : memory(0x10000) {}
+
+  u8 read(u16 addr) const override { return memory[addr]; }
+  void write(u16 addr, u8 value) override { memory[addr] = value; }
+  u32 getRomBank(u16 addr) const override { return addr / 0x4000; }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override {
+    return cycles_until_change;
+  }
+
+  std::vector<u8> memory;
+  u64 cycles_until_change = 0;
+};
+
+Registers runInterpreter(const std::vector<u8>& code, const Registers& regs) {
+  FlatBus bus;
+  for (u16 i = 0; i < code.size(); ++i) {
+    bus.memory[regs.pc + i] = code[i];
+  }
+  InterruptControllerImpl ic;
+  Cpu cpu(&bus, &ic);
+  cpu.setRegisters(regs);
+  cpu.step();
+  return cpu.getRegisters();
+}
+
+// loop: ld hl, 0xc000; inc (hl); ld a, (hl); inc a; jr nz, loop; halt
+void block_0_0x0100(AotContext& c) {
+  using namespace aot;
+  Registers& r = *c.regs;
+  switch (r.pc) {
+    case 0x0100:
+      if (!begin(c, 0x0100)) return;
+      r.set_hl(0xc000);
+      retire(c, 12);
+      [[fallthrough]];
+    case 0x0103:
+      if (!begin(c, 0x0103)) return;
+      if (!access(c, 0x0103, r.hl(), true)) return;
+      { u8 v = read(c, r.hl()); inc(r, v); write(c, r.hl(), v); }
+      retire(c, 12);
+      [[fallthrough]];
+    case 0x0104:
+      if (!begin(c, 0x0104)) return;
+      if (!access(c, 0x0104, r.hl(), false)) return;
+      r.a = read(c, r.hl());
+      retire(c, 8);
+      [[fallthrough]];
+    case 0x0105:
+      if (!begin(c, 0x0105)) return;
+      inc(r, r.a);
+      retire(c, 4);
+      [[fallthrough]];
+    case 0x0106:
+      if (!begin(c, 0x0106)) return;
+      if ((r.f & 0x80) == 0) {
+        r.pc = 0x0100;
+        retire(c, 12);
+      } else {
+        r.pc = 0x0108;
+        retire(c, 8);
+      }
+      c.end = 0x0108;
+      return;
+  }
+}
+
+const AotBlock kBlocks[] = {{0, 0x0100, 8, block_0_0x0100}};
+
+}  // namespace
+
+TEST(AotTest, ops_matchInterpreter) {
+  using AluOp = void (*)(Registers&, u8);
+  const AluOp alu_ops[] = {aot::add_a, aot::adc_a, aot::sub_a, aot::sbc_a,
+                           aot::and_a, aot::xor_a, aot::or_a,  aot::cp_a};
+
+  for (u16 a = 0; a < 256; ++a) {
+    for (u16 f = 0; f < 256; f += 0x10) {
+      Registers regs;
+      regs.a = static_cast<u8>(a);
+      regs.f = static_cast<u8>(f);
+      regs.b = static_cast<u8>(a * 7 + 3);
+      regs.pc = 0xc000;
+      regs.sp = 0xfffe;
+
+      for (u8 y = 0; y < 8; ++y) {
+        Registers expected = runInterpreter({static_cast<u8>(0x80 | y << 3)},
+                                            regs);
+        Registers actual = regs;
+        alu_ops[y](actual, actual.b);
+        actual.pc++;
+        ASSERT_EQ(expected, actual) << "alu " << +y << ", a " << a << ", f "
+                                    << f;
+      }
+
+      Registers actual = regs;
+      aot::inc(actual, actual.b);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x04}, regs), actual);
+
+      actual = regs;
+      aot::dec(actual, actual.b);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x05}, regs), actual);
+
+      actual = regs;
+      aot::cpl(actual);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x2f}, regs), actual);
+
+      actual = regs;
+      aot::scf(actual);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x37}, regs), actual);
+
+      actual = regs;
+      aot::ccf(actual);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x3f}, regs), actual);
+
+      actual = regs;
+      aot::daa(actual);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x27}, regs), actual);
+
+      using Accumulator = void (*)(Registers&);
+      const Accumulator rotates[] = {aot::rlca, aot::rrca, aot::rla,
+                                     aot::rra};
+      for (u8 y = 0; y < 4; ++y) {
+        actual = regs;
+        rotates[y](actual);
+        actual.pc++;
+        ASSERT_EQ(runInterpreter({static_cast<u8>(0x07 | y << 3)}, regs),
+                  actual)
+            << "rotate " << +y;
+      }
+
+      using CbOp = u8 (*)(Registers&, u8);
+      const CbOp cb_ops[] = {aot::rlc, aot::rrc, aot::rl,   aot::rr,
+                             aot::sla, aot::sra, aot::swap, aot::srl};
+      for (u8 y = 0; y < 8; ++y) {
+        actual = regs;
+        actual.b = cb_ops[y](actual, actual.b);
+        actual.pc += 2;
+        ASSERT_EQ(runInterpreter({0xcb, static_cast<u8>(y << 3)}, regs),
+                  actual)
+            << "cb " << +y;
+
+        actual = regs;
+        aot::bit(actual, y, actual.b);
+        actual.pc += 2;
+        ASSERT_EQ(runInterpreter({0xcb, static_cast<u8>(0x40 | y << 3)}, regs),
+                  actual)
+            << "bit " << +y;
+      }
+
+      regs.set_hl(static_cast<u16>(a * 0x123));
+      regs.sp = static_cast<u16>(a * 0x89 + f);
+      actual = regs;
+      aot::add_hl(actual, actual.sp);
+      actual.pc++;
+      ASSERT_EQ(runInterpreter({0x39}, regs), actual);
+
+      actual = regs;
+      actual.sp = aot::add_sp(actual, actual.b);
+      actual.pc += 2;
+      ASSERT_EQ(runInterpreter({0xe8, regs.b}, regs), actual);
+
+      actual = regs;
+      actual.set_hl(aot::add_sp(actual, actual.b));
+      actual.pc += 2;
+      ASSERT_EQ(runInterpreter({0xf8, regs.b}, regs), actual);
+    }
+  }
+}
+
+TEST(AotTest, instructionCycles_matchInterpreter) {
+  // Flags for which the conditions nz, z, nc and c hold.
+  const u8 taken_flags[] = {0x00, 0x80, 0x00, 0x10};
+  const u8 unused[] = {0x10, 0x76, 0xd3, 0xdb, 0xdd, 0xe3,
+                       0xe4, 0xeb, 0xec, 0xed, 0xf4, 0xfc, 0xfd};
+  for (u16 op = 0; op < 256; ++op) {
+    if (std::find(std::begin(unused), std::end(unused), op) !=
+        std::end(unused)) {
+      continue;
+    }
+    u8 x = op >> 6;
+    u8 y = (op >> 3) & 7;
+    i32 condition = -1;
+    if (x == 0 && (op & 7) == 0 && y >= 4) {
+      condition = y - 4;
+    } else if (x == 3 && (op & 7) != 3 && (op & 7) <= 4 && y < 4 &&
+               op != 0xc1 && op != 0xd1 && op != 0xc9 && op != 0xd9) {
+      condition = y;
+    }
+    for (u16 cb_op = 0; cb_op < (op == 0xcb ? 256 : 1); ++cb_op) {
+      for (bool taken : {false, true}) {
+        FlatBus bus;
+        bus.memory[0x0100] = static_cast<u8>(op);
+        bus.memory[0x0101] = static_cast<u8>(cb_op);
+        InterruptControllerImpl ic;
+        Cpu cpu(&bus, &ic);
+        cpu.set_pc(0x0100);
+        cpu.set_sp(0xfffe);
+        if (condition >= 0) {
+          cpu.set_f(taken ? taken_flags[condition]
+                          : taken_flags[condition] ^ (condition < 2 ? 0x80
+                                                                    : 0x10));
+        }
+        u32 expected = static_cast<u32>(cpu.step());
+        ASSERT_EQ(expected, getInstructionCycles(static_cast<u8>(op),
+                                                 static_cast<u8>(cb_op),
+                                                 taken || condition < 0))
+            << std::hex << "op " << op << ", cb " << cb_op << ", taken "
+            << taken;
+      }
+    }
+  }
+}
+
+TEST(AotTest, find) {
+  AotLibrary aot;
+  aot.load(kBlocks, 1, 0x123456);
+  EXPECT_EQ(1, aot.getNumBlocks());
+  EXPECT_EQ(0x123456, aot.getRomHash());
+
+  const AotBlock* block = aot.find(0, 0x0100);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(8, block->length);
+  EXPECT_EQ(block_0_0x0100, block->entry);
+  EXPECT_EQ(nullptr, aot.find(1, 0x0100));
+  EXPECT_EQ(nullptr, aot.find(0, 0x0101));
+}
+
+TEST(AotTest, load_missingLibrary) {
+  AotLibrary aot;
+  EXPECT_FALSE(aot.load("/nonexistent/rom.so"));
+}
+
+TEST(AotTest, cpu_matchesInterpreter) {
+  std::vector<u8> program = {0x21, 0x00, 0xc0, 0x34, 0x7e,
+                             0x3c, 0x20, 0xf8, 0x76};
+
+  AotLibrary aot;
+  aot.load(kBlocks, 1, 0);
+
+  // Without deferred accesses the code leaves before (hl) is accessed, and
+  // the cpu resumes it after.
+  for (u64 cycles_until_change : {u64{0}, UINT64_MAX}) {
+    FlatBus interpreted_bus;
+    FlatBus aot_bus;
+    aot_bus.cycles_until_change = cycles_until_change;
+    for (u16 i = 0; i < program.size(); ++i) {
+      interpreted_bus.memory[0x0100 + i] = program[i];
+      aot_bus.memory[0x0100 + i] = program[i];
+    }
+    InterruptControllerImpl interpreted_ic;
+    InterruptControllerImpl aot_ic;
+    Cpu interpreted(&interpreted_bus, &interpreted_ic);
+    Cpu recompiled(&aot_bus, &aot_ic);
+    recompiled.setAot(&aot);
+
+    u64 interpreted_cycles = 0;
+    u64 interpreted_steps = 0;
+    u64 aot_cycles = 0;
+    u64 aot_steps = 0;
+    for (Cpu* cpu : {&interpreted, &recompiled}) {
+      cpu->set_pc(0x0100);
+      cpu->set_sp(0xfffe);
+    }
+    while (!interpreted.isHalted()) {
+      interpreted_cycles += interpreted.step();
+      interpreted_steps++;
+    }
+    while (!recompiled.isHalted()) {
+      aot_cycles += recompiled.step();
+      aot_steps++;
+    }
+
+    EXPECT_EQ(interpreted.getRegisters(), recompiled.getRegisters());
+    EXPECT_EQ(interpreted_bus.memory, aot_bus.memory);
+    EXPECT_EQ(interpreted_cycles, aot_cycles);
+    EXPECT_EQ(interpreted.getRetiredInstructions(),
+              recompiled.getRetiredInstructions());
+    EXPECT_LT(aot_steps, interpreted_steps);
+    if (cycles_until_change == UINT64_MAX) {
+      // One step per iteration, and halt.
+      EXPECT_EQ(256, aot_steps);
+    }
+  }
+}
+
+}  // namespace gbeml
@@ -0,0 +1,227 @@
+#include "core/cpu/block_cache.h"
+
+#include "core/cpu/aot.h"
+#include "core/cpu/code_analysis.h"
+#include "core/cpu/decoder.h"
+
+namespace gbeml {
+
+const CodeBlock* BlockCache::find(u16 addr) {
+  u16 limit = getLimit(addr);
+  if (limit == 0) {
+    return nullptr;
+  }
+
+  u32 bank = addr <= 0x7fff ? bus->getRomBank(addr) : 0;
+  auto it = blocks.find(bank << 16 | addr);
+  if (it != blocks.end()) {
+    return &it->second;
+  }
+
+  // Peeked, so that the code is not marked as read for coverage, and so that
+  // oam dma does not substitute the bytes it transfers for it.
+  CodeBlock block =
+      decode(addr, limit, [this](u16 pc) { return bus->peek(pc); });
+  if (addr >= 0xc000) {
+    for (u32 i = addr; i < addr + block.code.size(); ++i) {
+      ram_code.set(getRamIndex(static_cast<u16>(i)));
+    }
+  }
+  return insert(bank, std::move(block));
+}
+
+void BlockCache::prefill(const CodeAnalysis& analysis, const Rom& rom) {
+  std::vector<CodeLocation> worklist = analysis.getBlockStarts();
+  while (!worklist.empty()) {
+    CodeLocation location = worklist.back();
+    worklist.pop_back();
+    if (blocks.contains(location.bank << 16 | location.addr)) {
+      continue;
+    }
+
+    u32 base = location.addr <= 0x3fff ? 0 : 0x4000 * (location.bank - 1);
+    const CodeBlock* block =
+        insert(location.bank,
+               decode(location.addr, getLimit(location.addr),
+                      [&rom, base](u16 pc) { return rom.read(base + pc); }));
+
+    // A block cut at the size limit continues in the next one.
+    u16 i = 0;
+    u8 op = 0;
+    while (i < block->code.size()) {
+      op = block->code[i];
+      i += getInstructionLength(op);
+    }
+    u32 end = block->start + block->code.size();
+    if (!block->code.empty() && !endsBlock(op) &&
+        end < getLimit(location.addr)) {
+      worklist.push_back({location.bank, static_cast<u16>(end)});
+    }
+  }
+}
+
+const CodeBlock* BlockCache::findFrom(const CodeBlock* from, u16 addr) {
+  if (from->exit_generation == generation && from->exit_addr == addr) {
+    return from->exit;
+  }
+
+  const CodeBlock* block = find(addr);
+  from->exit = block;
+  from->exit_addr = addr;
+  from->exit_generation = generation;
+  return block;
+}
+
+bool BlockCache::invalidate(u16 addr) {
+  if (addr <= 0x7fff) {
+    // Mbc registers.
+    generation++;
+    return true;
+  }
+
+  i32 index = getRamIndex(addr);
+  if (index < 0 || !ram_code.test(index)) {
+    return false;
+  }
+
+  for (auto it = blocks.begin(); it != blocks.end();) {
+    if (it->second.start >= 0xc000) {
+      it = blocks.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  ram_code.reset();
+  generation++;
+  return true;
+}
+
+template <typename Read>
+CodeBlock BlockCache::decode(u16 addr, u32 limit, Read read) {
+  CodeBlock block{addr, {}};
+  u32 pc = addr;
+  while (pc < limit && block.code.size() < kMaxBlockSize) {
+    u8 op = read(static_cast<u16>(pc));
+    u8 length = getInstructionLength(op);
+    if (pc + length > limit) {
+      break;
+    }
+    for (u8 i = 0; i < length; ++i) {
+      block.code.push_back(read(static_cast<u16>(pc + i)));
+    }
+    pc += length;
+    if (endsBlock(op)) {
+      break;
+    }
+  }
+
+  block.idle_loop = findIdleLoop(block);
+  return block;
+}
+
+const CodeBlock* BlockCache::insert(u32 bank, CodeBlock block) {
+  if (aot != nullptr && block.start <= 0x7fff) {
+    block.aot = aot->find(bank, block.start);
+  }
+  u32 key = bank << 16 | block.start;
+  return &blocks.emplace(key, std::move(block)).first->second;
+}
+
+void BlockCache::clearJit() {
+  for (auto& [key, block] : blocks) {
+    block.hits = 0;
+    block.jit = nullptr;
+  }
+}
+
+void BlockCache::clear() {
+  blocks.clear();
+  ram_code.reset();
+  generation++;
+}
+
+void BlockCache::setAot(const AotLibrary* aot_) {
+  aot = aot_;
+  clear();
+}
+
+std::optional<IdleLoop> BlockCache::findIdleLoop(const CodeBlock& block) {
+  IdleLoop loop{{}, 0, false, 0, 0};
+  u16 i = 0;
+  while (i < block.code.size()) {
+    u8 op = block.code[i];
+    u8 length = getInstructionLength(op);
+    if (i + length > block.code.size()) {
+      return std::nullopt;
+    }
+    u8 low = length > 1 ? block.code[i + 1] : 0;
+    u8 high = length > 2 ? block.code[i + 2] : 0;
+    loop.instructions++;
+
+    if ((op == 0xf0 || op == 0xfa) && loop.num_addrs == IdleLoop::kMaxAddrs) {
+      return std::nullopt;
+    } else if (op == 0xf0) {
+      // ldh a, (n)
+      loop.addrs[loop.num_addrs++] = concat(0xff, low);
+      loop.cycles += 12;
+    } else if (op == 0xfa) {
+      // ld a, (nn)
+      loop.addrs[loop.num_addrs++] = concat(high, low);
+      loop.cycles += 16;
+    } else if (op == 0x7e) {
+      // ld a, (hl)
+      loop.polls_hl = true;
+      loop.cycles += 8;
+    } else if (op == 0xfe || op == 0xe6) {
+      // cp n, and n
+      loop.cycles += 8;
+    } else if ((op >= 0xb8 && op <= 0xbf && op != 0xbe) || op == 0xa7 ||
+               op == 0xb7) {
+      // cp r, and a, or a
+      loop.cycles += 4;
+    } else if (op == 0xcb && (low & 0xc7) == 0x47) {
+      // bit b, a
+      loop.cycles += 8;
+    } else if ((op == 0x18 || op == 0x20 || op == 0x28 || op == 0x30 ||
+                op == 0x38) &&
+               i + length == block.code.size() &&
+               static_cast<u16>(block.start + i + length +
+                                static_cast<i8>(low)) == block.start) {
+      // jr (cc), back to the start.
+      loop.cycles += 12;
+      return loop;
+    } else {
+      return std::nullopt;
+    }
+    i += length;
+  }
+  return std::nullopt;
+}
+
+u16 BlockCache::getLimit(u16 addr) {
+  if (addr <= 0x3fff) {
+    return 0x4000;
+  } else if (addr <= 0x7fff) {
+    return 0x8000;
+  } else if (addr <= 0xbfff) {
+    return 0;
+  } else if (addr <= 0xdfff) {
+    return 0xe000;
+  } else if (addr <= 0xfdff) {
+    return 0xfe00;
+  } else if (addr >= 0xff80 && addr <= 0xfffe) {
+    return 0xffff;
+  }
+  return 0;
+}
+
+i32 BlockCache::getRamIndex(u16 addr) {
+  if (addr >= 0xc000 && addr <= 0xfdff) {
+    return (addr - 0xc000) & 0x1fff;
+  } else if (addr >= 0xff80 && addr <= 0xfffe) {
+    return 0x2000 + addr - 0xff80;
+  }
+  return -1;
+}
+
+}  // namespace gbeml
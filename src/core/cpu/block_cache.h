@@ -0,0 +1,111 @@
+#ifndef GBEML_BLOCK_CACHE_H_
+#define GBEML_BLOCK_CACHE_H_
+
+#include <array>
+#include <bitset>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "core/bus/bus.h"
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+class AotLibrary;
+class CodeAnalysis;
+struct AotBlock;
+struct JitCode;
+
+// A loop back to the start of its block that only reads memory at the first
+// num_addrs of addrs (and at hl if polls_hl), only writes a and f, and whose
+// operations are idempotent. After one iteration it repeats the same way until
+// one of the values it reads changes.
+struct IdleLoop {
+  // Loops that read more are not considered idle.
+  static constexpr u8 kMaxAddrs = 4;
+
+  std::array<u16, kMaxAddrs> addrs;
+  u8 num_addrs;
+  bool polls_hl;
+  // T-cycles and instructions of an iteration that loops back.
+  u16 cycles;
+  u16 instructions;
+};
+
+// A copy of the bytes of a straight-line run of instructions, ending with the
+// first control flow instruction.
+struct CodeBlock {
+  u16 start;
+  std::vector<u8> code;
+  std::optional<IdleLoop> idle_loop = std::nullopt;
+
+  // The block execution continued in last time, valid while the generation
+  // of the cache is unchanged.
+  mutable const CodeBlock* exit = nullptr;
+  mutable u16 exit_addr = 0;
+  mutable u64 exit_generation = 0;
+
+  // Number of times the block was entered at its start, and its native code
+  // once it is translated.
+  mutable u32 hits = 0;
+  mutable const JitCode* jit = nullptr;
+  // The code recompiled ahead of time for the block, if any.
+  const AotBlock* aot = nullptr;
+
+  bool contains(u16 addr) const {
+    return static_cast<u16>(addr - start) < code.size();
+  }
+  u8 read(u16 addr) const { return code[static_cast<u16>(addr - start)]; }
+};
+
+// Caches code blocks in rom, wram and hram, keyed by the rom bank mapped at
+// the start address and the address itself.
+class BlockCache {
+ public:
+  BlockCache(Bus* bus_) : bus(bus_) {}
+
+  // Returns the block starting at addr, decoding it on a miss, or nullptr if
+  // code at addr is not cached.
+  const CodeBlock* find(u16 addr);
+  // Same as find(), but first tries the block execution continued in last
+  // time it left from.
+  const CodeBlock* findFrom(const CodeBlock* from, u16 addr);
+  // Must be called on every cpu write. Returns true if the write may have
+  // changed cached code or the rom mapping, in which case blocks returned by
+  // find() before must not be used anymore.
+  bool invalidate(u16 addr);
+  void clear();
+  // Drops the code Jit::translate() attached to blocks, and restarts their
+  // hit counts.
+  void clearJit();
+  // Blocks in rom found in the library get its code attached.
+  void setAot(const AotLibrary* aot_);
+  // Decodes the blocks at the block starts of the analysis of the rom ahead
+  // of time, reading each from the bank it is in rather than through the bus.
+  void prefill(const CodeAnalysis& analysis, const Rom& rom);
+
+ private:
+  static constexpr u64 kMaxBlockSize = 64;
+
+  Bus* bus;
+  const AotLibrary* aot = nullptr;
+  std::unordered_map<u32, CodeBlock> blocks;
+  // Incremented whenever blocks are dropped or the rom mapping may change.
+  u64 generation = 1;
+  // Bytes of wram (0x0000-0x1fff) and hram (0x2000-0x207e) covered by blocks.
+  std::bitset<0x2000 + 0x7f> ram_code;
+
+  // Decodes the block at addr, reading its bytes with read(pc).
+  template <typename Read>
+  static CodeBlock decode(u16 addr, u32 limit, Read read);
+  const CodeBlock* insert(u32 bank, CodeBlock block);
+  static std::optional<IdleLoop> findIdleLoop(const CodeBlock& block);
+  static u16 getLimit(u16 addr);
+  static i32 getRamIndex(u16 addr);
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_BLOCK_CACHE_H_
@@ -0,0 +1,285 @@
+#include "core/cpu/block_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "core/bus/bus.h"
+#include "core/cpu/code_analysis.h"
+#include "core/cpu/cpu.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+class FakeBus : public Bus {
+ public:
+  FakeBus() : memory(0x10000), banked(0x4000) {}
+
+  u8 read(u16 addr) const override {
+    if (addr >= 0x4000 && addr <= 0x7fff && bank == 2) {
+      return banked[addr - 0x4000];
+    }
+    return memory[addr];
+  }
+  void write(u16 addr, u8 value) override {
+    if (addr == 0x2000) {
+      bank = value;
+      return;
+    }
+    memory[addr] = value;
+  }
+  u32 getRomBank(u16 addr) const override {
+    return addr <= 0x3fff ? 0 : bank;
+  }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override { return 0; }
+
+  std::vector<u8> memory;
+  std::vector<u8> banked;
+  u32 bank = 1;
+};
+
+TEST(BlockCacheTest, find_decodesUntilControlFlow) {
+  FakeBus bus;
+  // ld bc, 0x1234; inc a; jr -6; nop
+  std::vector<u8> code = {0x01, 0x34, 0x12, 0x3c, 0x18, 0xfa, 0x00};
+  for (u16 i = 0; i < code.size(); ++i) {
+    bus.memory[0x0100 + i] = code[i];
+  }
+
+  BlockCache cache(&bus);
+  const CodeBlock* block = cache.find(0x0100);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(0x0100, block->start);
+  EXPECT_EQ(std::vector<u8>(code.begin(), code.end() - 1), block->code);
+  EXPECT_TRUE(block->contains(0x0105));
+  EXPECT_FALSE(block->contains(0x0106));
+  EXPECT_EQ(block, cache.find(0x0100));
+}
+
+TEST(BlockCacheTest, find_decodesMemoryBlockedByDma) {
+  // Reads as if oam dma blocked the bus, which peek() does not see.
+  class DmaBus : public FakeBus {
+   public:
+    u8 read(u16) const override { return 0xff; }
+    u8 peek(u16 addr) const override { return FakeBus::read(addr); }
+  };
+  DmaBus bus;
+  // inc a; jr -3
+  std::vector<u8> code = {0x3c, 0x18, 0xfd};
+  for (u16 i = 0; i < code.size(); ++i) {
+    bus.memory[0x0100 + i] = code[i];
+  }
+
+  BlockCache cache(&bus);
+  const CodeBlock* block = cache.find(0x0100);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(code, block->code);
+}
+
+TEST(BlockCacheTest, find_stopsAtBankBoundary) {
+  FakeBus bus;
+  BlockCache cache(&bus);
+
+  const CodeBlock* block = cache.find(0x3ffe);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(2, block->code.size());
+}
+
+TEST(BlockCacheTest, find_returnsNullForUncachedRegions) {
+  FakeBus bus;
+  BlockCache cache(&bus);
+
+  EXPECT_EQ(nullptr, cache.find(0x8000));
+  EXPECT_EQ(nullptr, cache.find(0xa000));
+  EXPECT_EQ(nullptr, cache.find(0xfe00));
+  EXPECT_EQ(nullptr, cache.find(0xff00));
+}
+
+TEST(BlockCacheTest, find_isKeyedByRomBank) {
+  FakeBus bus;
+  bus.memory[0x4000] = 0x3c;
+  bus.memory[0x4001] = 0xc9;
+  bus.banked[0] = 0x3d;
+  bus.banked[1] = 0xc9;
+
+  BlockCache cache(&bus);
+  const CodeBlock* bank1 = cache.find(0x4000);
+  EXPECT_EQ(0x3c, bank1->read(0x4000));
+
+  bus.write(0x2000, 2);
+  EXPECT_TRUE(cache.invalidate(0x2000));
+  const CodeBlock* bank2 = cache.find(0x4000);
+  EXPECT_EQ(0x3d, bank2->read(0x4000));
+
+  bus.write(0x2000, 1);
+  EXPECT_EQ(bank1, cache.find(0x4000));
+}
+
+TEST(BlockCacheTest, prefill_decodesFromRom) {
+  std::vector<u8> data(0x8000);
+  data[0x148] = 0x00;
+  // jp 0x4000; in bank 1, 100 times inc a, then jp 0x4000.
+  data[0x100] = 0xc3;
+  data[0x101] = 0x00;
+  data[0x102] = 0x40;
+  std::fill(data.begin() + 0x4000, data.begin() + 0x4064, 0x3c);
+  data[0x4064] = 0xc3;
+  data[0x4065] = 0x00;
+  data[0x4066] = 0x40;
+  Rom rom;
+  rom.load(data);
+
+  // The bus maps none of it, so the blocks must come from the rom.
+  FakeBus bus;
+  BlockCache cache(&bus);
+  cache.prefill(CodeAnalysis(rom), rom);
+
+  const CodeBlock* block = cache.find(0x4000);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(64, block->code.size());
+  EXPECT_EQ(0x3c, block->read(0x4000));
+  // The rest of the run, past the size limit of a block.
+  block = cache.find(0x4040);
+  ASSERT_NE(nullptr, block);
+  EXPECT_EQ(std::vector<u8>({0x3c, 0x3c, 0x3c, 0x3c}),
+            std::vector<u8>(block->code.begin(), block->code.begin() + 4));
+  EXPECT_EQ(0xc3, block->read(0x4064));
+}
+
+TEST(BlockCacheTest, invalidate_dropsRamBlocksOnWriteToCode) {
+  FakeBus bus;
+  bus.memory[0xc000] = 0x3c;
+  bus.memory[0xc001] = 0xc9;
+
+  BlockCache cache(&bus);
+  EXPECT_EQ(0x3c, cache.find(0xc000)->read(0xc000));
+
+  EXPECT_FALSE(cache.invalidate(0xc002));
+  EXPECT_FALSE(cache.invalidate(0xff80));
+
+  bus.write(0xc000, 0x3d);
+  EXPECT_TRUE(cache.invalidate(0xc000));
+  EXPECT_EQ(0x3d, cache.find(0xc000)->read(0xc000));
+
+  bus.write(0xc001, 0x00);
+  EXPECT_TRUE(cache.invalidate(0xe001));
+}
+
+TEST(BlockCacheTest, cpu_executesSelfModifiedCode) {
+  FakeBus bus;
+  InterruptControllerImpl ic;
+  // ld a, 0x3d; ld (0xc005), a; inc a, which is overwritten with dec a
+  std::vector<u8> code = {0x3e, 0x3d, 0xea, 0x05, 0xc0, 0x3c, 0x76};
+  for (u16 i = 0; i < code.size(); ++i) {
+    bus.memory[0xc000 + i] = code[i];
+  }
+
+  Cpu cpu(&bus, &ic);
+  cpu.setBlockCache(true);
+  cpu.set_pc(0xc000);
+  cpu.set_sp(0xfffe);
+  cpu.step();
+  cpu.step();
+  cpu.step();
+
+  EXPECT_EQ(0x3c, cpu.get_a());
+  EXPECT_EQ(0xc006, cpu.get_pc());
+}
+
+TEST(BlockCacheTest, find_detectsIdleLoop) {
+  FakeBus bus;
+  // ldh a, (0x44); cp 0x90; jr nz, -6
+  std::vector<u8> polling = {0xf0, 0x44, 0xfe, 0x90, 0x20, 0xfa};
+  // ld a, (0xc000); and a; jr z, -6
+  std::vector<u8> flag = {0xfa, 0x00, 0xc0, 0xa7, 0x28, 0xfa};
+  // ldh a, (0x44); inc b; jr nz, -5
+  std::vector<u8> side_effect = {0xf0, 0x44, 0x04, 0x20, 0xfb};
+  // ldh a, (0x44); cp 0x90; jr nz, 0
+  std::vector<u8> forward = {0xf0, 0x44, 0xfe, 0x90, 0x20, 0x00};
+  for (u16 i = 0; i < 6; ++i) {
+    bus.memory[0x0100 + i] = polling[i];
+    bus.memory[0x0200 + i] = flag[i];
+    bus.memory[0x0400 + i] = forward[i];
+  }
+  for (u16 i = 0; i < 5; ++i) {
+    bus.memory[0x0300 + i] = side_effect[i];
+  }
+
+  BlockCache cache(&bus);
+  const CodeBlock* block = cache.find(0x0100);
+  ASSERT_TRUE(block->idle_loop.has_value());
+  EXPECT_EQ(1, block->idle_loop->num_addrs);
+  EXPECT_EQ(0xff44, block->idle_loop->addrs[0]);
+  EXPECT_FALSE(block->idle_loop->polls_hl);
+  EXPECT_EQ(32, block->idle_loop->cycles);
+  EXPECT_EQ(3, block->idle_loop->instructions);
+
+  block = cache.find(0x0200);
+  ASSERT_TRUE(block->idle_loop.has_value());
+  EXPECT_EQ(1, block->idle_loop->num_addrs);
+  EXPECT_EQ(0xc000, block->idle_loop->addrs[0]);
+  EXPECT_EQ(32, block->idle_loop->cycles);
+
+  EXPECT_FALSE(cache.find(0x0300)->idle_loop.has_value());
+  EXPECT_FALSE(cache.find(0x0400)->idle_loop.has_value());
+
+  // More reads than an IdleLoop holds: 5 x ldh a, (0x44); jr -12
+  for (u16 i = 0; i < 5; ++i) {
+    bus.memory[0x0500 + 2 * i] = 0xf0;
+    bus.memory[0x0501 + 2 * i] = 0x44;
+  }
+  bus.memory[0x050a] = 0x18;
+  bus.memory[0x050b] = 0xf4;
+  EXPECT_FALSE(cache.find(0x0500)->idle_loop.has_value());
+}
+
+TEST(BlockCacheTest, cpu_getIdleLoop) {
+  FakeBus bus;
+  // ld a, (0xc000); and a; jr z, -6
+  std::vector<u8> code = {0xfa, 0x00, 0xc0, 0xa7, 0x28, 0xfa};
+  for (u16 i = 0; i < code.size(); ++i) {
+    bus.memory[0x0100 + i] = code[i];
+  }
+
+  InterruptControllerImpl ic;
+  Cpu cpu(&bus, &ic);
+  cpu.setIdleLoopDetection(true);
+  cpu.set_pc(0x0100);
+  cpu.set_sp(0xfffe);
+
+  // The first iteration may start with any registers, so the loop is only
+  // reported once it has looped back.
+  for (u8 i = 0; i < 3; ++i) {
+    EXPECT_EQ(nullptr, cpu.getIdleLoop());
+    cpu.step();
+  }
+  EXPECT_EQ(nullptr, cpu.getIdleLoop());
+
+  u64 cycles = 0;
+  for (u8 i = 0; i < 3; ++i) {
+    cycles += cpu.step();
+  }
+  const IdleLoop* loop = cpu.getIdleLoop();
+  ASSERT_NE(nullptr, loop);
+  EXPECT_EQ(cycles, loop->cycles);
+
+  u64 retired = cpu.getRetiredInstructions();
+  cpu.skipIdleLoop(10);
+  EXPECT_EQ(retired + 30, cpu.getRetiredInstructions());
+  EXPECT_EQ(320, cpu.getSkippedIdleCycles());
+
+  // Leaving the loop.
+  bus.memory[0xc000] = 1;
+  cpu.step();
+  cpu.step();
+  cpu.step();
+  EXPECT_EQ(0x0106, cpu.get_pc());
+  EXPECT_EQ(nullptr, cpu.getIdleLoop());
+}
+
+}  // namespace gbeml
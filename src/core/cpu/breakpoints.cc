@@ -0,0 +1,49 @@
+#include "core/cpu/breakpoints.h"
+
+namespace gbeml {
+
+void Breakpoints::add(u16 addr, u32 bank) {
+  if (bank == kAnyBank || addr > 0x7fff) {
+    update(&any_bank, addr, true);
+    return;
+  }
+  u32 i = getRomAddress(addr, bank);
+  if (i / 64 >= banked.size()) {
+    banked.resize(i / 64 + 1);
+  }
+  update(&banked, i, true);
+}
+
+void Breakpoints::remove(u16 addr, u32 bank) {
+  if (bank == kAnyBank || addr > 0x7fff) {
+    update(&any_bank, addr, false);
+    return;
+  }
+  u32 i = getRomAddress(addr, bank);
+  if (i / 64 < banked.size()) {
+    update(&banked, i, false);
+  }
+}
+
+void Breakpoints::clear() {
+  any_bank.fill(0);
+  banked.clear();
+  size = 0;
+}
+
+template <typename Bits>
+void Breakpoints::update(Bits* bits, u32 i, bool value) {
+  u64 mask = u64{1} << (i % 64);
+  u64& word = (*bits)[i / 64];
+  if (((word & mask) != 0) == value) {
+    return;
+  }
+  word ^= mask;
+  if (value) {
+    size++;
+  } else {
+    size--;
+  }
+}
+
+}  // namespace gbeml
@@ -0,0 +1,53 @@
+#ifndef GBEML_BREAKPOINTS_H_
+#define GBEML_BREAKPOINTS_H_
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// A set of pc breakpoints. A breakpoint in rom (<= 0x7fff) may be limited to
+// one rom bank, which is then keyed by the address of the instruction in the
+// rom file, so that it only hits while that bank is mapped.
+class Breakpoints {
+ public:
+  static constexpr u32 kAnyBank = UINT32_MAX;
+
+  void add(u16 addr, u32 bank = kAnyBank);
+  void remove(u16 addr, u32 bank = kAnyBank);
+  void clear();
+
+  bool empty() const { return size == 0; }
+  u32 getSize() const { return size; }
+
+  // Whether an instruction at addr, with bank mapped there, hits a breakpoint.
+  bool contains(u16 addr, u32 bank) const {
+    if (test(any_bank, addr)) {
+      return true;
+    }
+    return addr <= 0x7fff && test(banked, getRomAddress(addr, bank));
+  }
+
+ private:
+  std::array<u64, 0x10000 / 64> any_bank = {};
+  // Grown up to the highest bank with a breakpoint.
+  std::vector<u64> banked;
+  u32 size = 0;
+
+  static u32 getRomAddress(u16 addr, u32 bank) {
+    return 0x4000 * bank + (addr & 0x3fff);
+  }
+  template <typename Bits>
+  static bool test(const Bits& bits, u32 i) {
+    return i / 64 < bits.size() && (bits[i / 64] >> (i % 64) & 1);
+  }
+  template <typename Bits>
+  void update(Bits* bits, u32 i, bool value);
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_BREAKPOINTS_H_
@@ -0,0 +1,48 @@
+#include "core/cpu/breakpoints.h"
+
+#include <gtest/gtest.h>
+
+namespace gbeml {
+
+TEST(BreakpointsTest, anyBank) {
+  Breakpoints breakpoints;
+  EXPECT_TRUE(breakpoints.empty());
+
+  breakpoints.add(0x4123);
+  breakpoints.add(0xc000);
+  EXPECT_EQ(2, breakpoints.getSize());
+  EXPECT_TRUE(breakpoints.contains(0x4123, 1));
+  EXPECT_TRUE(breakpoints.contains(0x4123, 7));
+  EXPECT_TRUE(breakpoints.contains(0xc000, 0));
+  EXPECT_FALSE(breakpoints.contains(0x4124, 1));
+
+  breakpoints.remove(0x4123);
+  EXPECT_FALSE(breakpoints.contains(0x4123, 1));
+  EXPECT_EQ(1, breakpoints.getSize());
+}
+
+TEST(BreakpointsTest, banked) {
+  Breakpoints breakpoints;
+  breakpoints.add(0x4123, 3);
+  breakpoints.add(0x4123, 3);
+  breakpoints.add(0x0100, 0);
+  EXPECT_EQ(2, breakpoints.getSize());
+
+  EXPECT_TRUE(breakpoints.contains(0x4123, 3));
+  EXPECT_FALSE(breakpoints.contains(0x4123, 2));
+  EXPECT_FALSE(breakpoints.contains(0x4123, 4));
+  EXPECT_FALSE(breakpoints.contains(0x4123, 0x1ff));
+  EXPECT_TRUE(breakpoints.contains(0x0100, 0));
+  EXPECT_FALSE(breakpoints.contains(0x0100, 1));
+
+  breakpoints.remove(0x4123, 2);
+  EXPECT_EQ(2, breakpoints.getSize());
+  breakpoints.remove(0x4123, 3);
+  EXPECT_FALSE(breakpoints.contains(0x4123, 3));
+
+  breakpoints.clear();
+  EXPECT_TRUE(breakpoints.empty());
+  EXPECT_FALSE(breakpoints.contains(0x0100, 0));
+}
+
+}  // namespace gbeml
@@ -0,0 +1,158 @@
+#include "core/cpu/code_analysis.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#include "core/cpu/aot.h"
+#include "core/cpu/decoder.h"
+
+namespace gbeml {
+
+namespace {
+
+constexpr u32 kUnknownBank = UINT32_MAX;
+
+// A path to walk, starting at addr with the switchable rom bank mapped.
+struct Path {
+  u32 mapped;
+  u16 addr;
+};
+
+}  // namespace
+
+CodeAnalysis::CodeAnalysis(const Rom& rom)
+    : instructions(rom.getRomSize()),
+      block_start_map(rom.getRomSize()),
+      rom_hash(AotLibrary::calcRomHash(rom)) {
+  u32 rom_size = rom.getRomSize();
+  u32 num_banks = rom_size / 0x4000;
+  bool has_mbc = rom.getCartridgeType() != CartridgeType::RomOnly;
+
+  // Rom offset of addr, or rom_size if it is not known or not in rom.
+  auto getOffset = [&](u32 mapped, u32 addr) -> u32 {
+    if (addr <= 0x3fff) {
+      return addr < rom_size ? addr : rom_size;
+    }
+    if (addr > 0x7fff || mapped == kUnknownBank) {
+      return rom_size;
+    }
+    u32 offset = 0x4000 * mapped + (addr & 0x3fff);
+    return offset < rom_size ? offset : rom_size;
+  };
+
+  std::unordered_set<u64> visited;
+  std::vector<Path> worklist;
+  auto addPath = [&](u32 mapped, u32 addr) {
+    u32 offset = getOffset(mapped, addr);
+    if (offset == rom_size) {
+      return;
+    }
+    // Code in bank 0 is walked once per bank it may see mapped.
+    if (visited.insert(static_cast<u64>(mapped) << 16 | addr).second) {
+      worklist.push_back({mapped, static_cast<u16>(addr)});
+      block_start_map[offset] = true;
+    }
+  };
+
+  u32 initial = has_mbc ? kUnknownBank : 1;
+  addPath(1, 0x0100);
+  for (u16 addr = 0x00; addr <= 0x60; addr += 8) {
+    addPath(initial, addr);
+  }
+
+  while (!worklist.empty()) {
+    Path path = worklist.back();
+    worklist.pop_back();
+
+    u32 mapped = path.mapped;
+    u32 pc = path.addr;
+    // The value of a, if set by the previous instruction.
+    i32 a = -1;
+    while (true) {
+      u32 offset = getOffset(mapped, pc);
+      if (offset == rom_size) {
+        break;
+      }
+      u8 op = rom.read(offset);
+      u8 length = getInstructionLength(op);
+      u32 next = pc + length;
+      if (next > (pc <= 0x3fff ? 0x4000u : 0x8000u)) {
+        break;
+      }
+      if (!instructions[offset]) {
+        instructions[offset] = true;
+        instruction_count++;
+      }
+      u8 low = length > 1 ? rom.read(offset + 1) : 0;
+      u8 high = length > 2 ? rom.read(offset + 2) : 0;
+      u16 word = concat(high, low);
+
+      if (op == 0xea && has_mbc && word >= 0x2000 && word <= 0x3fff) {
+        // ld (nn), a to the rom bank register.
+        mapped = a < 0 ? kUnknownBank : std::max(a & 0x1f, 1) % num_banks;
+      } else {
+        a = op == 0x3e ? low : op == 0xaf ? 0 : -1;
+      }
+
+      if (!endsBlock(op)) {
+        pc = next;
+        continue;
+      }
+
+      switch (op) {
+        case 0x18:
+          addPath(mapped, static_cast<u16>(next + static_cast<i8>(low)));
+          break;
+        case 0x20:
+        case 0x28:
+        case 0x30:
+        case 0x38:
+          addPath(mapped, static_cast<u16>(next + static_cast<i8>(low)));
+          addPath(mapped, next);
+          break;
+        case 0xc3:
+          addPath(mapped, word);
+          break;
+        case 0xc2:
+        case 0xca:
+        case 0xd2:
+        case 0xda:
+        case 0xc4:
+        case 0xcc:
+        case 0xcd:
+        case 0xd4:
+        case 0xdc:
+          addPath(mapped, word);
+          addPath(mapped, next);
+          break;
+        case 0x10:
+        case 0x76:
+        case 0xc0:
+        case 0xc8:
+        case 0xd0:
+        case 0xd8:
+          addPath(mapped, next);
+          break;
+        default:
+          if ((op & 0xc7) == 0xc7) {
+            addPath(mapped, op & 0x38);
+            addPath(mapped, next);
+          }
+          // ret, reti, jp hl and the unused opcodes end the path.
+          break;
+      }
+      break;
+    }
+  }
+
+  for (u32 offset = 0; offset < rom_size; ++offset) {
+    if (block_start_map[offset]) {
+      u32 bank = offset / 0x4000;
+      u16 addr = static_cast<u16>(bank == 0 ? offset
+                                            : 0x4000 | (offset & 0x3fff));
+      block_starts.push_back({bank, addr});
+    }
+  }
+}
+
+}  // namespace gbeml
@@ -0,0 +1,64 @@
+#ifndef GBEML_CODE_ANALYSIS_H_
+#define GBEML_CODE_ANALYSIS_H_
+
+#include <vector>
+
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+struct CodeLocation {
+  // 0 below 0x4000.
+  u32 bank;
+  u16 addr;
+
+  bool operator<(const CodeLocation& other) const {
+    return bank != other.bank ? bank < other.bank : addr < other.addr;
+  }
+  bool operator==(const CodeLocation& other) const {
+    return bank == other.bank && addr == other.addr;
+  }
+};
+
+// The code reachable from the entry point and the rst and interrupt vectors of
+// a rom, found by following jumps, calls and rsts without running it.
+//
+// The switchable bank mapped along each path is tracked through writes of a
+// constant to the mbc rom bank register (ld a, n; ld ($2000), a), and assumed
+// to be unchanged by calls. Paths that jump to the switchable bank while it is
+// unknown, like from interrupt handlers, and jumps through hl are not
+// followed. Since every location is read from the bank it names, a wrong
+// guess only adds code that is never run.
+class CodeAnalysis {
+ public:
+  explicit CodeAnalysis(const Rom& rom);
+
+  // Offsets in the rom, see Coverage::getRomAddress().
+  bool isInstructionStart(u32 rom_addr) const {
+    return rom_addr < instructions.size() && instructions[rom_addr];
+  }
+  bool isBlockStart(u32 rom_addr) const {
+    return rom_addr < block_start_map.size() && block_start_map[rom_addr];
+  }
+  u32 getInstructionCount() const { return instruction_count; }
+
+  // Where execution enters a block: the entry points, jump, call and rst
+  // targets and the instructions after control flow, sorted.
+  const std::vector<CodeLocation>& getBlockStarts() const {
+    return block_starts;
+  }
+  // Same as AotLibrary::calcRomHash() of the rom analyzed.
+  u64 getRomHash() const { return rom_hash; }
+
+ private:
+  std::vector<bool> instructions;
+  std::vector<bool> block_start_map;
+  std::vector<CodeLocation> block_starts;
+  u32 instruction_count = 0;
+  u64 rom_hash;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_CODE_ANALYSIS_H_
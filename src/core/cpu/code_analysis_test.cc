@@ -0,0 +1,93 @@
+#include "core/cpu/code_analysis.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+namespace {
+
+void copy(const std::vector<u8>& code, u32 offset, std::vector<u8>* data) {
+  std::copy(code.begin(), code.end(), data->begin() + offset);
+}
+
+// A 64 KiB mbc1 rom, whose main code maps bank n with ld a, n (or with ld a,
+// (hl) if n is negative) and calls 0x4000.
+Rom makeRom(int n) {
+  std::vector<u8> data(0x10000);
+  data[0x147] = 0x01;
+  data[0x148] = 0x01;
+  // nop; jp 0x0150
+  copy({0x00, 0xc3, 0x50, 0x01}, 0x100, &data);
+  // ld a, n; ld (0x2000), a; call 0x4000; halt; jr -2
+  std::vector<u8> main = {0x3e, static_cast<u8>(n), 0xea, 0x00, 0x20,
+                          0xcd, 0x00, 0x40, 0x76, 0x18, 0xfe};
+  if (n < 0) {
+    main[0] = 0x00;
+    main[1] = 0x7e;
+  }
+  copy(main, 0x150, &data);
+  // The vblank handler jumps to the switchable bank, which it cannot know.
+  copy({0xc3, 0x00, 0x41}, 0x40, &data);
+  // ret
+  data[0x200] = 0xc9;
+  // Bank 1: ret
+  data[0x4000] = 0xc9;
+  // Bank 2: call 0x0200; ret
+  copy({0xcd, 0x00, 0x02, 0xc9}, 0x8000, &data);
+
+  Rom rom;
+  rom.load(data);
+  return rom;
+}
+
+bool contains(const std::vector<CodeLocation>& v, CodeLocation x) {
+  return std::find(v.begin(), v.end(), x) != v.end();
+}
+
+}  // namespace
+
+TEST(CodeAnalysisTest, followsBankSwitches) {
+  CodeAnalysis analysis(makeRom(2));
+
+  for (u32 addr : {0x0100, 0x0150, 0x0158, 0x0159, 0x0200, 0x8000, 0x8003}) {
+    EXPECT_TRUE(analysis.isBlockStart(addr)) << std::hex << addr;
+  }
+  EXPECT_FALSE(analysis.isBlockStart(0x4000));
+  for (u32 addr : {0x0150, 0x0152, 0x0155, 0x8000, 0x8003}) {
+    EXPECT_TRUE(analysis.isInstructionStart(addr)) << std::hex << addr;
+  }
+  EXPECT_FALSE(analysis.isInstructionStart(0x0151));
+  EXPECT_FALSE(analysis.isInstructionStart(0x8001));
+  EXPECT_FALSE(analysis.isInstructionStart(0x4000));
+
+  const std::vector<CodeLocation>& starts = analysis.getBlockStarts();
+  EXPECT_TRUE(std::is_sorted(starts.begin(), starts.end()));
+  EXPECT_TRUE(contains(starts, {0, 0x0150}));
+  EXPECT_TRUE(contains(starts, {2, 0x4000}));
+  EXPECT_TRUE(contains(starts, {2, 0x4003}));
+  EXPECT_FALSE(contains(starts, {1, 0x4000}));
+}
+
+TEST(CodeAnalysisTest, skipsUnknownBank) {
+  CodeAnalysis analysis(makeRom(-1));
+
+  EXPECT_TRUE(analysis.isBlockStart(0x0158));
+  for (u32 addr : {0x4000, 0x8000, 0xc000, 0x4100, 0x8100, 0xc100}) {
+    EXPECT_FALSE(analysis.isInstructionStart(addr)) << std::hex << addr;
+  }
+}
+
+TEST(CodeAnalysisTest, bankZeroMapsToBankOne) {
+  CodeAnalysis analysis(makeRom(0));
+
+  EXPECT_TRUE(analysis.isBlockStart(0x4000));
+  EXPECT_FALSE(analysis.isBlockStart(0x8000));
+}
+
+}  // namespace gbeml
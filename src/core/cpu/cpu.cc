@@ -1,60 +1,58 @@
 #include "core/cpu/cpu.h"
 
+#include <bit>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <utility>
+
 #ifndef __EMSCRIPTEN__
 #include <debugbreak.h>
 #endif
+#include "core/cpu/decoder.h"
 #include "core/log/logging.h"
 
 namespace gbeml {
 
-u16 Cpu::get_af() { return af.get() & 0xfff0; }
-u16 Cpu::get_bc() { return bc.get(); }
-u16 Cpu::get_de() { return de.get(); }
-u16 Cpu::get_hl() { return hl.get(); }
-u16 Cpu::get_sp() { return sp.get(); }
-u16 Cpu::get_pc() { return pc.get(); }
-
-void Cpu::set_af(u16 n) { return af.set(n); }
-void Cpu::set_bc(u16 n) { return bc.set(n); }
-void Cpu::set_de(u16 n) { return de.set(n); }
-void Cpu::set_hl(u16 n) { return hl.set(n); }
-void Cpu::set_sp(u16 n) { return sp.set(n); }
-void Cpu::set_pc(u16 n) { return pc.set(n); }
-
-u8 Cpu::get_a() { return alu.get_a(); }
-u8 Cpu::get_b() { return bc.getHigh()->get(); }
-u8 Cpu::get_c() { return bc.getLow()->get(); }
-u8 Cpu::get_d() { return de.getHigh()->get(); }
-u8 Cpu::get_e() { return de.getLow()->get(); }
-u8 Cpu::get_h() { return hl.getHigh()->get(); }
-u8 Cpu::get_l() { return hl.getLow()->get(); }
-bool Cpu::get_carry() { return alu.get_c(); }
-bool Cpu::get_z() { return alu.get_z(); }
-
-void Cpu::set_a(u8 n) { alu.set_a(n); }
-void Cpu::set_f(u8 n) { alu.set_f(n); }
-void Cpu::set_b(u8 n) { bc.getHigh()->set(n); }
-void Cpu::set_c(u8 n) { bc.getLow()->set(n); }
-void Cpu::set_d(u8 n) { de.getHigh()->set(n); }
-void Cpu::set_e(u8 n) { de.getLow()->set(n); }
-void Cpu::set_h(u8 n) { hl.getHigh()->set(n); }
-void Cpu::set_l(u8 n) { hl.getLow()->set(n); }
-void Cpu::set_carry(bool flag) { alu.set_c(flag); }
-void Cpu::set_z(bool flag) { alu.set_z(flag); }
+namespace {
+
+// Wram, its echo and hram, which nothing but the cpu accesses.
+bool isCpuRam(u16 addr) {
+  return (addr >= 0xc000 && addr <= 0xfdff) ||
+         (addr >= 0xff80 && addr <= 0xfffe);
+}
+
+std::string formatRegisters(const Registers& r) {
+  std::ostringstream out;
+  out << std::hex << "af=" << r.af() << " bc=" << r.bc() << " de=" << r.de()
+      << " hl=" << r.hl() << " sp=" << r.sp << " pc=" << r.pc;
+  return out.str();
+}
+
+}  // namespace
 
 void Cpu::tick() {
+  if (instrumented) {
+    tickAs<true>();
+  } else {
+    tickAs<false>();
+  }
+}
+
+template <bool Instrumented>
+void Cpu::tickAs() {
+  runTick<Instrumented>();
+  cycles++;
+}
+
+template <bool Instrumented>
+void Cpu::runTick() {
   if (isStalled()) {
     stalls--;
     return;
   }
 
-#ifndef __EMSCRIPTEN__
-  if (breakpoint > -1 && breakpoint == get_pc()) {
-    debug_break();
-  }
-#endif
-
-  if (ic->isInterruptRequested()) {
+  if (ic->getPendingInterrupts() != 0) {
     halted = false;
     if (interruptEnabled()) {
       handleInterrupt();
@@ -67,16 +65,121 @@ void Cpu::tick() {
     return;
   }
 
-  u8 byte = fetch();
-  Opcode opcode(byte);
-  execute(opcode);
+  if constexpr (Instrumented) {
+    instrument();
+  }
+  if (use_block_cache) {
+    enterBlock();
+    if (!Instrumented && ((use_aot && runAot()) || (use_jit && runJit()))) {
+      stalls--;
+      return;
+    }
+  }
+  instructions[fetch()](this);
+  retired_instructions++;
   stalls--;
 }
 
 void Cpu::advance(u64 n) {
+  if (instrumented) {
+    advanceAs<true>(n);
+  } else {
+    advanceAs<false>(n);
+  }
+}
+
+template <bool Instrumented>
+void Cpu::advanceAs(u64 n) {
   for (u64 i = 0; i < n; ++i) {
-    tick();
+    tickAs<Instrumented>();
+  }
+}
+
+u64 Cpu::step() { return instrumented ? stepAs<true>() : stepAs<false>(); }
+
+template <bool Instrumented>
+u64 Cpu::stepAs() {
+  u64 n = runStep<Instrumented>();
+  cycles += n;
+  return n;
+}
+
+template <bool Instrumented>
+u64 Cpu::runStep() {
+  if (isStalled()) {
+    return takeStalls();
+  }
+
+  if (ic->getPendingInterrupts() != 0) {
+    halted = false;
+    if (interruptEnabled()) {
+      handleInterrupt();
+      return takeStalls();
+    }
+  }
+
+  if (isHalted()) {
+    return 1;
+  }
+
+  if constexpr (Instrumented) {
+    instrument();
+  }
+  if (use_block_cache) {
+    enterBlock();
+    if (!Instrumented && ((use_aot && runAot()) || (use_jit && runJit()))) {
+      return takeStalls();
+    }
+  }
+  instructions[fetch()](this);
+  retired_instructions++;
+  return takeStalls();
+}
+
+bool Cpu::isInstrumented() const { return instrumented; }
+
+void Cpu::updateInstrumented() {
+  instrumented =
+      trace != nullptr || profiler != nullptr || !breakpoints.empty();
+}
+
+void Cpu::instrument() {
+  u32 bank = regs.pc <= 0x7fff ? bus->getRomBank(regs.pc) : 0;
+  // Peeked, so that the instruction is not marked as read for coverage.
+  u8 op = trace != nullptr || profiler != nullptr ? bus->peek(regs.pc) : 0;
+  if (trace != nullptr) {
+    TraceEntry entry = {};
+    entry.cycle = cycles;
+    entry.regs = getRegisters();
+    entry.bank = bank;
+    u8 length = getInstructionLength(op);
+    entry.code[0] = op;
+    for (u8 i = 1; i < length; ++i) {
+      entry.code[i] = bus->peek(regs.pc + i);
+    }
+    entry.ime = ime;
+    trace->record(entry);
+  }
+  if (profiler != nullptr) {
+    profiler->sample(cycles, bank, regs.pc, regs.sp, op,
+                     dispatched_interrupts);
+  }
+  if (!breakpoints.contains(regs.pc, bank)) {
+    return;
+  }
+  if (breakpoint_callback) {
+    breakpoint_callback(regs.pc, bank);
+    return;
   }
+#ifndef __EMSCRIPTEN__
+  debug_break();
+#endif
+}
+
+u64 Cpu::takeStalls() {
+  u64 n = stalls;
+  stalls = 0;
+  return n;
 }
 
 bool Cpu::isStalled() { return stalls > 0; }
@@ -85,236 +188,556 @@ bool Cpu::isHalted() { return halted; }
 
 bool Cpu::interruptEnabled() { return ime; }
 
+u64 Cpu::getRetiredInstructions() const { return retired_instructions; }
+
+void Cpu::setBlockCache(bool enabled) {
+  use_block_cache = enabled;
+  block_cache.clear();
+  block = nullptr;
+  idle_block = nullptr;
+}
+
+void Cpu::setJit(bool enabled, bool differential) {
+  use_jit = enabled && Jit::isSupported();
+  jit_differential = differential;
+  if (use_jit) {
+    setBlockCache(true);
+  }
+}
+
+void Cpu::setIdleLoopDetection(bool enabled) {
+  use_idle_loop_detection = enabled;
+  if (enabled) {
+    setBlockCache(true);
+  }
+}
+
+const IdleLoop* Cpu::getIdleLoop() const {
+  if (!use_idle_loop_detection || stalls > 0 || halted || block == nullptr ||
+      block != idle_block || regs.pc != block->start ||
+      bus->isBlockedByDma(regs.pc)) {
+    return nullptr;
+  }
+  return block->idle_loop ? &*block->idle_loop : nullptr;
+}
+
+void Cpu::skipIdleLoop(u64 n) {
+  const IdleLoop* loop = getIdleLoop();
+  DCHECK(loop != nullptr);
+  retired_instructions += n * loop->instructions;
+  skipped_idle_cycles += n * loop->cycles;
+  cycles += n * loop->cycles;
+}
+
+u64 Cpu::getSkippedIdleCycles() const { return skipped_idle_cycles; }
+
+void Cpu::skipHalted(u64 n) { cycles += n; }
+
+u64 Cpu::getCycles() const { return cycles; }
+
+void Cpu::setTrace(TraceBuffer* buffer) {
+  trace = buffer;
+  updateInstrumented();
+}
+
+void Cpu::setProfiler(Profiler* value) {
+  profiler = value;
+  updateInstrumented();
+}
+
+void Cpu::setCoverage(Coverage* value) { coverage = value; }
+
+u64 Cpu::getDispatchedInterrupts() const { return dispatched_interrupts; }
+
+void Cpu::setAot(const AotLibrary* aot) {
+  use_aot = aot != nullptr;
+  block_cache.setAot(aot);
+  block = nullptr;
+  aot_resume = nullptr;
+  if (use_aot) {
+    setBlockCache(true);
+  }
+}
+
+void Cpu::setInterruptLimit(InterruptLimit limit) {
+  interrupt_limit = std::move(limit);
+  interrupt_deadline = 0;
+}
+
+u64 Cpu::getCyclesUntilInterrupt() {
+  if (cycles >= interrupt_deadline) {
+    u64 n = interrupt_limit ? interrupt_limit() : UINT64_MAX;
+    interrupt_deadline = n > UINT64_MAX - cycles ? UINT64_MAX : cycles + n;
+  }
+  return interrupt_deadline - cycles;
+}
+
+void Cpu::prefillBlockCache(const CodeAnalysis& analysis, const Rom& rom) {
+  if (use_block_cache) {
+    block_cache.prefill(analysis, rom);
+  }
+}
+
+void Cpu::enterBlock() {
+  const CodeBlock* previous = block;
+  // A backward jump within the block, as in a loop, starts a new block at the
+  // target.
+  if (block == nullptr) {
+    block = block_cache.find(regs.pc);
+  } else if (!block->contains(regs.pc) || regs.pc <= block_pc) {
+    block = block_cache.findFrom(block, regs.pc);
+  }
+  block_pc = regs.pc;
+
+  if (block != nullptr && regs.pc == block->start) {
+    idle_block = block == previous ? block : nullptr;
+  }
+}
+
+bool Cpu::runJit() {
+  // The code was translated from the block, not from what oam dma makes the
+  // cpu read.
+  if (block == nullptr || bus->isBlockedByDma(block->start)) {
+    return false;
+  }
+
+  if (block->jit == nullptr) {
+    if (block->start != regs.pc || !use_jit ||
+        ++block->hits != Jit::kHotThreshold) {
+      return false;
+    }
+    block->jit = jit.translate(*block);
+    if (block->jit == nullptr && jit.isDisabled()) {
+      block_cache.clearJit();
+      use_jit = false;
+      return false;
+    }
+    if (block->jit == nullptr && jit.isFull()) {
+      // Code of blocks dropped from the cache is only reclaimed here.
+      LOG(WARNING) << "Jit code buffer is full, dropping all translations."
+                   << std::endl;
+      block_cache.clearJit();
+      jit.reset();
+      block->jit = jit.translate(*block);
+    }
+    if (block->jit == nullptr) {
+      return false;
+    }
+  }
+
+  // The code can be entered at any instruction it covers, as after it left
+  // early.
+  const JitCode& code = *block->jit;
+  u16 offset = static_cast<u16>(regs.pc - block->start);
+  if (offset >= code.length || code.entries[offset] == nullptr) {
+    return false;
+  }
+  if (jit_differential) {
+    return runJitDifferential(code, offset);
+  }
+
+  u16 start = regs.pc;
+  u32 bank = bus->getRomBank(start);
+  enterNative();
+  jit.run(code, offset, &aot_context);
+  return leaveNative(bank, start);
+}
+
+bool Cpu::runJitDifferential(const JitCode& code, u16 offset) {
+  u16 start = regs.pc;
+  u32 bank = bus->getRomBank(start);
+  Registers saved = regs;
+  jit_writes.clear();
+  enterNative();
+  aot_context.write = writeJitDifferential;
+  jit.run(code, offset, &aot_context);
+  aot_context.write = writeAot;
+  Registers native = regs;
+  bool native_ime = aot_context.ime;
+  u32 native_cycles = aot_context.cycles;
+  u32 native_instructions = aot_context.instructions;
+  regs = saved;
+  if (native_instructions == 0) {
+    return false;
+  }
+
+  u64 before = stalls;
+  for (u32 i = 0; i < native_instructions; ++i) {
+    instructions[fetch()](this);
+    retired_instructions++;
+  }
+  bool writes_match = true;
+  for (const auto& [addr, value] : jit_writes) {
+    // Io registers need not read back what was written.
+    if (isCpuRam(addr) && bus->peek(addr) != value) {
+      writes_match = false;
+    }
+  }
+
+  if (native != getRegisters() || native_ime != ime ||
+      native_cycles != stalls - before || !writes_match) {
+    // A wrong translation corrupts the emulation silently, so this stops
+    // release builds too.
+    LOG(FATAL) << "Jit result differs from interpreter at " << std::hex
+               << start << " in bank " << bank << ": jit "
+               << formatRegisters(native) << " ime " << native_ime << " in "
+               << std::dec << native_cycles << " cycles, interpreter "
+               << formatRegisters(regs) << " ime " << ime << " in "
+               << stalls - before << " cycles"
+               << (writes_match ? "." : ", with other writes.") << std::endl;
+    std::abort();
+  }
+  return true;
+}
+
+bool Cpu::runAot() {
+  const AotBlock* code = nullptr;
+  if (aot_resume != nullptr &&
+      static_cast<u16>(regs.pc - aot_resume->addr) < aot_resume->length) {
+    code = aot_resume;
+  } else if (block != nullptr && block->start == regs.pc) {
+    code = block->aot;
+  }
+  aot_resume = nullptr;
+  if (code == nullptr || bus->isBlockedByDma(regs.pc)) {
+    return false;
+  }
+
+  u16 start = regs.pc;
+  enterNative();
+  code->entry(aot_context);
+  if (!leaveNative(code->bank, start)) {
+    return false;
+  }
+  // A write to the mbc may have mapped other code there.
+  if (static_cast<u16>(regs.pc - code->addr) < code->length &&
+      bus->getRomBank(regs.pc) == code->bank) {
+    aot_resume = code;
+  }
+  return true;
+}
+
+void Cpu::enterNative() {
+  // Native code reads and writes F directly.
+  alu.set_f(alu.get_f());
+
+  AotContext& c = aot_context;
+  c.limit = getCyclesUntilInterrupt();
+  c.ime = ime;
+  c.cycles = 0;
+  c.instructions = 0;
+  c.end = regs.pc;
+  c.stop = false;
+}
+
+bool Cpu::leaveNative(u32 bank, u16 start) {
+  const AotContext& c = aot_context;
+  // Entered within an instruction.
+  if (c.instructions == 0) {
+    return false;
+  }
+
+  ime = c.ime;
+  stalls += c.cycles;
+  retired_instructions += c.instructions;
+  if (coverage != nullptr && start <= 0x7fff) {
+    u32 rom_start = Coverage::getRomAddress(bank, start);
+    for (u16 i = 0; i < static_cast<u16>(c.end - start); ++i) {
+      coverage->markExecuted(rom_start + i);
+    }
+  }
+  return true;
+}
+
+u8 Cpu::readAot(AotContext& c, u16 addr) {
+  Cpu* cpu = static_cast<Cpu*>(c.cpu);
+  if (cpu->coverage != nullptr && addr <= 0x7fff) {
+    cpu->markRead(addr);
+  }
+  return cpu->bus->read(addr);
+}
+
+void Cpu::writeAot(AotContext& c, u16 addr, u8 value) {
+  Cpu* cpu = static_cast<Cpu*>(c.cpu);
+  cpu->bus->write(addr, value);
+  if (cpu->block_cache.invalidate(addr)) {
+    cpu->block = nullptr;
+    cpu->idle_block = nullptr;
+    c.stop = true;
+  }
+  // Other writes may signal an interrupt or change what the code reads next.
+  if (!isCpuRam(addr)) {
+    c.stop = true;
+    cpu->interrupt_deadline = 0;
+  }
+}
+
+void Cpu::writeJitDifferential(AotContext& c, u16 addr, u8 value) {
+  static_cast<Cpu*>(c.cpu)->jit_writes.emplace_back(addr, value);
+  // Later instructions would read memory the interpreter has yet to write.
+  c.stop = true;
+}
+
+bool Cpu::canDeferAot(AotContext& c, u16 addr, bool write) {
+  // Only the cpu changes rom (through the mbc), wram and hram, and only wram
+  // and hram can be written without the other components noticing.
+  if (!isCpuRam(addr) && (write || addr > 0x7fff)) {
+    return false;
+  }
+  // Except while oam dma blocks them.
+  return static_cast<Cpu*>(c.cpu)->bus->getCyclesUntilChange(addr) > c.cycles;
+}
+
 u8 Cpu::fetch() {
-  u8 value = readMemory(get_pc());
-  pc.increment();
-  return value;
+  if (coverage != nullptr && regs.pc <= 0x7fff) {
+    coverage->markExecuted(
+        Coverage::getRomAddress(bus->getRomBank(regs.pc), regs.pc));
+  }
+  stalls += 4;
+  // While oam dma blocks the code, the cpu reads the bytes dma transfers.
+  if (block != nullptr && block->contains(regs.pc) &&
+      !bus->isBlockedByDma(regs.pc)) {
+    return block->read(regs.pc++);
+  }
+  // Not through readMemory(), so that code does not count as read.
+  return bus->read(regs.pc++);
+}
+
+template <std::size_t... Ops>
+constexpr std::array<Cpu::Instruction, 256> Cpu::buildDispatchTable(
+    std::index_sequence<Ops...>) {
+  return {[](Cpu* cpu) { cpu->execute<Ops>(); }...};
+}
+
+template <std::size_t... Ops>
+constexpr std::array<Cpu::Instruction, 256> Cpu::buildCbDispatchTable(
+    std::index_sequence<Ops...>) {
+  return {[](Cpu* cpu) { cpu->execute_cb<Ops>(); }...};
 }
 
-void Cpu::execute(const Opcode& opcode) {
-  u8 byte = opcode.get();
+const std::array<Cpu::Instruction, 256> Cpu::instructions =
+    Cpu::buildDispatchTable(std::make_index_sequence<256>());
 
-  if (byte == 0b00000000) {
+const std::array<Cpu::Instruction, 256> Cpu::cb_instructions =
+    Cpu::buildCbDispatchTable(std::make_index_sequence<256>());
+
+// CB
+void Cpu::prefix_cb() { cb_instructions[fetch()](this); }
+
+template <u8 Op>
+void Cpu::execute() {
+  if constexpr (Op == 0b00000000) {
     nop();
-  } else if ((byte & 0b11001111) == 0b00000001) {
-    load_r_n16(opcode);
-  } else if ((byte & 0b11001111) == 0b00000010) {
-    load_r_a(opcode);
-  } else if ((byte & 0b11001111) == 0b00000011) {
-    inc_r16(opcode);
-  } else if ((byte & 0b11000111) == 0b00000100) {
-    inc_r8(opcode);
-  } else if ((byte & 0b11000111) == 0b00000101) {
-    dec_r8(opcode);
-  } else if ((byte & 0b11000111) == 0b00000110) {
-    load_r_n8(opcode);
-  } else if (byte == 0b00000111) {
+  } else if constexpr ((Op & 0b11001111) == 0b00000001) {
+    load_r_n16<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b00000010) {
+    load_r_a<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b00000011) {
+    inc_r16<Op>();
+  } else if constexpr ((Op & 0b11000111) == 0b00000100) {
+    inc_r8<Op>();
+  } else if constexpr ((Op & 0b11000111) == 0b00000101) {
+    dec_r8<Op>();
+  } else if constexpr ((Op & 0b11000111) == 0b00000110) {
+    load_r_n8<Op>();
+  } else if constexpr (Op == 0b00000111) {
     rlca();
-  } else if (byte == 0b00001000) {
+  } else if constexpr (Op == 0b00001000) {
     load_n16_sp();
-  } else if ((byte & 0b11001111) == 0b00001001) {
-    add_hl_r(opcode);
-  } else if ((byte & 0b11001111) == 0b00001010) {
-    load_a_r(opcode);
-  } else if ((byte & 0b11001111) == 0b00001011) {
-    dec_r16(opcode);
-  } else if (byte == 0b00001111) {
+  } else if constexpr ((Op & 0b11001111) == 0b00001001) {
+    add_hl_r<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b00001010) {
+    load_a_r<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b00001011) {
+    dec_r16<Op>();
+  } else if constexpr (Op == 0b00001111) {
     rrca();
-  } else if (byte == 0b00010000) {
+  } else if constexpr (Op == 0b00010000) {
     stop();
-  } else if (byte == 0b00010111) {
+  } else if constexpr (Op == 0b00010111) {
     rla();
-  } else if (byte == 0b00011000) {
+  } else if constexpr (Op == 0b00011000) {
     jr_n();
-  } else if (byte == 0b00011111) {
+  } else if constexpr (Op == 0b00011111) {
     rra();
-  } else if ((byte & 0b11100111) == 0b00100000) {
-    jr_cc_n(opcode);
-  } else if (byte == 0b00100111) {
+  } else if constexpr ((Op & 0b11100111) == 0b00100000) {
+    jr_cc_n<Op>();
+  } else if constexpr (Op == 0b00100111) {
     daa();
-  } else if (byte == 0b00101111) {
+  } else if constexpr (Op == 0b00101111) {
     cpl();
-  } else if (byte == 0b00110111) {
+  } else if constexpr (Op == 0b00110111) {
     scf();
-  } else if (byte == 0b00111111) {
+  } else if constexpr (Op == 0b00111111) {
     ccf();
-  } else if (byte == 0b01110110) {
+  } else if constexpr (Op == 0b01110110) {
     halt();
-  } else if ((byte & 0b11000000) == 0b01000000) {
-    load_r_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10000000) {
-    add_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10001000) {
-    addc_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10010000) {
-    sub_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10011000) {
-    subc_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10100000) {
-    and_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10101000) {
-    xor_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10110000) {
-    or_a_r(opcode);
-  } else if ((byte & 0b11111000) == 0b10111000) {
-    cp_a_r(opcode);
-  } else if ((byte & 0b11100111) == 0b11000000) {
-    ret_cc(opcode);
-  } else if ((byte & 0b11001111) == 0b11000001) {
-    pop(opcode);
-  } else if ((byte & 0b11100111) == 0b11000010) {
-    jp_cc_n16(opcode);
-  } else if (byte == 0b11000011) {
+  } else if constexpr ((Op & 0b11000000) == 0b01000000) {
+    load_r_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10000000) {
+    add_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10001000) {
+    addc_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10010000) {
+    sub_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10011000) {
+    subc_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10100000) {
+    and_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10101000) {
+    xor_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10110000) {
+    or_a_r<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b10111000) {
+    cp_a_r<Op>();
+  } else if constexpr ((Op & 0b11100111) == 0b11000000) {
+    ret_cc<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b11000001) {
+    pop<Op>();
+  } else if constexpr ((Op & 0b11100111) == 0b11000010) {
+    jp_cc_n16<Op>();
+  } else if constexpr (Op == 0b11000011) {
     jp_n16();
-  } else if (byte == 0b11001011) {
-    Opcode next(fetch());
-    execute_cb(next);
-  } else if ((byte & 0b11100111) == 0b11000100) {
-    call_cc_n16(opcode);
-  } else if ((byte & 0b11001111) == 0b11000101) {
-    push(opcode);
-  } else if (byte == 0b11000110) {
+  } else if constexpr (Op == 0b11001011) {
+    prefix_cb();
+  } else if constexpr ((Op & 0b11100111) == 0b11000100) {
+    call_cc_n16<Op>();
+  } else if constexpr ((Op & 0b11001111) == 0b11000101) {
+    push<Op>();
+  } else if constexpr (Op == 0b11000110) {
     add_a_n();
-  } else if ((byte & 0b11000111) == 0b11000111) {
-    rst_n(opcode);
-  } else if (byte == 0b11001001) {
+  } else if constexpr ((Op & 0b11000111) == 0b11000111) {
+    rst_n<Op>();
+  } else if constexpr (Op == 0b11001001) {
     ret();
-  } else if (byte == 0b11001101) {
+  } else if constexpr (Op == 0b11001101) {
     call_n16();
-  } else if (byte == 0b11001110) {
+  } else if constexpr (Op == 0b11001110) {
     addc_a_n();
-  } else if (byte == 0b11010110) {
+  } else if constexpr (Op == 0b11010110) {
     sub_a_n();
-  } else if (byte == 0b11011001) {
+  } else if constexpr (Op == 0b11011001) {
     reti();
-  } else if (byte == 0b11011110) {
+  } else if constexpr (Op == 0b11011110) {
     subc_a_n();
-  } else if (byte == 0b11100000) {
+  } else if constexpr (Op == 0b11100000) {
     load_n_a();
-  } else if (byte == 0b11100010) {
+  } else if constexpr (Op == 0b11100010) {
     load_c_a();
-  } else if (byte == 0b11100110) {
+  } else if constexpr (Op == 0b11100110) {
     and_a_n();
-  } else if (byte == 0b11101000) {
+  } else if constexpr (Op == 0b11101000) {
     add_sp_n();
-  } else if (byte == 0b11101001) {
+  } else if constexpr (Op == 0b11101001) {
     jp_hl();
-  } else if (byte == 0b11101010) {
+  } else if constexpr (Op == 0b11101010) {
     load_n16_a();
-  } else if (byte == 0b11101110) {
+  } else if constexpr (Op == 0b11101110) {
     xor_a_n();
-  } else if (byte == 0b11110000) {
+  } else if constexpr (Op == 0b11110000) {
     load_a_n();
-  } else if (byte == 0b11110010) {
+  } else if constexpr (Op == 0b11110010) {
     load_a_c();
-  } else if (byte == 0b11110011) {
+  } else if constexpr (Op == 0b11110011) {
     di();
-  } else if (byte == 0b11110110) {
+  } else if constexpr (Op == 0b11110110) {
     or_a_n();
-  } else if (byte == 0b11111000) {
+  } else if constexpr (Op == 0b11111000) {
     load_hl_sp_n8();
-  } else if (byte == 0b11111001) {
+  } else if constexpr (Op == 0b11111001) {
     load_sp_hl();
-  } else if (byte == 0b11111010) {
+  } else if constexpr (Op == 0b11111010) {
     load_a_n16();
-  } else if (byte == 0b11111011) {
+  } else if constexpr (Op == 0b11111011) {
     ei();
-  } else if (byte == 0b11111110) {
+  } else if constexpr (Op == 0b11111110) {
     cp_a_n();
   } else {
-    DLOG(WARNING) << "opcode " << opcode.get() << " not implemented."
-                  << std::endl;
-  }
-}
-
-void Cpu::execute_cb(const Opcode& opcode) {
-  u8 byte = opcode.get();
-
-  if ((byte & 0b11111000) == 0b00000000) {
-    rlc_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00001000) {
-    rrc_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00010000) {
-    rl_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00011000) {
-    rr_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00100000) {
-    sla_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00101000) {
-    sra_n(opcode);
-  } else if ((byte & 0b11111000) == 0b00110000) {
-    swap(opcode);
-  } else if ((byte & 0b11111000) == 0b00111000) {
-    srl_n(opcode);
-  } else if ((byte & 0b11000000) == 0b01000000) {
-    bit_b_r(opcode);
-  } else if ((byte & 0b11000000) == 0b10000000) {
-    res_b_r(opcode);
-  } else if ((byte & 0b11000000) == 0b11000000) {
-    set_b_r(opcode);
+    DLOG(WARNING) << "opcode " << Op << " not implemented." << std::endl;
+  }
+}
+
+template <u8 Op>
+void Cpu::execute_cb() {
+  if constexpr ((Op & 0b11111000) == 0b00000000) {
+    rlc_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00001000) {
+    rrc_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00010000) {
+    rl_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00011000) {
+    rr_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00100000) {
+    sla_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00101000) {
+    sra_n<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00110000) {
+    swap<Op>();
+  } else if constexpr ((Op & 0b11111000) == 0b00111000) {
+    srl_n<Op>();
+  } else if constexpr ((Op & 0b11000000) == 0b01000000) {
+    bit_b_r<Op>();
+  } else if constexpr ((Op & 0b11000000) == 0b10000000) {
+    res_b_r<Op>();
+  } else if constexpr ((Op & 0b11000000) == 0b11000000) {
+    set_b_r<Op>();
   } else {
     DCHECK(false);
   }
 }
 
-void Cpu::load_r_n8(const Opcode& opcode) {
-  u8 r = opcode.slice(3, 5);
+template <u8 Op>
+void Cpu::load_r_n8() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(3, 5);
   u8 n = fetch();
-  writeRegister(r, n);
+  writeRegister<r>(n);
 }
 
 // 01xxxyyy
-void Cpu::load_r_r(const Opcode& opcode) {
-  u8 r1 = opcode.slice(3, 5);
-  u8 r2 = opcode.slice(0, 2);
-  u8 n = readRegister(r2);
-  writeRegister(r1, n);
+template <u8 Op>
+void Cpu::load_r_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r1 = opcode.slice(3, 5);
+  constexpr u8 r2 = opcode.slice(0, 2);
+  u8 n = readRegister<r2>();
+  writeRegister<r1>(n);
 }
 
 // 00xx0010
-void Cpu::load_r_a(const Opcode& opcode) {
-  switch (opcode.slice(4, 5)) {
-    case 0:
-      writeMemory(get_bc(), get_a());
-      break;
-    case 1:
-      writeMemory(get_de(), get_a());
-      break;
-    case 2:
-      writeMemory(get_hl(), get_a());
-      hl.increment();
-      break;
-    case 3:
-      writeMemory(get_hl(), get_a());
-      hl.decrement();
-      break;
-    default:
-      DCHECK(false);
-      break;
+template <u8 Op>
+void Cpu::load_r_a() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
+  if constexpr (r == 0) {
+    writeMemory(get_bc(), get_a());
+  } else if constexpr (r == 1) {
+    writeMemory(get_de(), get_a());
+  } else if constexpr (r == 2) {
+    writeMemory(get_hl(), get_a());
+    set_hl(get_hl() + 1);
+  } else {
+    writeMemory(get_hl(), get_a());
+    set_hl(get_hl() - 1);
   }
 }
 
 // 00xx1010
-void Cpu::load_a_r(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::load_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
   u8 value = 0;
-  switch (opcode.slice(4, 5)) {
-    case 0:
-      value = readMemory(get_bc());
-      break;
-    case 1:
-      value = readMemory(get_de());
-      break;
-    case 2:
-      value = readMemory(get_hl());
-      hl.increment();
-      break;
-    case 3:
-      value = readMemory(get_hl());
-      hl.decrement();
-      break;
-    default:
-      DCHECK(false);
-      break;
+  if constexpr (r == 0) {
+    value = readMemory(get_bc());
+  } else if constexpr (r == 1) {
+    value = readMemory(get_de());
+  } else if constexpr (r == 2) {
+    value = readMemory(get_hl());
+    set_hl(get_hl() + 1);
+  } else {
+    value = readMemory(get_hl());
+    set_hl(get_hl() - 1);
   }
   set_a(value);
 }
@@ -339,10 +762,12 @@ void Cpu::load_a_n() {
 
 // 00xx0001
 // cycles = 12
-void Cpu::load_r_n16(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::load_r_n16() {
+  constexpr Opcode opcode(Op);
   u16 n = fetchWord();
-  u8 r = opcode.slice(4, 5);
-  selectRegisterPair(r)->set(n);
+  constexpr u8 r = opcode.slice(4, 5);
+  writeRegisterPair<r>(n);
 }
 
 // 11111001
@@ -355,7 +780,7 @@ void Cpu::load_sp_hl() {
 // 11111000
 // cycles = 12
 void Cpu::load_hl_sp_n8() {
-  u16 word = alu.add_sp_n8(&sp, fetch());
+  u16 word = alu.add_sp_n8(fetch());
   set_hl(word);
   stalls += 4;
 }
@@ -369,25 +794,20 @@ void Cpu::load_n16_sp() {
 
 // 11xx0101
 // cycles = 16
-void Cpu::push(const Opcode& opcode) {
-  u8 r = opcode.slice(4, 5);
+template <u8 Op>
+void Cpu::push() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
   u16 word = 0;
 
-  switch (r) {
-    case 0:
-      word = get_bc();
-      break;
-    case 1:
-      word = get_de();
-      break;
-    case 2:
-      word = get_hl();
-      break;
-    case 3:
-      word = get_af();
-      break;
-    default:
-      DCHECK(false);
+  if constexpr (r == 0) {
+    word = get_bc();
+  } else if constexpr (r == 1) {
+    word = get_de();
+  } else if constexpr (r == 2) {
+    word = get_hl();
+  } else {
+    word = get_af();
   }
 
   pushStack(word);
@@ -396,25 +816,20 @@ void Cpu::push(const Opcode& opcode) {
 
 // 11xx0001
 // cycles = 12
-void Cpu::pop(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::pop() {
+  constexpr Opcode opcode(Op);
   u16 word = popStack();
-  u8 r = opcode.slice(4, 5);
-
-  switch (r) {
-    case 0:
-      set_bc(word);
-      break;
-    case 1:
-      set_de(word);
-      break;
-    case 2:
-      set_hl(word);
-      break;
-    case 3:
-      set_af(word);
-      break;
-    default:
-      DCHECK(false);
+  constexpr u8 r = opcode.slice(4, 5);
+
+  if constexpr (r == 0) {
+    set_bc(word);
+  } else if constexpr (r == 1) {
+    set_de(word);
+  } else if constexpr (r == 2) {
+    set_hl(word);
+  } else {
+    set_af(word);
   }
 }
 
@@ -433,9 +848,11 @@ void Cpu::load_a_n16() {
 }
 
 // 10000xxx
-void Cpu::add_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.add_n(readRegister(r));
+template <u8 Op>
+void Cpu::add_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.add_n(readRegister<r>());
 }
 
 // 11000110
@@ -445,23 +862,29 @@ void Cpu::add_a_n() {
 }
 
 // 10001xxx
-void Cpu::addc_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.addc_n(readRegister(r));
+template <u8 Op>
+void Cpu::addc_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.addc_n(readRegister<r>());
 }
 
 void Cpu::addc_a_n() { alu.addc_n(fetch()); }
 
 // 10010xxx
-void Cpu::sub_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.sub_n(readRegister(r));
+template <u8 Op>
+void Cpu::sub_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.sub_n(readRegister<r>());
 }
 
 // 10011xxx
-void Cpu::subc_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.subc_n(readRegister(r));
+template <u8 Op>
+void Cpu::subc_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.subc_n(readRegister<r>());
 }
 
 void Cpu::subc_a_n() { alu.subc_n(fetch()); }
@@ -479,15 +902,19 @@ void Cpu::and_a_n() {
 }
 
 // 10100xxx
-void Cpu::and_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.and_n(readRegister(r));
+template <u8 Op>
+void Cpu::and_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.and_n(readRegister<r>());
 }
 
 // 10110xxx
-void Cpu::or_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.or_n(readRegister(r));
+template <u8 Op>
+void Cpu::or_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.or_n(readRegister<r>());
 }
 
 // 11110110
@@ -497,9 +924,11 @@ void Cpu::or_a_n() {
 }
 
 // 10101xxx
-void Cpu::xor_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.xor_n(readRegister(r));
+template <u8 Op>
+void Cpu::xor_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.xor_n(readRegister<r>());
 }
 
 // 11101110
@@ -509,9 +938,11 @@ void Cpu::xor_a_n() {
 }
 
 // 10111xxx
-void Cpu::cp_a_r(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  alu.cp_n(readRegister(r));
+template <u8 Op>
+void Cpu::cp_a_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.cp_n(readRegister<r>());
 }
 
 // 11111110
@@ -521,54 +952,66 @@ void Cpu::cp_a_n() {
 }
 
 // 00xxx100
-void Cpu::inc_r8(const Opcode& opcode) {
-  u8 r = opcode.slice(3, 5);
-  u8 n = alu.inc(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::inc_r8() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(3, 5);
+  u8 n = alu.inc(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // 00xxx101
-void Cpu::dec_r8(const Opcode& opcode) {
-  u8 r = opcode.slice(3, 5);
-  u8 n = alu.dec(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::dec_r8() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(3, 5);
+  u8 n = alu.dec(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // 00xx1001
-void Cpu::add_hl_r(const Opcode& opcode) {
-  u8 r = opcode.slice(4, 5);
-  u16 n = selectRegisterPair(r)->get();
-  alu.add_hl_n16(&hl, n);
+template <u8 Op>
+void Cpu::add_hl_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
+  u16 n = readRegisterPair<r>();
+  alu.add_hl_n16(n);
   stalls += 4;
 }
 
 // 11101000
 void Cpu::add_sp_n() {
   u8 n = fetch();
-  u16 word = alu.add_sp_n8(&sp, static_cast<i8>(n));
+  u16 word = alu.add_sp_n8(static_cast<i8>(n));
   set_sp(word);
   stalls += 8;
 }
 
 // 00xx0011
-void Cpu::inc_r16(const Opcode& opcode) {
-  u8 r = opcode.slice(4, 5);
-  selectRegisterPair(r)->increment();
+template <u8 Op>
+void Cpu::inc_r16() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
+  writeRegisterPair<r>(readRegisterPair<r>() + 1);
   stalls += 4;
 }
 
 // 00xx1011
-void Cpu::dec_r16(const Opcode& opcode) {
-  u8 r = opcode.slice(4, 5);
-  selectRegisterPair(r)->decrement();
+template <u8 Op>
+void Cpu::dec_r16() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(4, 5);
+  writeRegisterPair<r>(readRegisterPair<r>() - 1);
   stalls += 4;
 }
 
 // CB + 00110xxx
-void Cpu::swap(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 3);
-  u8 n = alu.swap(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::swap() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 3);
+  u8 n = alu.swap(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // 00100111
@@ -617,75 +1060,95 @@ void Cpu::rrca() { alu.rrca(); }
 void Cpu::rra() { alu.rra(); }
 
 // CB + 00000xxx
-void Cpu::rlc_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.rlc(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::rlc_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.rlc(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00010xxx
-void Cpu::rl_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.rl(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::rl_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.rl(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00001xxx
-void Cpu::rrc_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.rrc(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::rrc_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.rrc(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00011xxx
-void Cpu::rr_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.rr(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::rr_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.rr(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00100xxx
-void Cpu::sla_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.sla(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::sla_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.sla(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00101xxx
-void Cpu::sra_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.sra(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::sra_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.sra(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 00111xxx
-void Cpu::srl_n(const Opcode& opcode) {
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.srl(readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::srl_n() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.srl(readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 01xxxyyy
-void Cpu::bit_b_r(const Opcode& opcode) {
-  u8 i = opcode.slice(3, 5);
-  u8 r = opcode.slice(0, 2);
-  alu.bit_b(i, readRegister(r));
+template <u8 Op>
+void Cpu::bit_b_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 i = opcode.slice(3, 5);
+  constexpr u8 r = opcode.slice(0, 2);
+  alu.bit_b(i, readRegister<r>());
 }
 
 // CB + 11xxxyyy
-void Cpu::set_b_r(const Opcode& opcode) {
-  u8 i = opcode.slice(3, 5);
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.set_b(i, readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::set_b_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 i = opcode.slice(3, 5);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.set_b(i, readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // CB + 10xxxyyy
-void Cpu::res_b_r(const Opcode& opcode) {
-  u8 i = opcode.slice(3, 5);
-  u8 r = opcode.slice(0, 2);
-  u8 n = alu.res_b(i, readRegister(r));
-  writeRegister(r, n);
+template <u8 Op>
+void Cpu::res_b_r() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 i = opcode.slice(3, 5);
+  constexpr u8 r = opcode.slice(0, 2);
+  u8 n = alu.res_b(i, readRegister<r>());
+  writeRegister<r>(n);
 }
 
 // 11000011
@@ -696,10 +1159,12 @@ void Cpu::jp_n16() {
 }
 
 // 110xx010
-void Cpu::jp_cc_n16(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::jp_cc_n16() {
+  constexpr Opcode opcode(Op);
   u16 addr = fetchWord();
-  u8 n = opcode.slice(3, 4);
-  if (checkFlags(n)) {
+  constexpr u8 n = opcode.slice(3, 4);
+  if (checkFlags<n>()) {
     set_pc(addr);
     stalls += 4;
   }
@@ -716,10 +1181,12 @@ void Cpu::jr_n() {
 }
 
 // 001xx000
-void Cpu::jr_cc_n(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::jr_cc_n() {
+  constexpr Opcode opcode(Op);
   u8 offset = fetch();
-  u8 n = opcode.slice(3, 4);
-  if (checkFlags(n)) {
+  constexpr u8 n = opcode.slice(3, 4);
+  if (checkFlags<n>()) {
     jumpRelative(offset);
     stalls += 4;
   }
@@ -735,10 +1202,12 @@ void Cpu::call_n16() {
 
 // 110xx100
 // cycles = 12
-void Cpu::call_cc_n16(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::call_cc_n16() {
+  constexpr Opcode opcode(Op);
   u16 addr = fetchWord();
-  u8 n = opcode.slice(3, 4);
-  if (checkFlags(n)) {
+  constexpr u8 n = opcode.slice(3, 4);
+  if (checkFlags<n>()) {
     call(addr);
     stalls += 4;
   }
@@ -746,40 +1215,13 @@ void Cpu::call_cc_n16(const Opcode& opcode) {
 
 // 11xxx111
 // cycles = 16
-void Cpu::rst_n(const Opcode& opcode) {
+template <u8 Op>
+void Cpu::rst_n() {
+  constexpr Opcode opcode(Op);
   pushStack(get_pc());
 
-  u8 addr = 0;
-  u8 n = opcode.slice(3, 5);
-  switch (n) {
-    case 0:
-      addr = 0x00;
-      break;
-    case 1:
-      addr = 0x08;
-      break;
-    case 2:
-      addr = 0x10;
-      break;
-    case 3:
-      addr = 0x18;
-      break;
-    case 4:
-      addr = 0x20;
-      break;
-    case 5:
-      addr = 0x28;
-      break;
-    case 6:
-      addr = 0x30;
-      break;
-    case 7:
-      addr = 0x38;
-      break;
-    default:
-      DCHECK(false);
-      break;
-  }
+  // 0x00, 0x08, ..., 0x38
+  constexpr u8 addr = opcode.slice(3, 5) * 8;
   set_pc(addr);
   stalls += 4;
 }
@@ -794,9 +1236,11 @@ void Cpu::ret() {
 
 // 110xx000
 // cycles = 20 if true else 8
-void Cpu::ret_cc(const Opcode& opcode) {
-  u8 n = opcode.slice(3, 4);
-  if (checkFlags(n)) {
+template <u8 Op>
+void Cpu::ret_cc() {
+  constexpr Opcode opcode(Op);
+  constexpr u8 n = opcode.slice(3, 4);
+  if (checkFlags<n>()) {
     ret();
   }
   stalls += 4;
@@ -808,78 +1252,97 @@ void Cpu::reti() {
   ime = true;
 }
 
-u8 Cpu::readRegister(u8 r) {
-  switch (r) {
-    case 0:
-      return bc.getHigh()->get();
-    case 1:
-      return bc.getLow()->get();
-    case 2:
-      return de.getHigh()->get();
-    case 3:
-      return de.getLow()->get();
-    case 4:
-      return hl.getHigh()->get();
-    case 5:
-      return hl.getLow()->get();
-    case 6:
-      return readMemory(hl.get());
-    case 7:
-      return af.getHigh()->get();
-    default:
-      DCHECK(false);
-      return 0;
-  }
-}
-
-void Cpu::writeRegister(u8 r, u8 n) {
-  switch (r) {
-    case 0:
-      return bc.getHigh()->set(n);
-    case 1:
-      return bc.getLow()->set(n);
-    case 2:
-      return de.getHigh()->set(n);
-    case 3:
-      return de.getLow()->set(n);
-    case 4:
-      return hl.getHigh()->set(n);
-    case 5:
-      return hl.getLow()->set(n);
-    case 6:
-      return writeMemory(hl.get(), n);
-    case 7:
-      return af.getHigh()->set(n);
-    default:
-      DCHECK(false);
-      return;
+template <u8 R>
+u8 Cpu::readRegister() {
+  if constexpr (R == 0) {
+    return regs.b;
+  } else if constexpr (R == 1) {
+    return regs.c;
+  } else if constexpr (R == 2) {
+    return regs.d;
+  } else if constexpr (R == 3) {
+    return regs.e;
+  } else if constexpr (R == 4) {
+    return regs.h;
+  } else if constexpr (R == 5) {
+    return regs.l;
+  } else if constexpr (R == 6) {
+    return readMemory(regs.hl());
+  } else {
+    return regs.a;
+  }
+}
+
+template <u8 R>
+void Cpu::writeRegister(u8 n) {
+  if constexpr (R == 0) {
+    regs.b = n;
+  } else if constexpr (R == 1) {
+    regs.c = n;
+  } else if constexpr (R == 2) {
+    regs.d = n;
+  } else if constexpr (R == 3) {
+    regs.e = n;
+  } else if constexpr (R == 4) {
+    regs.h = n;
+  } else if constexpr (R == 5) {
+    regs.l = n;
+  } else if constexpr (R == 6) {
+    writeMemory(regs.hl(), n);
+  } else {
+    regs.a = n;
+  }
+}
+
+template <u8 R>
+u16 Cpu::readRegisterPair() {
+  if constexpr (R == 0) {
+    return regs.bc();
+  } else if constexpr (R == 1) {
+    return regs.de();
+  } else if constexpr (R == 2) {
+    return regs.hl();
+  } else {
+    return regs.sp;
   }
 }
 
-RegisterPair* Cpu::selectRegisterPair(u8 r) {
-  switch (r) {
-    case 0:
-      return &bc;
-    case 1:
-      return &de;
-    case 2:
-      return &hl;
-    case 3:
-      return &sp;
-    default:
-      DCHECK(false);
-      return nullptr;
+template <u8 R>
+void Cpu::writeRegisterPair(u16 n) {
+  if constexpr (R == 0) {
+    regs.set_bc(n);
+  } else if constexpr (R == 1) {
+    regs.set_de(n);
+  } else if constexpr (R == 2) {
+    regs.set_hl(n);
+  } else {
+    regs.sp = n;
   }
 }
 
 u8 Cpu::readMemory(u16 addr) {
   stalls += 4;
+  if (coverage != nullptr && addr <= 0x7fff) {
+    markRead(addr);
+  }
   return bus->read(addr);
 }
 
+void Cpu::markRead(u16 addr) {
+  coverage->markRead(Coverage::getRomAddress(bus->getRomBank(addr), addr));
+}
+
 void Cpu::writeMemory(u16 addr, u8 value) {
   stalls += 4;
   bus->write(addr, value);
+  if (!isCpuRam(addr)) {
+    interrupt_deadline = 0;
+  }
+  if (use_block_cache && block_cache.invalidate(addr)) {
+    block = nullptr;
+    idle_block = nullptr;
+    aot_resume = nullptr;
+  }
 }
 
 u16 Cpu::readWord(u16 addr) {
@@ -905,32 +1368,27 @@ void Cpu::jumpRelative(u8 offset) {
   set_pc(static_cast<u16>(get_pc() + static_cast<i8>(offset)));
 }
 
-bool Cpu::checkFlags(u8 n) {
-  switch (n) {
-    case 0:
-      return !alu.get_z();
-    case 1:
-      return alu.get_z();
-    case 2:
-      return !alu.get_c();
-    case 3:
-      return alu.get_c();
-    default:
-      DCHECK(false);
-      return false;
+template <u8 N>
+bool Cpu::checkFlags() {
+  if constexpr (N == 0) {
+    return !alu.get_z();
+  } else if constexpr (N == 1) {
+    return alu.get_z();
+  } else if constexpr (N == 2) {
+    return !alu.get_c();
+  } else {
+    return alu.get_c();
   }
 }
 
 void Cpu::pushStack(u16 word) {
-  sp.decrement();
-  sp.decrement();
-  writeWord(get_sp(), word);
+  regs.sp -= 2;
+  writeWord(regs.sp, word);
 }
 
 u16 Cpu::popStack() {
-  u16 word = readWord(get_sp());
-  sp.increment();
-  sp.increment();
+  u16 word = readWord(regs.sp);
+  regs.sp += 2;
   return word;
 }
 
@@ -944,24 +1402,48 @@ void Cpu::handleInterrupt() {
   stalls += 12;
   ime = false;
 
-  if (ic->isVBlankRequested()) {
-    ic->clearVBlank();
-    call(0x40);
-  } else if (ic->isLcdStatRequested()) {
-    ic->clearLcdStat();
-    call(0x48);
-  } else if (ic->isTimerRequested()) {
-    ic->clearTimer();
-    call(0x50);
-  } else if (ic->isSerialRequested()) {
-    ic->clearSerial();
-    call(0x58);
-  } else if (ic->isJoypadRequested()) {
-    ic->clearJoypad();
-    call(0x60);
-  }
-}
-
-void Cpu::setBreakpoint(i32 value) { breakpoint = value; }
+  using Clear = void (InterruptController::*)();
+  static constexpr Clear kClears[] = {
+      &InterruptController::clearVBlank, &InterruptController::clearLcdStat,
+      &InterruptController::clearTimer, &InterruptController::clearSerial,
+      &InterruptController::clearJoypad};
+
+  u8 pending = ic->getPendingInterrupts();
+  if (pending == 0) {
+    return;
+  }
+  u8 i = static_cast<u8>(std::countr_zero(pending));
+  (ic->*kClears[i])();
+  dispatched_interrupts++;
+  call(static_cast<u16>(0x40 + 8 * i));
+}
+
+void Cpu::addBreakpoint(u16 addr, u32 bank) {
+  breakpoints.add(addr, bank);
+  updateInstrumented();
+}
+
+void Cpu::removeBreakpoint(u16 addr, u32 bank) {
+  breakpoints.remove(addr, bank);
+  updateInstrumented();
+}
+
+void Cpu::clearBreakpoints() {
+  breakpoints.clear();
+  updateInstrumented();
+}
+
+bool Cpu::hasBreakpoints() const { return !breakpoints.empty(); }
+
+void Cpu::setBreakpointCallback(BreakpointCallback callback) {
+  breakpoint_callback = std::move(callback);
+}
+
+template void Cpu::tickAs<false>();
+template void Cpu::tickAs<true>();
+template void Cpu::advanceAs<false>(u64 n);
+template void Cpu::advanceAs<true>(u64 n);
+template u64 Cpu::stepAs<false>();
+template u64 Cpu::stepAs<true>();
 
 }  // namespace gbeml
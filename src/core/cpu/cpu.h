@@ -1,103 +1,284 @@
 #ifndef GBEML_CPU_H_
 #define GBEML_CPU_H_
 
+#include <array>
+#include <functional>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "core/bus/bus.h"
 #include "core/cpu/alu.h"
+#include "core/cpu/aot_ops.h"
+#include "core/cpu/block_cache.h"
+#include "core/cpu/breakpoints.h"
+#include "core/cpu/code_analysis.h"
+#include "core/cpu/jit.h"
 #include "core/cpu/opcode.h"
-#include "core/interrupt/interrupt_controller.h"
-#include "core/register/register.h"
+#include "core/cpu/profiler.h"
+#include "core/cpu/registers.h"
+#include "core/cpu/trace.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/memory/coverage.h"
+#include "core/memory/rom.h"
 #include "core/types/types.h"
 
 namespace gbeml {
 
+// Called with the pc and the rom bank mapped there (0 outside rom) before an
+// instruction at a breakpoint runs.
+using BreakpointCallback = std::function<void(u16 addr, u32 bank)>;
+// Returns a lower bound on the cpu cycles until another component signals an
+// interrupt.
+using InterruptLimit = std::function<u64()>;
+
 class Cpu {
  public:
-  Cpu(Bus* bus_, InterruptController* ic_)
-      : bus(bus_), ic(ic_), af(), bc(), de(), hl(), pc(), sp(), alu(&af) {}
-
-  u16 get_af();
-  u16 get_bc();
-  u16 get_de();
-  u16 get_hl();
-  u16 get_sp();
-  u16 get_pc();
-
-  u8 get_a();
-  u8 get_f();
-  u8 get_b();
-  u8 get_c();
-  u8 get_d();
-  u8 get_e();
-  u8 get_h();
-  u8 get_l();
-
-  bool get_carry();
-  bool get_z();
-
-  void set_af(u16 n);
-  void set_bc(u16 n);
-  void set_de(u16 n);
-  void set_hl(u16 n);
-  void set_sp(u16 n);
-  void set_pc(u16 n);
-
-  void set_a(u8 n);
-  void set_f(u8 n);
-  void set_b(u8 n);
-  void set_c(u8 n);
-  void set_d(u8 n);
-  void set_e(u8 n);
-  void set_h(u8 n);
-  void set_l(u8 n);
-
-  void set_carry(bool flag);
-  void set_z(bool flag);
+  Cpu(Bus* bus_, InterruptControllerImpl* ic_)
+      : bus(bus_), ic(ic_), regs(), alu(&regs), block_cache(bus_) {
+    aot_context.regs = &regs;
+    aot_context.limit = UINT64_MAX;
+    aot_context.cpu = this;
+    aot_context.read = readAot;
+    aot_context.write = writeAot;
+    aot_context.canDefer = canDeferAot;
+  }
+
+  u16 get_af() { return concat(regs.a, alu.get_f()) & 0xfff0; }
+  u16 get_bc() const { return regs.bc(); }
+  u16 get_de() const { return regs.de(); }
+  u16 get_hl() const { return regs.hl(); }
+  u16 get_sp() const { return regs.sp; }
+  u16 get_pc() const { return regs.pc; }
+
+  u8 get_a() const { return regs.a; }
+  u8 get_f() { return alu.get_f(); }
+  u8 get_b() const { return regs.b; }
+  u8 get_c() const { return regs.c; }
+  u8 get_d() const { return regs.d; }
+  u8 get_e() const { return regs.e; }
+  u8 get_h() const { return regs.h; }
+  u8 get_l() const { return regs.l; }
+
+  bool get_carry() { return alu.get_c(); }
+  bool get_z() { return alu.get_z(); }
+
+  void set_af(u16 n) {
+    regs.a = n >> 8;
+    alu.set_f(n & 0xff);
+  }
+  void set_bc(u16 n) { regs.set_bc(n); }
+  void set_de(u16 n) { regs.set_de(n); }
+  void set_hl(u16 n) { regs.set_hl(n); }
+  void set_sp(u16 n) { regs.sp = n; }
+  void set_pc(u16 n) { regs.pc = n; }
+
+  void set_a(u8 n) { regs.a = n; }
+  void set_f(u8 n) { alu.set_f(n); }
+  void set_b(u8 n) { regs.b = n; }
+  void set_c(u8 n) { regs.c = n; }
+  void set_d(u8 n) { regs.d = n; }
+  void set_e(u8 n) { regs.e = n; }
+  void set_h(u8 n) { regs.h = n; }
+  void set_l(u8 n) { regs.l = n; }
+
+  void set_carry(bool flag) { alu.set_c(flag); }
+  void set_z(bool flag) { alu.set_z(flag); }
+
+  const Registers& getRegisters() {
+    regs.f = alu.get_f();
+    return regs;
+  }
+  void setRegisters(const Registers& registers) {
+    regs = registers;
+    alu.set_f(registers.f);
+  }
+
+  void setLazyFlags(bool enabled) { alu.setLazyFlags(enabled); }
+  void setAluBackend(AluBackend backend) { alu.setBackend(backend); }
+  void setBlockCache(bool enabled);
+  // The jit needs the block cache, so enabling it enables the cache too. In
+  // differential mode every native run is also interpreted and the results
+  // are compared. Native runs then stop after their first write, which is
+  // held back until the interpreter makes it.
+  void setJit(bool enabled, bool differential = false);
+  // Runs code recompiled ahead of time where available, through the block
+  // cache. Pass nullptr to stop.
+  void setAot(const AotLibrary* aot);
+  // Recompiled and jit code stop before the cycle limit returns, so that the
+  // interrupt is taken at the same instruction as by the interpreter. The cpu
+  // calls limit only when it is about to run them, and counts down from the
+  // result until then or until it writes outside of ram, which may change
+  // when the others signal. Without a limit they run unbounded.
+  void setInterruptLimit(InterruptLimit limit);
+  // Decodes the code found by the analysis into the block cache, if it is
+  // enabled, so that it is not decoded on first use.
+  void prefillBlockCache(const CodeAnalysis& analysis, const Rom& rom);
+  // Lets getIdleLoop() report idle loops. Needs the block cache, which is
+  // enabled too.
+  void setIdleLoopDetection(bool enabled);
+  // Returns the idle loop the cpu is spinning in if it is about to start
+  // another iteration of it, or nullptr.
+  const IdleLoop* getIdleLoop() const;
+  // Accounts for n iterations of the current idle loop, which the caller ran
+  // by advancing the rest of the system.
+  void skipIdleLoop(u64 n);
+  u64 getSkippedIdleCycles() const;
+  // Accounts for n cycles spent halted, which the caller skipped.
+  void skipHalted(u64 n);
+  // T-cycles since the cpu was created.
+  u64 getCycles() const;
 
   void tick();
   void advance(u64 n);
+  // Runs a whole instruction (or an interrupt dispatch, or one halted cycle)
+  // and returns the number of T-cycles it takes.
+  u64 step();
+  // Same as tick(), advance() and step(), for callers that check
+  // isInstrumented() once for many calls. Instrumented must match it.
+  template <bool Instrumented>
+  void tickAs();
+  template <bool Instrumented>
+  void advanceAs(u64 n);
+  template <bool Instrumented>
+  u64 stepAs();
+  // Whether there are breakpoints, a trace or a profiler.
+  bool isInstrumented() const;
 
   bool isStalled();
   bool isHalted();
   bool interruptEnabled();
 
-  void setBreakpoint(i32 breakpoint);
+  u64 getRetiredInstructions() const;
+  u64 getDispatchedInterrupts() const;
+
+  // While there are breakpoints, a trace or a profiler, the cpu runs a loop
+  // that serves them before each instruction and does not use the jit or aot
+  // code.
+  void addBreakpoint(u16 addr, u32 bank = Breakpoints::kAnyBank);
+  void removeBreakpoint(u16 addr, u32 bank = Breakpoints::kAnyBank);
+  void clearBreakpoints();
+  bool hasBreakpoints() const;
+  // Without a callback, hits break into the debugger.
+  void setBreakpointCallback(BreakpointCallback callback);
+  // Records every instruction into buffer. Pass nullptr to stop.
+  void setTrace(TraceBuffer* buffer);
+  // Reports every instruction to profiler. Pass nullptr to stop.
+  void setProfiler(Profiler* profiler);
+  // Marks the rom bytes fetched or run as native code as executed, and the
+  // ones loaded as data as read. Pass nullptr to stop.
+  void setCoverage(Coverage* coverage);
 
  private:
   Bus* bus;
-  InterruptController* ic;
+  // The concrete type, for the pending interrupts it caches.
+  InterruptControllerImpl* ic;
 
   bool ime;
   u64 stalls = 0;
   bool halted = false;
-  i64 breakpoint = -1;
+  Breakpoints breakpoints;
+  BreakpointCallback breakpoint_callback;
+  bool instrumented = false;
+  TraceBuffer* trace = nullptr;
+  Profiler* profiler = nullptr;
+  Coverage* coverage = nullptr;
+  u64 dispatched_interrupts = 0;
+  u64 cycles = 0;
+  u64 retired_instructions = 0;
 
-  RegisterPair af;
-  RegisterPair bc;
-  RegisterPair de;
-  RegisterPair hl;
-  RegisterPair pc;
-  RegisterPair sp;
+  Registers regs;
 
   Alu alu;
 
+  // When enabled, instruction bytes are fetched from cached copies of the
+  // code instead of through the bus.
+  bool use_block_cache = false;
+  BlockCache block_cache;
+  const CodeBlock* block = nullptr;
+  // Address of the last instruction started in block.
+  u16 block_pc = 0;
+
+  bool use_jit = false;
+  bool use_aot = false;
+  bool jit_differential = false;
+  Jit jit;
+  // Shared by recompiled and jit code.
+  AotContext aot_context;
+  // Writes held back from a native run in differential mode.
+  std::vector<std::pair<u16, u8>> jit_writes;
+  // The recompiled block the last run stopped within, which can be entered
+  // again where it stopped.
+  const AotBlock* aot_resume = nullptr;
+  InterruptLimit interrupt_limit;
+  // The cycle before which no other component signals an interrupt, as of
+  // the last call to interrupt_limit.
+  u64 interrupt_deadline = 0;
+
+  bool use_idle_loop_detection = false;
+  // The block if the cpu last entered it at its start by looping back from
+  // within it.
+  const CodeBlock* idle_block = nullptr;
+  u64 skipped_idle_cycles = 0;
+
+  using Instruction = void (*)(Cpu* cpu);
+
+  // One specialization of execute<Op> / execute_cb<Op> per opcode, so operand
+  // decoding is resolved at compile time.
+  static const std::array<Instruction, 256> instructions;
+  static const std::array<Instruction, 256> cb_instructions;
+
+  template <std::size_t... Ops>
+  static constexpr std::array<Instruction, 256> buildDispatchTable(
+      std::index_sequence<Ops...>);
+  template <std::size_t... Ops>
+  static constexpr std::array<Instruction, 256> buildCbDispatchTable(
+      std::index_sequence<Ops...>);
+
+  template <bool Instrumented>
+  void runTick();
+  template <bool Instrumented>
+  u64 runStep();
+  void updateInstrumented();
+  // Records the trace entry, reports to the profiler and checks breakpoints
+  // for the instruction at pc.
+  void instrument();
+  void enterBlock();
+  bool runJit();
+  bool runJitDifferential(const JitCode& code, u16 offset);
+  bool runAot();
+  u64 getCyclesUntilInterrupt();
+  // Sets up aot_context for native code starting at pc, and applies what it
+  // ran from start, in the rom bank, after. Returns false if nothing ran.
+  void enterNative();
+  bool leaveNative(u32 bank, u16 start);
+  static void writeJitDifferential(AotContext& c, u16 addr, u8 value);
+  static u8 readAot(AotContext& c, u16 addr);
+  static void writeAot(AotContext& c, u16 addr, u8 value);
+  static bool canDeferAot(AotContext& c, u16 addr, bool write);
   u8 fetch();
   u16 fetchWord();
 
-  void execute(const Opcode& opcode);
-  void execute_cb(const Opcode& opcode);
+  template <u8 Op>
+  void execute();
+  template <u8 Op>
+  void execute_cb();
 
   void handleInterrupt();
+  u64 takeStalls();
 
   // 00xxx110
-  void load_r_n8(const Opcode& opcode);
+  template <u8 Op>
+  void load_r_n8();
   // 01xxxyyy
-  void load_r_r(const Opcode& opcode);
+  template <u8 Op>
+  void load_r_r();
   // 00xx0010
-  void load_r_a(const Opcode& opcode);
+  template <u8 Op>
+  void load_r_a();
   // 00xx1010
-  void load_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void load_a_r();
   // 11110010
   void load_a_c();
   // 11100010
@@ -107,7 +288,8 @@ class Cpu {
   // 11110000
   void load_a_n();
   // 00xx0001
-  void load_r_n16(const Opcode& opcode);
+  template <u8 Op>
+  void load_r_n16();
   // 11111001
   void load_sp_hl();
   // 11111000
@@ -115,59 +297,75 @@ class Cpu {
   // 00001000
   void load_n16_sp();
   // 11xx0101
-  void push(const Opcode& opcode);
+  template <u8 Op>
+  void push();
   // 11xx0001
-  void pop(const Opcode& opcode);
+  template <u8 Op>
+  void pop();
   // 11101010
   void load_n16_a();
   // 11111010
   void load_a_n16();
   // 10000xxx
-  void add_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void add_a_r();
   // 11000110
   void add_a_n();
   // 10001xxx
-  void addc_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void addc_a_r();
   // 11001110
   void addc_a_n();
   // 10010xxx
-  void sub_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void sub_a_r();
   // 11010110
   void sub_a_n();
   // 10011xxx
-  void subc_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void subc_a_r();
   // 11011110
   void subc_a_n();
   // 10100xxx
-  void and_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void and_a_r();
   // 11100110
   void and_a_n();
   // 10110xxx
-  void or_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void or_a_r();
   // 11110110
   void or_a_n();
   // 10101xxx
-  void xor_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void xor_a_r();
   // 11101110
   void xor_a_n();
   // 10111xxx
-  void cp_a_r(const Opcode& opcode);
+  template <u8 Op>
+  void cp_a_r();
   // 11111110
   void cp_a_n();
   // 00xxx100
-  void inc_r8(const Opcode& opcode);
+  template <u8 Op>
+  void inc_r8();
   // 00xxx101
-  void dec_r8(const Opcode& opcode);
+  template <u8 Op>
+  void dec_r8();
   // 00xx1001
-  void add_hl_r(const Opcode& opcode);
+  template <u8 Op>
+  void add_hl_r();
   // 11101000
   void add_sp_n();
   // 00xx0011
-  void inc_r16(const Opcode& opcode);
+  template <u8 Op>
+  void inc_r16();
   // 00xx1011
-  void dec_r16(const Opcode& opcode);
+  template <u8 Op>
+  void dec_r16();
   // CB + 00110xxx
-  void swap(const Opcode& opcode);
+  template <u8 Op>
+  void swap();
   // 00100111
   void daa();
   // 00101111
@@ -182,6 +380,8 @@ class Cpu {
   void halt();
   // 10 + 00000000
   void stop();
+  // 11001011
+  void prefix_cb();
   // 11110011
   void di();
   // 11111011
@@ -195,63 +395,85 @@ class Cpu {
   // 00011111
   void rra();
   // CB + 00000xxx
-  void rlc_n(const Opcode& opcode);
+  template <u8 Op>
+  void rlc_n();
   // CB + 00010xxx
-  void rl_n(const Opcode& opcode);
+  template <u8 Op>
+  void rl_n();
   // CB + 00001xxx
-  void rrc_n(const Opcode& opcode);
+  template <u8 Op>
+  void rrc_n();
   // CB + 00011xxx
-  void rr_n(const Opcode& opcode);
+  template <u8 Op>
+  void rr_n();
   // CB + 00100xxx
-  void sla_n(const Opcode& opcode);
+  template <u8 Op>
+  void sla_n();
   // CB + 00101xxx
-  void sra_n(const Opcode& opcode);
+  template <u8 Op>
+  void sra_n();
   // CB + 00111xxx
-  void srl_n(const Opcode& opcode);
+  template <u8 Op>
+  void srl_n();
   // CB + 01xxxyyy
-  void bit_b_r(const Opcode& opcode);
+  template <u8 Op>
+  void bit_b_r();
   // CB + 11000xxx
-  void set_b_r(const Opcode& opcode);
+  template <u8 Op>
+  void set_b_r();
   // CB + 10000xxx
-  void res_b_r(const Opcode& opcode);
+  template <u8 Op>
+  void res_b_r();
   // 11000011
   void jp_n16();
   // 110xx010
-  void jp_cc_n16(const Opcode& opcode);
+  template <u8 Op>
+  void jp_cc_n16();
   // 11101001
   void jp_hl();
   // 00011000
   void jr_n();
   // 001xx000
-  void jr_cc_n(const Opcode& opcode);
+  template <u8 Op>
+  void jr_cc_n();
   // 11001101
   void call_n16();
   // 110xx100
-  void call_cc_n16(const Opcode& opcode);
+  template <u8 Op>
+  void call_cc_n16();
   // 11xxx111
-  void rst_n(const Opcode& opcode);
+  template <u8 Op>
+  void rst_n();
   // 11001001
   void ret();
   // 110xx000
-  void ret_cc(const Opcode& opcode);
+  template <u8 Op>
+  void ret_cc();
   // 11011001
   void reti();
 
-  u8 readRegister(u8 r);
-  void writeRegister(u8 r, u8 n);
+  template <u8 R>
+  u8 readRegister();
+  template <u8 R>
+  void writeRegister(u8 n);
 
-  Register* selectRegister(u8 r);
-  RegisterPair* selectRegisterPair(u8 r);
+  template <u8 R>
+  u16 readRegisterPair();
+  template <u8 R>
+  void writeRegisterPair(u16 n);
 
   u8 readMemory(u16 addr);
   void writeMemory(u16 addr, u8 value);
+  // Marks the rom byte at addr as read for coverage.
+  void markRead(u16 addr);
 
   u16 readWord(u16 addr);
   void writeWord(u16 addr, u16 value);
 
   void jumpRelative(u8 offset);
 
-  bool checkFlags(u8 n);
+  template <u8 N>
+  bool checkFlags();
 
   void pushStack(u16 word);
   u16 popStack();
@@ -0,0 +1,77 @@
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "core/bus/bus.h"
+#include "core/cpu/cpu.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+class FlatBus : public Bus {
+ public:
+  FlatBus() : memory(0x10000) {}
+
+  u8 read(u16 addr) const override { return memory[addr]; }
+  void write(u16 addr, u8 value) override { memory[addr] = value; }
+  u32 getRomBank(u16 addr) const override { return addr / 0x4000; }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override { return 0; }
+
+ private:
+  std::vector<u8> memory;
+};
+
+// ALU-heavy loop at 0x0100:
+//   ld d, 0
+// loop:
+//   add a, b; adc a, c; sub d; sbc a, e; and h; xor l; or b; cp c
+//   inc e; dec h; add a, 3; cp 0x80; jr c, skip; rla
+// skip:
+//   dec d; jr nz, loop; jp 0x0100
+const u8 kAluProgram[] = {0x16, 0x00, 0x80, 0x89, 0x92, 0x9b, 0xa4,
+                          0xad, 0xb0, 0xb9, 0x1c, 0x25, 0xc6, 0x03,
+                          0xfe, 0x80, 0x38, 0x01, 0x17, 0x15, 0x20,
+                          0xec, 0xc3, 0x00, 0x01};
+
+double run(bool lazy_flags, AluBackend backend, u64 num_instructions) {
+  FlatBus bus;
+  for (u16 i = 0; i < sizeof(kAluProgram); ++i) {
+    bus.write(0x0100 + i, kAluProgram[i]);
+  }
+
+  InterruptControllerImpl ic;
+  Cpu cpu(&bus, &ic);
+  cpu.setLazyFlags(lazy_flags);
+  cpu.setAluBackend(backend);
+  cpu.set_pc(0x0100);
+  cpu.set_sp(0xfffe);
+
+  auto start = std::chrono::steady_clock::now();
+  while (cpu.getRetiredInstructions() < num_instructions) {
+    cpu.tick();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double>(end - start).count();
+}
+
+}  // namespace gbeml
+
+int main() {
+  const gbeml::u64 num_instructions = 50'000'000;
+
+  for (auto backend : {gbeml::AluBackend::Logic, gbeml::AluBackend::Table}) {
+    for (bool lazy_flags : {false, true}) {
+      double elapsed = gbeml::run(lazy_flags, backend, num_instructions);
+      std::cout << "alu mix, "
+                << (backend == gbeml::AluBackend::Table ? "table" : "logic")
+                << ", " << (lazy_flags ? "lazy" : "eager")
+                << " flags: " << elapsed << "s, "
+                << num_instructions / elapsed / 1e6 << "M instructions/s"
+                << std::endl;
+    }
+  }
+  return 0;
+}
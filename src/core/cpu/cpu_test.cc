@@ -3,7 +3,12 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <utility>
+#include <vector>
+
 #include "core/bus/bus.h"
+#include "core/cpu/profiler.h"
+#include "core/cpu/trace.h"
 #include "core/interrupt/interrupt_controller_impl.h"
 #include "core/types/types.h"
 
@@ -13,7 +18,10 @@ class MockBus : public Bus {
  public:
   MOCK_CONST_METHOD1(read, u8(u16 addr));
   MOCK_METHOD2(write, void(u16 addr, u8 value));
+  MOCK_CONST_METHOD1(getRomBank, u32(u16 addr));
   MOCK_METHOD0(tick, void());
+  MOCK_METHOD1(advance, void(u64 n));
+  MOCK_CONST_METHOD1(getCyclesUntilChange, u64(u16 addr));
 };
 
 void expectCycles(u8 n, Cpu* cpu) {
@@ -764,6 +772,25 @@ TEST(CpuTest, push_bc) {
   expectCycles(16, cpu);
 }
 
+TEST(CpuTest, push_af_withLazyFlags) {
+  MockBus bus;
+  InterruptControllerImpl ic;
+  EXPECT_CALL(bus, read(0)).WillOnce(testing::Return(0b11111110));
+  EXPECT_CALL(bus, read(1)).WillOnce(testing::Return(0x13));
+  EXPECT_CALL(bus, read(2)).WillOnce(testing::Return(0b11110101));
+  EXPECT_CALL(bus, write(0xfffc, 0x70)).Times(1);
+  EXPECT_CALL(bus, write(0xfffd, 0x12)).Times(1);
+
+  Cpu* cpu = new Cpu(&bus, &ic);
+  cpu->setLazyFlags(true);
+  cpu->set_sp(0xfffe);
+  cpu->set_a(0x12);
+  cpu->tick();
+  expectCycles(8, cpu);
+  cpu->tick();
+  expectCycles(16, cpu);
+}
+
 TEST(CpuTest, push_de) {
   MockBus bus;
   InterruptControllerImpl ic;
@@ -1441,4 +1468,119 @@ TEST(CpuTest, interrupt) {
   EXPECT_EQ(0x60, cpu->get_pc());
 }
 
+TEST(CpuTest, step_returnsCycles) {
+  MockBus bus;
+  InterruptControllerImpl ic(0, 0x1f);
+  EXPECT_CALL(bus, read(0)).WillOnce(testing::Return(0x00));
+  EXPECT_CALL(bus, read(1)).WillOnce(testing::Return(0x01));
+  EXPECT_CALL(bus, read(2)).WillOnce(testing::Return(0x34));
+  EXPECT_CALL(bus, read(3)).WillOnce(testing::Return(0x12));
+  EXPECT_CALL(bus, read(4)).WillOnce(testing::Return(0b11111011));
+  EXPECT_CALL(bus, read(5)).WillOnce(testing::Return(0b01110110));
+  EXPECT_CALL(bus, write(testing::_, testing::_)).Times(2);
+
+  Cpu* cpu = new Cpu(&bus, &ic);
+  cpu->set_sp(0xffff);
+
+  EXPECT_EQ(4, cpu->step());
+  EXPECT_EQ(12, cpu->step());
+  EXPECT_EQ(0x1234, cpu->get_bc());
+  EXPECT_EQ(4, cpu->step());
+  EXPECT_EQ(4, cpu->step());
+  EXPECT_EQ(true, cpu->isHalted());
+
+  EXPECT_EQ(1, cpu->step());
+  EXPECT_EQ(6, cpu->get_pc());
+
+  ic.signalVBlank();
+  EXPECT_EQ(20, cpu->step());
+  EXPECT_EQ(0x40, cpu->get_pc());
+  EXPECT_FALSE(cpu->isStalled());
+  EXPECT_EQ(4, cpu->getRetiredInstructions());
+}
+
+TEST(CpuTest, breakpoint_callsCallback) {
+  MockBus bus;
+  InterruptControllerImpl ic;
+  EXPECT_CALL(bus, read(testing::_)).WillRepeatedly(testing::Return(0x00));
+  EXPECT_CALL(bus, getRomBank(testing::_)).WillRepeatedly(testing::Return(0));
+  EXPECT_CALL(bus, getRomBank(testing::Ge(0x4000)))
+      .WillRepeatedly(testing::Return(5));
+
+  std::vector<std::pair<u16, u32>> hits;
+  Cpu* cpu = new Cpu(&bus, &ic);
+  cpu->setBreakpointCallback(
+      [&hits](u16 addr, u32 bank) { hits.push_back({addr, bank}); });
+  cpu->addBreakpoint(0x0001);
+  cpu->addBreakpoint(0x4000, 4);
+  cpu->addBreakpoint(0x4001, 5);
+  EXPECT_TRUE(cpu->hasBreakpoints());
+
+  for (int i = 0; i < 3; ++i) {
+    cpu->step();
+  }
+  cpu->set_pc(0x4000);
+  for (int i = 0; i < 2; ++i) {
+    cpu->step();
+  }
+  EXPECT_EQ((std::vector<std::pair<u16, u32>>{{0x0001, 0}, {0x4001, 5}}),
+            hits);
+
+  cpu->clearBreakpoints();
+  EXPECT_FALSE(cpu->hasBreakpoints());
+  cpu->set_pc(0x0001);
+  cpu->step();
+  EXPECT_EQ(2, hits.size());
+}
+
+TEST(CpuTest, isInstrumented) {
+  MockBus bus;
+  InterruptControllerImpl ic;
+  Cpu cpu(&bus, &ic);
+  TraceBuffer trace(4);
+  Profiler profiler;
+  EXPECT_FALSE(cpu.isInstrumented());
+
+  cpu.addBreakpoint(0x0100);
+  EXPECT_TRUE(cpu.isInstrumented());
+  cpu.removeBreakpoint(0x0100);
+  EXPECT_FALSE(cpu.isInstrumented());
+  cpu.addBreakpoint(0x0100);
+  cpu.clearBreakpoints();
+  EXPECT_FALSE(cpu.isInstrumented());
+
+  cpu.setTrace(&trace);
+  EXPECT_TRUE(cpu.isInstrumented());
+  cpu.setProfiler(&profiler);
+  cpu.setTrace(nullptr);
+  EXPECT_TRUE(cpu.isInstrumented());
+  cpu.setProfiler(nullptr);
+  EXPECT_FALSE(cpu.isInstrumented());
+}
+
+TEST(CpuTest, coverage_marksFetchesAsExecutedAndLoadsAsRead) {
+  MockBus bus;
+  InterruptControllerImpl ic;
+  // ld a, (0x4150)
+  EXPECT_CALL(bus, read(0x0100)).WillOnce(testing::Return(0xfa));
+  EXPECT_CALL(bus, read(0x0101)).WillOnce(testing::Return(0x50));
+  EXPECT_CALL(bus, read(0x0102)).WillOnce(testing::Return(0x41));
+  EXPECT_CALL(bus, read(0x4150)).WillOnce(testing::Return(0x12));
+  EXPECT_CALL(bus, getRomBank(testing::_)).WillRepeatedly(testing::Return(0));
+  EXPECT_CALL(bus, getRomBank(testing::Ge(0x4000)))
+      .WillRepeatedly(testing::Return(2));
+
+  Coverage coverage(0x10000);
+  Cpu cpu(&bus, &ic);
+  cpu.setCoverage(&coverage);
+  cpu.set_pc(0x0100);
+  cpu.step();
+  EXPECT_EQ(0x12, cpu.get_a());
+  EXPECT_TRUE(coverage.isExecuted(0x0100));
+  EXPECT_TRUE(coverage.isExecuted(0x0102));
+  EXPECT_FALSE(coverage.isRead(0x0101));
+  EXPECT_TRUE(coverage.isRead(0x8150));
+  EXPECT_EQ(1, coverage.getReadCount());
+}
+
 }  // namespace gbeml
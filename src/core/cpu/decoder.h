@@ -0,0 +1,131 @@
+#ifndef GBEML_DECODER_H_
+#define GBEML_DECODER_H_
+
+#include <array>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+constexpr std::array<u8, 256> buildInstructionLengths() {
+  std::array<u8, 256> lengths{};
+  for (u16 op = 0; op < 256; ++op) {
+    lengths[op] = 1;
+  }
+  for (u8 op : {0x06, 0x0e, 0x16, 0x1e, 0x26, 0x2e, 0x36, 0x3e, 0x10, 0x18,
+                0x20, 0x28, 0x30, 0x38, 0xc6, 0xce, 0xd6, 0xde, 0xe6, 0xee,
+                0xf6, 0xfe, 0xe0, 0xf0, 0xe8, 0xf8, 0xcb}) {
+    lengths[op] = 2;
+  }
+  for (u8 op : {0x01, 0x11, 0x21, 0x31, 0x08, 0xc2, 0xc3, 0xca, 0xd2, 0xda,
+                0xc4, 0xcc, 0xcd, 0xd4, 0xdc, 0xea, 0xfa}) {
+    lengths[op] = 3;
+  }
+  return lengths;
+}
+
+inline constexpr std::array<u8, 256> kInstructionLengths =
+    buildInstructionLengths();
+
+// Returns the size of the instruction with the opcode in bytes, including the
+// 0xcb prefix.
+constexpr u8 getInstructionLength(u8 op) { return kInstructionLengths[op]; }
+
+// Returns the T-cycles the instruction takes as the interpreter counts them,
+// with its condition true if taken. cb_op is the opcode after the 0xcb prefix.
+constexpr u32 getInstructionCycles(u8 op, u8 cb_op, bool taken) {
+  if (op == 0xcb) {
+    if ((cb_op & 7) != 6) {
+      return 8;
+    }
+    // bit only reads (hl).
+    return (cb_op & 0xc0) == 0x40 ? 12 : 16;
+  }
+
+  u8 x = op >> 6;
+  u8 y = (op >> 3) & 7;
+  u8 z = op & 7;
+  // Every byte fetched and every memory access takes 4 cycles.
+  u32 cycles = 4 * getInstructionLength(op);
+  if ((x == 1 && (y == 6 || z == 6)) || (x == 2 && z == 6) ||
+      (x == 0 && z == 2) || (x == 0 && z == 6 && y == 6) || op == 0xe0 ||
+      op == 0xf0 || op == 0xe2 || op == 0xf2 || op == 0xea || op == 0xfa) {
+    cycles += 4;
+  } else if ((x == 0 && (z == 4 || z == 5) && y == 6) || op == 0x08) {
+    cycles += 8;
+  } else if ((x == 0 && z == 1 && (y & 1)) || (x == 0 && z == 3) ||
+             op == 0xf8 || op == 0xf9) {
+    cycles += 4;
+  } else if (op == 0xe8) {
+    cycles += 8;
+  } else if (x == 3 && z == 5 && !(y & 1)) {
+    // push
+    cycles += 12;
+  } else if (x == 3 && z == 1 && !(y & 1)) {
+    // pop
+    cycles += 8;
+  } else if (op == 0xc9 || op == 0xd9 || op == 0xcd || (x == 3 && z == 7)) {
+    // ret, reti, call and rst
+    cycles += 12;
+  } else if (op == 0xc3 || op == 0x18) {
+    cycles += 4;
+  } else if (x == 3 && z == 0 && y < 4) {
+    // ret cc
+    cycles += taken ? 16 : 4;
+  } else if ((x == 3 && z == 2 && y < 4) || (x == 0 && z == 0 && y >= 4)) {
+    // jp cc and jr cc
+    cycles += taken ? 4 : 0;
+  } else if (x == 3 && z == 4 && y < 4) {
+    // call cc
+    cycles += taken ? 12 : 0;
+  }
+  return cycles;
+}
+
+// jr, jp, call, ret, reti, rst, halt, stop and the unused opcodes.
+constexpr bool endsBlock(u8 op) {
+  switch (op) {
+    case 0x10:
+    case 0x18:
+    case 0x20:
+    case 0x28:
+    case 0x30:
+    case 0x38:
+    case 0x76:
+    case 0xc0:
+    case 0xc2:
+    case 0xc3:
+    case 0xc4:
+    case 0xc8:
+    case 0xc9:
+    case 0xca:
+    case 0xcc:
+    case 0xcd:
+    case 0xd0:
+    case 0xd2:
+    case 0xd3:
+    case 0xd4:
+    case 0xd8:
+    case 0xd9:
+    case 0xda:
+    case 0xdb:
+    case 0xdc:
+    case 0xdd:
+    case 0xe3:
+    case 0xe4:
+    case 0xe9:
+    case 0xeb:
+    case 0xec:
+    case 0xed:
+    case 0xf4:
+    case 0xfc:
+    case 0xfd:
+      return true;
+    default:
+      return (op & 0xc7) == 0xc7;
+  }
+}
+
+}  // namespace gbeml
+
+#endif  // GBEML_DECODER_H_
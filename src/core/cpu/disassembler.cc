@@ -0,0 +1,166 @@
+#include "core/cpu/disassembler.h"
+
+#include <cstdio>
+
+#include "core/cpu/opcode.h"
+
+namespace gbeml {
+
+namespace {
+
+constexpr const char* kR8[] = {"b", "c", "d", "e", "h", "l", "(hl)", "a"};
+constexpr const char* kR16[] = {"bc", "de", "hl", "sp"};
+constexpr const char* kR16Stack[] = {"bc", "de", "hl", "af"};
+constexpr const char* kR16Memory[] = {"(bc)", "(de)", "(hl+)", "(hl-)"};
+constexpr const char* kConditions[] = {"nz", "z", "nc", "c"};
+constexpr const char* kAlu[] = {"add a,", "adc a,", "sub", "sbc a,",
+                                "and",    "xor",    "or",  "cp"};
+constexpr const char* kRotates[] = {"rlc", "rrc", "rl",   "rr",
+                                    "sla", "sra", "swap", "srl"};
+constexpr const char* kAccumulator[] = {"rlca", "rrca", "rla", "rra",
+                                        "daa",  "cpl",  "scf", "ccf"};
+
+std::string format(const char* fmt, auto... args) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), fmt, args...);
+  return buffer;
+}
+
+std::string disassembleCb(u8 op) {
+  Opcode opcode(op);
+  const char* r = kR8[opcode.slice(0, 2)];
+  u8 bit = opcode.slice(3, 5);
+  switch (opcode.slice(6, 7)) {
+    case 0:
+      return format("%s %s", kRotates[bit], r);
+    case 1:
+      return format("bit %d, %s", bit, r);
+    case 2:
+      return format("res %d, %s", bit, r);
+    default:
+      return format("set %d, %s", bit, r);
+  }
+}
+
+}  // namespace
+
+std::string disassemble(const u8* code, u16 pc) {
+  Opcode opcode(code[0]);
+  u8 n8 = code[1];
+  u16 n16 = concat(code[2], code[1]);
+  u16 target = pc + 2 + static_cast<i8>(n8);
+  u8 x = opcode.slice(6, 7);
+  u8 y = opcode.slice(3, 5);
+  u8 z = opcode.slice(0, 2);
+
+  if (x == 1) {
+    if (code[0] == 0x76) {
+      return "halt";
+    }
+    return format("ld %s, %s", kR8[y], kR8[z]);
+  }
+  if (x == 2) {
+    return format("%s %s", kAlu[y], kR8[z]);
+  }
+
+  if (x == 0) {
+    switch (z) {
+      case 0:
+        switch (y) {
+          case 0:
+            return "nop";
+          case 1:
+            return format("ld ($%04x), sp", n16);
+          case 2:
+            return "stop";
+          case 3:
+            return format("jr $%04x", target);
+          default:
+            return format("jr %s, $%04x", kConditions[y - 4], target);
+        }
+      case 1:
+        if (y & 1) {
+          return format("add hl, %s", kR16[y >> 1]);
+        }
+        return format("ld %s, $%04x", kR16[y >> 1], n16);
+      case 2:
+        if (y & 1) {
+          return format("ld a, %s", kR16Memory[y >> 1]);
+        }
+        return format("ld %s, a", kR16Memory[y >> 1]);
+      case 3:
+        return format("%s %s", y & 1 ? "dec" : "inc", kR16[y >> 1]);
+      case 4:
+        return format("inc %s", kR8[y]);
+      case 5:
+        return format("dec %s", kR8[y]);
+      case 6:
+        return format("ld %s, $%02x", kR8[y], n8);
+      default:
+        return kAccumulator[y];
+    }
+  }
+
+  switch (code[0]) {
+    case 0xc3:
+      return format("jp $%04x", n16);
+    case 0xc9:
+      return "ret";
+    case 0xcb:
+      return disassembleCb(n8);
+    case 0xcd:
+      return format("call $%04x", n16);
+    case 0xd9:
+      return "reti";
+    case 0xe0:
+      return format("ldh ($ff%02x), a", n8);
+    case 0xe2:
+      return "ld ($ff00+c), a";
+    case 0xe8:
+      return format("add sp, %d", static_cast<i8>(n8));
+    case 0xe9:
+      return "jp hl";
+    case 0xea:
+      return format("ld ($%04x), a", n16);
+    case 0xf0:
+      return format("ldh a, ($ff%02x)", n8);
+    case 0xf2:
+      return "ld a, ($ff00+c)";
+    case 0xf3:
+      return "di";
+    case 0xf8:
+      return format("ld hl, sp%+d", static_cast<i8>(n8));
+    case 0xf9:
+      return "ld sp, hl";
+    case 0xfa:
+      return format("ld a, ($%04x)", n16);
+    case 0xfb:
+      return "ei";
+  }
+
+  switch (z) {
+    case 0:
+      return format("ret %s", kConditions[y]);
+    case 1:
+      return format("pop %s", kR16Stack[y >> 1]);
+    case 2:
+      return format("jp %s, $%04x", kConditions[y], n16);
+    case 4:
+      if (y >= 4) {
+        break;
+      }
+      return format("call %s, $%04x", kConditions[y], n16);
+    case 5:
+      if (y & 1) {
+        break;
+      }
+      return format("push %s", kR16Stack[y >> 1]);
+    case 6:
+      return format("%s $%02x", kAlu[y], n8);
+    case 7:
+      return format("rst $%02x", y * 8);
+  }
+  return format("db $%02x", code[0]);
+}
+
+}  // namespace gbeml
@@ -0,0 +1,17 @@
+#ifndef GBEML_DISASSEMBLER_H_
+#define GBEML_DISASSEMBLER_H_
+
+#include <string>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Returns the assembly of the instruction whose bytes start at code. Three
+// bytes are read whatever the length of the instruction. pc is the address of
+// the instruction, used to resolve relative jumps.
+std::string disassemble(const u8* code, u16 pc);
+
+}  // namespace gbeml
+
+#endif  // GBEML_DISASSEMBLER_H_
@@ -0,0 +1,48 @@
+#include "core/cpu/disassembler.h"
+
+#include <gtest/gtest.h>
+
+namespace gbeml {
+
+std::string disassembleBytes(u8 op, u8 lo = 0, u8 hi = 0, u16 pc = 0) {
+  u8 code[3] = {op, lo, hi};
+  return disassemble(code, pc);
+}
+
+TEST(DisassemblerTest, load) {
+  EXPECT_EQ("nop", disassembleBytes(0x00));
+  EXPECT_EQ("ld bc, $1234", disassembleBytes(0x01, 0x34, 0x12));
+  EXPECT_EQ("ld (hl-), a", disassembleBytes(0x32));
+  EXPECT_EQ("ld a, $ff", disassembleBytes(0x3e, 0xff));
+  EXPECT_EQ("ld (hl), b", disassembleBytes(0x70));
+  EXPECT_EQ("halt", disassembleBytes(0x76));
+  EXPECT_EQ("ldh a, ($ff44)", disassembleBytes(0xf0, 0x44));
+  EXPECT_EQ("ld hl, sp-2", disassembleBytes(0xf8, 0xfe));
+  EXPECT_EQ("pop af", disassembleBytes(0xf1));
+}
+
+TEST(DisassemblerTest, alu) {
+  EXPECT_EQ("add a, c", disassembleBytes(0x81));
+  EXPECT_EQ("cp (hl)", disassembleBytes(0xbe));
+  EXPECT_EQ("xor $0f", disassembleBytes(0xee, 0x0f));
+  EXPECT_EQ("dec de", disassembleBytes(0x1b));
+  EXPECT_EQ("daa", disassembleBytes(0x27));
+  EXPECT_EQ("swap a", disassembleBytes(0xcb, 0x37));
+  EXPECT_EQ("bit 7, h", disassembleBytes(0xcb, 0x7c));
+  EXPECT_EQ("res 0, (hl)", disassembleBytes(0xcb, 0x86));
+}
+
+TEST(DisassemblerTest, controlFlow) {
+  EXPECT_EQ("jr nz, $0100", disassembleBytes(0x20, 0xfe, 0, 0x100));
+  EXPECT_EQ("jr $0112", disassembleBytes(0x18, 0x10, 0, 0x100));
+  EXPECT_EQ("jp z, $0150", disassembleBytes(0xca, 0x50, 0x01));
+  EXPECT_EQ("call $4000", disassembleBytes(0xcd, 0x00, 0x40));
+  EXPECT_EQ("ret c", disassembleBytes(0xd8));
+  EXPECT_EQ("reti", disassembleBytes(0xd9));
+  EXPECT_EQ("rst $38", disassembleBytes(0xff));
+  EXPECT_EQ("db $d3", disassembleBytes(0xd3));
+  EXPECT_EQ("db $e4", disassembleBytes(0xe4));
+  EXPECT_EQ("db $fd", disassembleBytes(0xfd));
+}
+
+}  // namespace gbeml
@@ -0,0 +1,779 @@
+#include "core/cpu/jit.h"
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define GBEML_JIT_X86_64
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "core/cpu/decoder.h"
+#include "core/log/logging.h"
+
+namespace gbeml {
+
+namespace {
+
+// Maps the flags lahf stores in ah (SF ZF 0 AF 0 PF 1 CF) to Z, H and C in the
+// layout of F.
+constexpr std::array<u8, 256> buildFlagTable() {
+  std::array<u8, 256> table{};
+  for (u16 ah = 0; ah < 256; ++ah) {
+    table[ah] = static_cast<u8>((ah & 0x40) << 1 | (ah & 0x10) << 1 |
+                                (ah & 0x01) << 4);
+  }
+  return table;
+}
+
+constexpr std::array<u8, 256> kFlagTable = buildFlagTable();
+
+constexpr u8 kOffsetA = offsetof(Registers, a);
+constexpr u8 kOffsetF = offsetof(Registers, f);
+constexpr u8 kOffsetPc = offsetof(Registers, pc);
+constexpr u8 kOffsetRegs = offsetof(AotContext, regs);
+constexpr u8 kOffsetCycles = offsetof(AotContext, cycles);
+constexpr u8 kOffsetInstructions = offsetof(AotContext, instructions);
+constexpr u8 kOffsetEnd = offsetof(AotContext, end);
+constexpr u8 kOffsetLimit = offsetof(AotContext, limit);
+constexpr u8 kOffsetStop = offsetof(AotContext, stop);
+static_assert(offsetof(AotContext, stop) < 0x80,
+              "The context is addressed with 8-bit displacements.");
+
+// Offset of register r (b, c, d, e, h, l, (hl), a) in Registers.
+constexpr u8 registerOffset(u8 r) {
+  switch (r) {
+    case 0:
+      return offsetof(Registers, b);
+    case 1:
+      return offsetof(Registers, c);
+    case 2:
+      return offsetof(Registers, d);
+    case 3:
+      return offsetof(Registers, e);
+    case 4:
+      return offsetof(Registers, h);
+    case 5:
+      return offsetof(Registers, l);
+    default:
+      return offsetof(Registers, a);
+  }
+}
+
+template <u8 R>
+u8& reg(Registers& r) {
+  static_assert(R != 6, "(hl) is not a register.");
+  if constexpr (R == 0) {
+    return r.b;
+  } else if constexpr (R == 1) {
+    return r.c;
+  } else if constexpr (R == 2) {
+    return r.d;
+  } else if constexpr (R == 3) {
+    return r.e;
+  } else if constexpr (R == 4) {
+    return r.h;
+  } else if constexpr (R == 5) {
+    return r.l;
+  } else {
+    return r.a;
+  }
+}
+
+// bc, de, hl and sp.
+template <u8 P>
+u16 getPair(const Registers& r) {
+  if constexpr (P == 0) {
+    return r.bc();
+  } else if constexpr (P == 1) {
+    return r.de();
+  } else if constexpr (P == 2) {
+    return r.hl();
+  } else {
+    return r.sp;
+  }
+}
+
+template <u8 P>
+void setPair(Registers& r, u16 n) {
+  if constexpr (P == 0) {
+    r.set_bc(n);
+  } else if constexpr (P == 1) {
+    r.set_de(n);
+  } else if constexpr (P == 2) {
+    r.set_hl(n);
+  } else {
+    r.sp = n;
+  }
+}
+
+// nz, z, nc and c.
+template <u8 Y>
+bool condition(const Registers& r) {
+  if constexpr (Y < 2) {
+    return ((r.f & 0x80) != 0) == (Y == 1);
+  } else {
+    return ((r.f & 0x10) != 0) == (Y == 3);
+  }
+}
+
+constexpr void (*kAluOps[])(Registers&, u8) = {
+    aot::add_a, aot::adc_a, aot::sub_a, aot::sbc_a,
+    aot::and_a, aot::xor_a, aot::or_a,  aot::cp_a};
+constexpr void (*kAccumulatorOps[])(Registers&) = {
+    aot::rlca, aot::rrca, aot::rla, aot::rra,
+    aot::daa,  aot::cpl,  aot::scf, aot::ccf};
+constexpr u8 (*kRotateOps[])(Registers&, u8) = {
+    aot::rlc, aot::rrc, aot::rl,   aot::rr,
+    aot::sla, aot::sra, aot::swap, aot::srl};
+
+// Runs the instruction with the opcode at pc, with operand the bytes after
+// the opcode. Returns false, leaving the code, if it has to wait for the cpu.
+// Control flow also retires the instruction and sets c.end.
+using Helper = bool (*)(AotContext* c, u16 pc, u16 operand);
+
+template <u8 Op>
+bool runOp(AotContext* c, u16 pc, u16 n) {
+  constexpr u8 x = Op >> 6;
+  constexpr u8 y = (Op >> 3) & 7;
+  constexpr u8 z = Op & 7;
+  constexpr u8 p = y >> 1;
+  constexpr bool q = y & 1;
+  Registers& r = *c->regs;
+  u16 next = static_cast<u16>(pc + getInstructionLength(Op));
+  u8 n8 = static_cast<u8>(n);
+
+  if constexpr (Op == 0x08) {
+    if (!aot::access(*c, pc, n, static_cast<u16>(n + 1), true)) {
+      return false;
+    }
+    aot::writeWord(*c, n, r.sp);
+  } else if constexpr (x == 0 && z == 1) {
+    if constexpr (q) {
+      aot::add_hl(r, getPair<p>(r));
+    } else {
+      setPair<p>(r, n);
+    }
+  } else if constexpr (x == 0 && z == 2) {
+    u16 addr = getPair<p == 3 ? 2 : p>(r);
+    if (!aot::access(*c, pc, addr, !q)) {
+      return false;
+    }
+    if constexpr (q) {
+      r.a = aot::read(*c, addr);
+    } else {
+      aot::write(*c, addr, r.a);
+    }
+    if constexpr (p == 2) {
+      r.set_hl(static_cast<u16>(addr + 1));
+    } else if constexpr (p == 3) {
+      r.set_hl(static_cast<u16>(addr - 1));
+    }
+  } else if constexpr (x == 0 && z == 3) {
+    setPair<p>(r, static_cast<u16>(getPair<p>(r) + (q ? -1 : 1)));
+  } else if constexpr (x == 0 && (z == 4 || z == 5)) {
+    if constexpr (y == 6) {
+      if (!aot::access(*c, pc, r.hl(), true)) {
+        return false;
+      }
+      u8 v = aot::read(*c, r.hl());
+      z == 4 ? aot::inc(r, v) : aot::dec(r, v);
+      aot::write(*c, r.hl(), v);
+    } else {
+      z == 4 ? aot::inc(r, reg<y>(r)) : aot::dec(r, reg<y>(r));
+    }
+  } else if constexpr (x == 0 && z == 6) {
+    if constexpr (y == 6) {
+      if (!aot::access(*c, pc, r.hl(), true)) {
+        return false;
+      }
+      aot::write(*c, r.hl(), n8);
+    } else {
+      reg<y>(r) = n8;
+    }
+  } else if constexpr (x == 0 && z == 7) {
+    kAccumulatorOps[y](r);
+  } else if constexpr (x == 1 && Op != 0x76) {
+    if constexpr (y == 6) {
+      if (!aot::access(*c, pc, r.hl(), true)) {
+        return false;
+      }
+      aot::write(*c, r.hl(), reg<z>(r));
+    } else if constexpr (z == 6) {
+      if (!aot::access(*c, pc, r.hl(), false)) {
+        return false;
+      }
+      reg<y>(r) = aot::read(*c, r.hl());
+    } else {
+      reg<y>(r) = reg<z>(r);
+    }
+  } else if constexpr (x == 2) {
+    if constexpr (z == 6) {
+      if (!aot::access(*c, pc, r.hl(), false)) {
+        return false;
+      }
+      kAluOps[y](r, aot::read(*c, r.hl()));
+    } else {
+      kAluOps[y](r, reg<z>(r));
+    }
+  } else if constexpr (x == 3 && z == 6) {
+    kAluOps[y](r, n8);
+  } else if constexpr (Op == 0xe0 || Op == 0xf0 || Op == 0xe2 ||
+                       Op == 0xf2 || Op == 0xea || Op == 0xfa) {
+    u16 addr = Op == 0xea || Op == 0xfa ? n
+               : Op == 0xe2 || Op == 0xf2
+                   ? static_cast<u16>(0xff00 | r.c)
+                   : static_cast<u16>(0xff00 | n8);
+    constexpr bool write = Op == 0xe0 || Op == 0xe2 || Op == 0xea;
+    if (!aot::access(*c, pc, addr, write)) {
+      return false;
+    }
+    if constexpr (write) {
+      aot::write(*c, addr, r.a);
+    } else {
+      r.a = aot::read(*c, addr);
+    }
+  } else if constexpr (Op == 0xe8) {
+    r.sp = aot::add_sp(r, n8);
+  } else if constexpr (Op == 0xf8) {
+    r.set_hl(aot::add_sp(r, n8));
+  } else if constexpr (Op == 0xf9) {
+    r.sp = r.hl();
+  } else if constexpr (x == 3 && z == 1 && !q) {
+    if (!aot::access(*c, pc, r.sp, static_cast<u16>(r.sp + 1), false)) {
+      return false;
+    }
+    if constexpr (p == 3) {
+      r.set_af(aot::pop(*c));
+    } else {
+      setPair<p>(r, aot::pop(*c));
+    }
+  } else if constexpr (x == 3 && z == 5 && !q) {
+    if (!aot::access(*c, pc, static_cast<u16>(r.sp - 2),
+                     static_cast<u16>(r.sp - 1), true)) {
+      return false;
+    }
+    if constexpr (p == 3) {
+      aot::push(*c, r.af() & 0xfff0);
+    } else {
+      aot::push(*c, getPair<p>(r));
+    }
+  } else if constexpr (Op == 0xf3) {
+    c->ime = false;
+  } else if constexpr (Op == 0xfb) {
+    c->ime = true;
+    // Interrupts may be pending already.
+    c->stop = true;
+  } else if constexpr ((x == 3 && z == 0 && y < 4) || Op == 0xc9 ||
+                       Op == 0xd9) {
+    // ret cc, ret and reti
+    if (Op == 0xc9 || Op == 0xd9 || condition<y & 3>(r)) {
+      if (!aot::access(*c, pc, r.sp, static_cast<u16>(r.sp + 1), false)) {
+        return false;
+      }
+      r.pc = aot::pop(*c);
+      if constexpr (Op == 0xd9) {
+        c->ime = true;
+      }
+      aot::retire(*c, getInstructionCycles(Op, 0, true));
+    } else {
+      r.pc = next;
+      aot::retire(*c, getInstructionCycles(Op, 0, false));
+    }
+    c->end = next;
+  } else if constexpr ((x == 3 && z == 4 && y < 4) || Op == 0xcd ||
+                       (x == 3 && z == 7)) {
+    // call cc, call and rst
+    if ((Op != 0xc4 && Op != 0xcc && Op != 0xd4 && Op != 0xdc) ||
+        condition<y & 3>(r)) {
+      if (!aot::access(*c, pc, static_cast<u16>(r.sp - 2),
+                       static_cast<u16>(r.sp - 1), true)) {
+        return false;
+      }
+      aot::push(*c, next);
+      r.pc = z == 7 ? y * 8 : n;
+      aot::retire(*c, getInstructionCycles(Op, 0, true));
+    } else {
+      r.pc = next;
+      aot::retire(*c, getInstructionCycles(Op, 0, false));
+    }
+    c->end = next;
+  } else if constexpr (Op == 0xe9) {
+    r.pc = r.hl();
+    aot::retire(*c, getInstructionCycles(Op, 0, true));
+    c->end = next;
+  } else {
+    // Not translated.
+    aot::leave(*c, pc);
+    return false;
+  }
+  return true;
+}
+
+template <u8 Op>
+bool runCbOp(AotContext* c, u16 pc, u16) {
+  constexpr u8 x = Op >> 6;
+  constexpr u8 y = (Op >> 3) & 7;
+  constexpr u8 z = Op & 7;
+  Registers& r = *c->regs;
+
+  u8 v;
+  if constexpr (z == 6) {
+    if (!aot::access(*c, pc, r.hl(), x != 1)) {
+      return false;
+    }
+    v = aot::read(*c, r.hl());
+  } else {
+    v = reg<z>(r);
+  }
+  if constexpr (x == 1) {
+    aot::bit(r, y, v);
+    return true;
+  }
+
+  u8 res;
+  if constexpr (x == 0) {
+    res = kRotateOps[y](r, v);
+  } else if constexpr (x == 2) {
+    res = static_cast<u8>(v & ~(1 << y));
+  } else {
+    res = static_cast<u8>(v | 1 << y);
+  }
+  if constexpr (z == 6) {
+    aot::write(*c, r.hl(), res);
+  } else {
+    reg<z>(r) = res;
+  }
+  return true;
+}
+
+template <std::size_t... Ops>
+constexpr std::array<Helper, 256> buildOps(std::index_sequence<Ops...>) {
+  return {&runOp<static_cast<u8>(Ops)>...};
+}
+
+template <std::size_t... Ops>
+constexpr std::array<Helper, 256> buildCbOps(std::index_sequence<Ops...>) {
+  return {&runCbOp<static_cast<u8>(Ops)>...};
+}
+
+constexpr std::array<Helper, 256> kOps =
+    buildOps(std::make_index_sequence<256>());
+constexpr std::array<Helper, 256> kCbOps =
+    buildCbOps(std::make_index_sequence<256>());
+
+// halt, stop and the unused opcodes.
+constexpr bool isTranslated(u8 op) {
+  switch (op) {
+    case 0x10:
+    case 0x76:
+    case 0xd3:
+    case 0xdb:
+    case 0xdd:
+    case 0xe3:
+    case 0xe4:
+    case 0xeb:
+    case 0xec:
+    case 0xed:
+    case 0xf4:
+    case 0xfc:
+    case 0xfd:
+      return false;
+    default:
+      return true;
+  }
+}
+
+// x86-64 code generator. The context is in r13, regs in rdi and rbx and the
+// flag table in rsi and r12; rax, rcx and rdx are scratch registers. rdi and
+// rsi are restored after every helper call.
+class Emitter {
+ public:
+  const std::vector<u8>& getBytes() const { return bytes; }
+  u64 size() const { return bytes.size(); }
+
+  // Saves the callee-saved registers and jumps to the target.
+  void emitPrologue() {
+    // push rbx; push r12; push r13; mov r13, rdi; mov rdi, [rdi + regs]
+    emit({0x53, 0x41, 0x54, 0x41, 0x55, 0x49, 0x89, 0xfd});
+    emit({0x48, 0x8b, 0x7f, kOffsetRegs});
+    // mov rbx, rdi; mov r12, rsi; jmp rdx
+    emit({0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4, 0xff, 0xe2});
+  }
+
+  // Leaves the code before the instruction at pc once the cycle limit is
+  // reached or an instruction asked to stop.
+  void emitBegin(u16 pc) {
+    // cmp byte [r13 + stop], 0; jne leave
+    emit({0x41, 0x80, 0x7d, kOffsetStop, 0x00, 0x75, 0x00});
+    u64 stop = size();
+    // mov eax, [r13 + cycles]; cmp rax, [r13 + limit]; jb run
+    emit({0x41, 0x8b, 0x45, kOffsetCycles, 0x49, 0x3b, 0x45, kOffsetLimit});
+    emit({0x72, 0x00});
+    u64 limit = size();
+    patch(stop, size());
+    emitLeave(pc);
+    patch(limit, size());
+  }
+
+  // Emits the instruction at code[offset], at address pc, and returns whether
+  // it ends the code.
+  bool emitInstruction(const std::vector<u8>& code, u64 offset, u16 pc) {
+    u8 op = code[offset];
+    u8 length = getInstructionLength(op);
+    u16 operand = length == 1   ? 0
+                  : length == 2 ? code[offset + 1]
+                                : concat(code[offset + 2], code[offset + 1]);
+    u16 next = static_cast<u16>(pc + length);
+
+    if (emitRegisterOp(op, static_cast<u8>(operand))) {
+      emitRetire(getInstructionCycles(op, 0, false));
+      return false;
+    }
+    if (op == 0x18 || op == 0x20 || op == 0x28 || op == 0x30 || op == 0x38) {
+      emitJump(op, static_cast<u16>(next + static_cast<i8>(operand)), next);
+      return true;
+    }
+    if (op == 0xc2 || op == 0xc3 || op == 0xca || op == 0xd2 || op == 0xda) {
+      emitJump(op, operand, next);
+      return true;
+    }
+
+    emitCall(op == 0xcb ? kCbOps[operand] : kOps[op], pc, operand);
+    if (endsBlock(op)) {
+      emitEpilogue();
+      return true;
+    }
+    // test al, al; jnz retire
+    emit({0x84, 0xc0, 0x75, 0x00});
+    u64 left = size();
+    emitEpilogue();
+    patch(left, size());
+    emitRetire(getInstructionCycles(op, static_cast<u8>(operand), false));
+    return false;
+  }
+
+  // Leaves the code before the instruction at pc.
+  void emitLeave(u16 pc) {
+    emitSetPc(pc);
+    emitSetEnd(pc);
+    emitEpilogue();
+  }
+
+ private:
+  std::vector<u8> bytes;
+
+  void emit(std::initializer_list<u8> code) {
+    bytes.insert(bytes.end(), code);
+  }
+
+  // Points the 8-bit displacement of the jump that ends at from to to.
+  void patch(u64 from, u64 to) {
+    DCHECK(to - from <= 0x7f);
+    bytes[from - 1] = static_cast<u8>(to - from);
+  }
+
+  void emitEpilogue() {
+    // pop r13; pop r12; pop rbx; ret
+    emit({0x41, 0x5d, 0x41, 0x5c, 0x5b, 0xc3});
+  }
+
+  void emitSetPc(u16 pc) {
+    // mov word [rdi + pc], imm16
+    emit({0x66, 0xc7, 0x47, kOffsetPc, static_cast<u8>(pc),
+          static_cast<u8>(pc >> 8)});
+  }
+
+  void emitSetEnd(u16 end) {
+    // mov word [r13 + end], imm16
+    emit({0x66, 0x41, 0xc7, 0x45, kOffsetEnd, static_cast<u8>(end),
+          static_cast<u8>(end >> 8)});
+  }
+
+  void emitRetire(u32 cycles) {
+    // add dword [r13 + cycles], imm32; inc dword [r13 + instructions]
+    emit({0x41, 0x81, 0x45, kOffsetCycles, static_cast<u8>(cycles),
+          static_cast<u8>(cycles >> 8), static_cast<u8>(cycles >> 16),
+          static_cast<u8>(cycles >> 24)});
+    emit({0x41, 0xff, 0x45, kOffsetInstructions});
+  }
+
+  // Sets pc, retires the instruction and leaves the code.
+  void emitExit(u16 pc, u16 end, u32 cycles) {
+    emitSetPc(pc);
+    emitRetire(cycles);
+    emitSetEnd(end);
+    emitEpilogue();
+  }
+
+  // jr, jp and their conditional forms.
+  void emitJump(u8 op, u16 target, u16 next) {
+    u32 taken = getInstructionCycles(op, 0, true);
+    if (op == 0x18 || op == 0xc3) {
+      emitExit(target, next, taken);
+      return;
+    }
+
+    // nz, z, nc or c. test byte [rdi + f], mask, and skip the taken exit if
+    // the condition does not hold.
+    u8 y = (op >> 3) & 3;
+    emit({0xf6, 0x47, kOffsetF, static_cast<u8>(y < 2 ? 0x80 : 0x10)});
+    emit({static_cast<u8>(y & 1 ? 0x74 : 0x75), 0x00});
+    u64 skip = size();
+    emitExit(target, next, taken);
+    patch(skip, size());
+    emitExit(next, next, getInstructionCycles(op, 0, false));
+  }
+
+  void emitCall(Helper helper, u16 pc, u16 operand) {
+    // mov rdi, r13; mov esi, pc; mov edx, operand
+    emit({0x4c, 0x89, 0xef, 0xbe, static_cast<u8>(pc),
+          static_cast<u8>(pc >> 8), 0x00, 0x00});
+    emit({0xba, static_cast<u8>(operand), static_cast<u8>(operand >> 8), 0x00,
+          0x00});
+    // mov rax, helper; call rax
+    u64 addr = reinterpret_cast<u64>(helper);
+    emit({0x48, 0xb8});
+    for (u8 i = 0; i < 8; ++i) {
+      bytes.push_back(static_cast<u8>(addr >> (8 * i)));
+    }
+    emit({0xff, 0xd0});
+    // mov rdi, rbx; mov rsi, r12
+    emit({0x48, 0x89, 0xdf, 0x4c, 0x89, 0xe6});
+  }
+
+  // 8-bit loads, 8-bit alu operations, inc/dec, cpl/scf/ccf and nop on
+  // registers. Returns false for other instructions.
+  bool emitRegisterOp(u8 op, u8 operand) {
+    u8 x = op >> 6;
+    u8 y = (op >> 3) & 7;
+    u8 z = op & 7;
+
+    if (op == 0x00) {
+      return true;
+    } else if (x == 1 && op != 0x76 && y != 6 && z != 6) {
+      // ld r, r
+      emit({0x8a, 0x47, registerOffset(z)});
+      emit({0x88, 0x47, registerOffset(y)});
+      return true;
+    } else if (x == 0 && z == 6 && y != 6) {
+      // ld r, n
+      emit({0xc6, 0x47, registerOffset(y), operand});
+      return true;
+    } else if (x == 2 && z != 6) {
+      // alu a, r
+      emitAlu(y, false, registerOffset(z));
+      return true;
+    } else if (x == 3 && z == 6) {
+      // alu a, n
+      emitAlu(y, true, operand);
+      return true;
+    } else if (x == 0 && (z == 4 || z == 5) && y != 6) {
+      emitIncDec(z == 5, registerOffset(y));
+      return true;
+    } else if (op == 0x2f) {
+      // cpl
+      emit({0x8a, 0x47, kOffsetA, 0xf6, 0xd0, 0x88, 0x47, kOffsetA});
+      emit({0x80, 0x4f, kOffsetF, 0x60});
+      return true;
+    } else if (op == 0x37) {
+      // scf
+      emit({0x80, 0x67, kOffsetF, 0x8f, 0x80, 0x4f, kOffsetF, 0x10});
+      return true;
+    } else if (op == 0x3f) {
+      // ccf
+      emit({0x80, 0x67, kOffsetF, 0x9f, 0x80, 0x77, kOffsetF, 0x10});
+      return true;
+    }
+    return false;
+  }
+
+  // add, adc, sub, sbc, and, xor, or, cp on al with a register or an
+  // immediate operand.
+  void emitAlu(u8 kind, bool immediate, u8 operand) {
+    constexpr u8 kRegisterOps[] = {0x02, 0x12, 0x2a, 0x1a,
+                                   0x22, 0x32, 0x0a, 0x3a};
+    constexpr u8 kImmediateOps[] = {0x04, 0x14, 0x2c, 0x1c,
+                                    0x24, 0x34, 0x0c, 0x3c};
+
+    if (kind == 1 || kind == 3) {
+      // Move C into CF: mov dl, [f]; shr dl, 5
+      emit({0x8a, 0x57, kOffsetF, 0xc0, 0xea, 0x05});
+    }
+    emit({0x8a, 0x47, kOffsetA});
+    if (immediate) {
+      emit({kImmediateOps[kind], operand});
+    } else {
+      emit({kRegisterOps[kind], 0x47, operand});
+    }
+    // lahf
+    emit({0x9f});
+    if (kind != 7) {
+      emit({0x88, 0x47, kOffsetA});
+    }
+    loadFlags();
+
+    switch (kind) {
+      case 2:
+      case 3:
+      case 7:
+        // or cl, N
+        emit({0x80, 0xc9, 0x40});
+        break;
+      case 4:
+        // and cl, Z; or cl, H
+        emit({0x80, 0xe1, 0x80, 0x80, 0xc9, 0x20});
+        break;
+      case 5:
+      case 6:
+        emit({0x80, 0xe1, 0x80});
+        break;
+    }
+    storeFlags(0x0f);
+  }
+
+  void emitIncDec(bool dec, u8 offset) {
+    emit({0x8a, 0x47, offset, 0xfe, static_cast<u8>(dec ? 0xc8 : 0xc0)});
+    emit({0x9f, 0x88, 0x47, offset});
+    loadFlags();
+    // and cl, Z | H
+    emit({0x80, 0xe1, 0xa0});
+    if (dec) {
+      emit({0x80, 0xc9, 0x40});
+    }
+    storeFlags(0x1f);
+  }
+
+  // movzx ecx, ah; mov cl, [rsi + rcx]
+  void loadFlags() { emit({0x0f, 0xb6, 0xcc, 0x8a, 0x0c, 0x0e}); }
+
+  // Merges cl with the bits of F in keep and stores it in F.
+  void storeFlags(u8 keep) {
+    emit({0x8a, 0x57, kOffsetF, 0x80, 0xe2, keep, 0x08, 0xd1});
+    emit({0x88, 0x4f, kOffsetF});
+  }
+};
+
+}  // namespace
+
+Jit::~Jit() {
+#ifdef GBEML_JIT_X86_64
+  if (buffer != nullptr) {
+    munmap(buffer, buffer_size);
+  }
+#endif
+}
+
+bool Jit::isSupported() {
+#ifdef GBEML_JIT_X86_64
+  return true;
+#else
+  return false;
+#endif
+}
+
+const JitCode* Jit::translate(const CodeBlock& block) {
+  if (!isSupported() || disabled) {
+    return nullptr;
+  }
+
+  Emitter emitter;
+  emitter.emitPrologue();
+  // Offset of the code of each instruction, after the check that precedes
+  // it.
+  std::vector<u64> offsets(block.code.size(), 0);
+  u64 offset = 0;
+  bool ends = false;
+  while (offset < block.code.size() && !ends) {
+    u8 op = block.code[offset];
+    u16 pc = static_cast<u16>(block.start + offset);
+    if (!isTranslated(op) ||
+        offset + getInstructionLength(op) > block.code.size()) {
+      break;
+    }
+    if (offset > 0) {
+      emitter.emitBegin(pc);
+    }
+    offsets[offset] = emitter.size();
+    ends = emitter.emitInstruction(block.code, offset, pc);
+    offset += getInstructionLength(block.code[offset]);
+  }
+  if (offset == 0) {
+    return nullptr;
+  }
+  if (!ends) {
+    emitter.emitLeave(static_cast<u16>(block.start + offset));
+  }
+
+  u8* entry = install(emitter.getBytes());
+  if (entry == nullptr) {
+    return nullptr;
+  }
+  JitCode code{reinterpret_cast<JitCode::Entry>(entry),
+               static_cast<u16>(offset),
+               std::vector<const u8*>(offset, nullptr)};
+  for (u64 i = 0; i < offset; ++i) {
+    if (offsets[i] != 0) {
+      code.entries[i] = entry + offsets[i];
+    }
+  }
+  codes.push_back(std::move(code));
+  return &codes.back();
+}
+
+void Jit::run(const JitCode& code, u16 offset, AotContext* c) const {
+  DCHECK(code.entries[offset] != nullptr);
+  code.entry(c, kFlagTable.data(), code.entries[offset]);
+}
+
+void Jit::reset() {
+  used = 0;
+  full = false;
+  codes.clear();
+}
+
+u8* Jit::install([[maybe_unused]] const std::vector<u8>& bytes) {
+#ifdef GBEML_JIT_X86_64
+  if (buffer == nullptr) {
+    void* p = mmap(nullptr, buffer_size, PROT_READ | PROT_EXEC,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      LOG(ERROR) << "Failed to allocate jit buffer." << std::endl;
+      return nullptr;
+    }
+    buffer = static_cast<u8*>(p);
+  }
+  if (used + bytes.size() > buffer_size) {
+    full = true;
+    return nullptr;
+  }
+
+  // Pages are writable only while code is copied into them.
+  u64 page_size = sysconf(_SC_PAGESIZE);
+  u8* entry = buffer + used;
+  u64 begin = used / page_size * page_size;
+  u64 end = used + bytes.size();
+  if (mprotect(buffer + begin, end - begin, PROT_READ | PROT_WRITE) != 0) {
+    return nullptr;
+  }
+  std::memcpy(entry, bytes.data(), bytes.size());
+  if (mprotect(buffer + begin, end - begin, PROT_READ | PROT_EXEC) != 0) {
+    // The pages may hold code translated before, which cannot run either.
+    LOG(ERROR) << "Failed to make jit code executable, disabling the jit."
+               << std::endl;
+    disabled = true;
+    return nullptr;
+  }
+
+  used = (end + 15) / 16 * 16;
+  return entry;
+#else
+  return nullptr;
+#endif
+}
+
+}  // namespace gbeml
@@ -0,0 +1,77 @@
+#ifndef GBEML_JIT_H_
+#define GBEML_JIT_H_
+
+#include <deque>
+#include <vector>
+
+#include "core/cpu/aot_ops.h"
+#include "core/cpu/block_cache.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Native code for a code block, which can be entered at any of its
+// instructions.
+struct JitCode {
+  using Entry = void (*)(AotContext* c, const u8* flag_table,
+                         const u8* target);
+
+  Entry entry;
+  // Size of the sm83 instructions it covers.
+  u16 length;
+  // For each byte of the block, where to enter the code to start with the
+  // instruction there, or nullptr.
+  std::vector<const u8*> entries;
+};
+
+// Translates code blocks into x86-64 code running on an AotContext, like the
+// code of the recompiler (see aot_ops.h). Register-only instructions and jumps
+// are emitted inline. Memory accesses, the stack and the 0xcb prefix call
+// helpers that go through the callbacks of the context, and the code leaves
+// before an access the other components could notice, once c.limit cycles
+// have run or after c.stop is set. halt, stop and the unused opcodes end the
+// code and are left to the interpreter. Translation is only available on
+// Linux x86-64.
+class Jit {
+ public:
+  // Number of times a block has to be entered before it is translated.
+  static constexpr u32 kHotThreshold = 16;
+
+  explicit Jit(u64 buffer_size_ = kBufferSize) : buffer_size(buffer_size_) {}
+  ~Jit();
+  Jit(const Jit&) = delete;
+  Jit& operator=(const Jit&) = delete;
+
+  static bool isSupported();
+
+  // Returns nullptr if the first instruction of the block cannot be
+  // translated, the code buffer is full or the jit is disabled.
+  const JitCode* translate(const CodeBlock& block);
+  // Whether translate() last failed for lack of room. reset() makes room.
+  bool isFull() const { return full; }
+  // Whether the code buffer could not be made executable again, after which
+  // no code translate() returned may run.
+  bool isDisabled() const { return disabled; }
+  // Empties the code buffer. Code translate() returned before must not run
+  // anymore.
+  void reset();
+  // Runs the code from the instruction at offset in the block. The results
+  // are in c, as for recompiled code.
+  void run(const JitCode& code, u16 offset, AotContext* c) const;
+
+ private:
+  static constexpr u64 kBufferSize = 1 << 20;
+
+  u64 buffer_size;
+  u8* buffer = nullptr;
+  u64 used = 0;
+  bool full = false;
+  bool disabled = false;
+  std::deque<JitCode> codes;
+
+  u8* install(const std::vector<u8>& bytes);
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_JIT_H_
@@ -0,0 +1,282 @@
+#include "core/cpu/jit.h"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include "core/bus/bus.h"
+#include "core/cpu/cpu.h"
+#include "core/cpu/decoder.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+class FlatBus : public Bus {
+ public:
+  FlatBus() : memory(0x10000) {}
+
+  u8 read(u16 addr) const override { return memory[addr]; }
+  void write(u16 addr, u8 value) override { memory[addr] = value; }
+  u32 getRomBank(u16 addr) const override { return addr / 0x4000; }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override { return 0; }
+
+  std::vector<u8> memory;
+};
+
+// Memory that reads a pattern until written, cheap to create for every run.
+class SparseBus : public Bus {
+ public:
+  u8 read(u16 addr) const override {
+    auto it = memory.find(addr);
+    return it != memory.end() ? it->second
+                              : static_cast<u8>(addr * 7 ^ addr >> 8);
+  }
+  void write(u16 addr, u8 value) override { memory[addr] = value; }
+  u32 getRomBank(u16 addr) const override { return addr / 0x4000; }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override { return 0; }
+
+  std::map<u16, u8> memory;
+};
+
+// A context running on bus, where every access can be deferred if defer.
+struct Context : AotContext {
+  Context(Registers* regs_, Bus* bus, bool defer) {
+    regs = regs_;
+    ime = false;
+    cycles = 0;
+    instructions = 0;
+    end = regs_->pc;
+    limit = UINT64_MAX;
+    stop = false;
+    cpu = bus;
+    read = [](AotContext& c, u16 addr) {
+      return static_cast<Bus*>(c.cpu)->read(addr);
+    };
+    write = [](AotContext& c, u16 addr, u8 value) {
+      static_cast<Bus*>(c.cpu)->write(addr, value);
+    };
+    canDefer = defer ? [](AotContext&, u16, bool) { return true; }
+                     : [](AotContext&, u16, bool) { return false; };
+  }
+};
+
+TEST(JitTest, translate_matchesInterpreter) {
+  if (!Jit::isSupported()) {
+    GTEST_SKIP();
+  }
+
+  Jit jit;
+  u16 translated = 0;
+  for (u16 i = 0; i < 512; ++i) {
+    // The opcodes, then the 0xcb prefix with each opcode after it.
+    u8 op = i < 256 ? static_cast<u8>(i) : 0xcb;
+    std::vector<u8> bytes = {op, static_cast<u8>(i < 256 ? 0x5a : i), 0xc1};
+    bytes.resize(getInstructionLength(op));
+    CodeBlock block{0xc000, bytes};
+    const JitCode* code = jit.translate(block);
+    if (code == nullptr || (op == 0xcb && i < 256)) {
+      continue;
+    }
+    translated++;
+
+    for (u16 a = 0; a < 256; a += 37) {
+      for (u16 f = 0; f < 256; f += 0x10) {
+        Registers regs;
+        regs.a = static_cast<u8>(a);
+        regs.f = static_cast<u8>(f);
+        regs.b = static_cast<u8>(a * 3 + 1);
+        regs.c = static_cast<u8>(a * 5 + 2);
+        regs.d = static_cast<u8>(a ^ 0x0f);
+        regs.e = static_cast<u8>(a + 0x80);
+        regs.h = static_cast<u8>(a * 7);
+        regs.l = static_cast<u8>(~a);
+        regs.pc = 0xc000;
+        regs.sp = static_cast<u16>(0xd000 + a);
+
+        SparseBus bus;
+        for (u8 j = 0; j < bytes.size(); ++j) {
+          bus.memory[0xc000 + j] = bytes[j];
+        }
+        InterruptControllerImpl ic;
+        Cpu cpu(&bus, &ic);
+        cpu.setRegisters(regs);
+        u64 cycles = cpu.step();
+
+        SparseBus native_bus;
+        for (u8 j = 0; j < bytes.size(); ++j) {
+          native_bus.memory[0xc000 + j] = bytes[j];
+        }
+        Registers native = regs;
+        Context c(&native, &native_bus, false);
+        jit.run(*code, 0, &c);
+        ASSERT_EQ(1, c.instructions) << "op " << i;
+        ASSERT_EQ(cycles, c.cycles) << "op " << i;
+        ASSERT_EQ(cpu.getRegisters(), native)
+            << "op " << i << ", a " << a << ", f " << f;
+        if (op == 0xd9 || op == 0xf3 || op == 0xfb) {
+          ASSERT_EQ(cpu.interruptEnabled(), c.ime) << "op " << i;
+        }
+        ASSERT_EQ(bus.memory, native_bus.memory) << "op " << i;
+      }
+    }
+  }
+  // All but halt, stop, the unused opcodes and 0xcb on its own.
+  EXPECT_EQ(242 + 256, translated);
+}
+
+TEST(JitTest, translate_leavesBeforeAccess) {
+  if (!Jit::isSupported()) {
+    GTEST_SKIP();
+  }
+
+  Jit jit;
+  // inc a; ld (hl), a; inc a; halt
+  CodeBlock block{0x0100, {0x3c, 0x77, 0x3c, 0x76}};
+  const JitCode* code = jit.translate(block);
+  ASSERT_NE(nullptr, code);
+  EXPECT_EQ(3, code->length);
+
+  FlatBus bus;
+  Registers regs;
+  regs.pc = 0x0100;
+  regs.set_hl(0xc000);
+  Context c(&regs, &bus, false);
+  jit.run(*code, 0, &c);
+  EXPECT_EQ(1, c.instructions);
+  EXPECT_EQ(4, c.cycles);
+  EXPECT_EQ(0x0101, regs.pc);
+  EXPECT_EQ(0x0101, c.end);
+
+  // Entered again where it left, the access runs first.
+  Context resumed(&regs, &bus, false);
+  jit.run(*code, 1, &resumed);
+  EXPECT_EQ(2, resumed.instructions);
+  EXPECT_EQ(12, resumed.cycles);
+  EXPECT_EQ(0x0103, regs.pc);
+  EXPECT_EQ(1, bus.memory[0xc000]);
+  EXPECT_EQ(2, regs.a);
+
+  CodeBlock halt_first{0x0100, {0x76, 0x3c}};
+  EXPECT_EQ(nullptr, jit.translate(halt_first));
+}
+
+TEST(JitTest, translate_stopsAtLimit) {
+  if (!Jit::isSupported()) {
+    GTEST_SKIP();
+  }
+
+  Jit jit;
+  // inc a; inc a; inc a; jr -5
+  CodeBlock block{0x0100, {0x3c, 0x3c, 0x3c, 0x18, 0xfb}};
+  const JitCode* code = jit.translate(block);
+  ASSERT_NE(nullptr, code);
+
+  FlatBus bus;
+  Registers regs;
+  regs.pc = 0x0100;
+  Context c(&regs, &bus, true);
+  c.limit = 8;
+  jit.run(*code, 0, &c);
+  EXPECT_EQ(2, c.instructions);
+  EXPECT_EQ(8, c.cycles);
+  EXPECT_EQ(0x0102, regs.pc);
+
+  Context unlimited(&regs, &bus, true);
+  jit.run(*code, 2, &unlimited);
+  EXPECT_EQ(2, unlimited.instructions);
+  EXPECT_EQ(16, unlimited.cycles);
+  EXPECT_EQ(0x0100, regs.pc);
+  EXPECT_EQ(0x0105, unlimited.end);
+  EXPECT_EQ(3, regs.a);
+}
+
+TEST(JitTest, reset_whenFull) {
+  if (!Jit::isSupported()) {
+    GTEST_SKIP();
+  }
+
+  Jit jit(256);
+  CodeBlock block{0x0100, {0x3c, 0x47}};
+  u16 translated = 0;
+  while (jit.translate(block) != nullptr) {
+    translated++;
+    ASSERT_LT(translated, 256);
+  }
+  EXPECT_LT(0, translated);
+  EXPECT_TRUE(jit.isFull());
+  EXPECT_FALSE(jit.isDisabled());
+
+  jit.reset();
+  EXPECT_FALSE(jit.isFull());
+  const JitCode* code = jit.translate(block);
+  ASSERT_NE(nullptr, code);
+  FlatBus bus;
+  Registers regs;
+  regs.pc = 0x0100;
+  Context c(&regs, &bus, true);
+  jit.run(*code, 0, &c);
+  EXPECT_EQ(8, c.cycles);
+  EXPECT_EQ(1, regs.a);
+  EXPECT_EQ(1, regs.b);
+  EXPECT_EQ(0x0102, regs.pc);
+}
+
+TEST(JitTest, cpu_matchesInterpreter) {
+  // ld d, 0; loop: add a, b; adc a, c; sub d; sbc a, e; xor l; or b; cp c;
+  // inc e; dec h; ld (hl), a; cpl; scf; ccf; ld b, a; push bc; pop bc;
+  // dec d; jr nz, loop; halt
+  std::vector<u8> program = {0x16, 0x00, 0x80, 0x89, 0x92, 0x9b, 0xad,
+                             0xb0, 0xb9, 0x1c, 0x25, 0x77, 0x2f, 0x37,
+                             0x3f, 0x47, 0xc5, 0xc1, 0x15, 0x20, 0xed,
+                             0x76};
+
+  for (bool differential : {false, true}) {
+    FlatBus interpreted_bus;
+    FlatBus jit_bus;
+    for (u16 i = 0; i < program.size(); ++i) {
+      interpreted_bus.memory[0x0100 + i] = program[i];
+      jit_bus.memory[0x0100 + i] = program[i];
+    }
+    InterruptControllerImpl interpreted_ic;
+    InterruptControllerImpl jit_ic;
+    Cpu interpreted(&interpreted_bus, &interpreted_ic);
+    Cpu jitted(&jit_bus, &jit_ic);
+    jitted.setJit(true, differential);
+
+    for (Cpu* cpu : {&interpreted, &jitted}) {
+      cpu->set_pc(0x0100);
+      cpu->set_sp(0xfffe);
+      cpu->set_h(0xc0);
+    }
+
+    u64 interpreted_cycles = 0;
+    u64 interpreted_steps = 0;
+    while (!interpreted.isHalted()) {
+      interpreted_cycles += interpreted.step();
+      interpreted_steps++;
+    }
+    u64 jit_cycles = 0;
+    u64 jit_steps = 0;
+    while (!jitted.isHalted()) {
+      jit_cycles += jitted.step();
+      jit_steps++;
+    }
+
+    EXPECT_EQ(interpreted.getRegisters(), jitted.getRegisters());
+    EXPECT_EQ(interpreted_cycles, jit_cycles);
+    EXPECT_EQ(interpreted.getRetiredInstructions(),
+              jitted.getRetiredInstructions());
+    EXPECT_EQ(interpreted_bus.memory, jit_bus.memory);
+    // The loop body runs as native code after it gets hot, leaving before
+    // each access since FlatBus does not let them be deferred.
+    EXPECT_LT(jit_steps, interpreted_steps);
+  }
+}
+
+}  // namespace gbeml
@@ -1,22 +1,22 @@
 #ifndef GBEML_OPCODE_H_
 #define GBEML_OPCODE_H_
 
-#include <string>
-
-#include "core/register/register.h"
 #include "core/types/types.h"
 
 namespace gbeml {
 
 class Opcode {
  public:
-  Opcode(u8 code) : value(code) {}
+  constexpr Opcode(u8 code) : value(code) {}
 
-  u8 get() const;
-  u8 slice(u8 from, u8 to) const;
+  constexpr u8 get() const { return value; }
+  constexpr u8 slice(u8 from, u8 to) const {
+    u8 mask = 0xff >> (7 - to);
+    return (value & mask) >> from;
+  }
 
  private:
-  Register value;
+  u8 value;
 };
 
 }  // namespace gbeml
@@ -0,0 +1,204 @@
+#include "core/cpu/profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "core/cpu/decoder.h"
+
+namespace gbeml {
+
+namespace {
+
+constexpr u32 kRootKey = UINT32_MAX;
+
+// call, call cc and rst.
+bool isCall(u8 op) {
+  return op == 0xcd || (op & 0xe7) == 0xc4 || (op & 0xc7) == 0xc7;
+}
+
+std::string formatAddress(u32 bank, u16 pc) {
+  char buffer[16];
+  std::snprintf(buffer, sizeof(buffer), "%02x:%04x", bank, pc);
+  return buffer;
+}
+
+}  // namespace
+
+Profiler::Profiler() : nodes{{0, kRootKey, 0}} {}
+
+void Profiler::sample(u64 cycle, u32 bank, u16 pc, u16 sp, u8 op,
+                      u64 interrupts) {
+  if (started) {
+    u64 delta = cycle - last_cycle;
+    total_cycles += delta;
+    cycles[last_index] += delta;
+    nodes[stack.empty() ? 0 : stack.back().node].cycles += delta;
+  }
+
+  while (!stack.empty() && sp > stack.back().sp) {
+    stack.pop_back();
+  }
+  // An interrupt dispatched right after a call hides the call.
+  if (interrupts != last_interrupts) {
+    enter(bank, pc, sp);
+  } else if (started && isCall(last_op) &&
+             pc != static_cast<u16>(last_pc + getInstructionLength(last_op)) &&
+             sp == static_cast<u16>(last_sp - 2)) {
+    enter(bank, pc, sp);
+  }
+
+  u32 index = getIndex(bank, pc);
+  if (index >= cycles.size()) {
+    cycles.resize(index + 1);
+  }
+  started = true;
+  last_cycle = cycle;
+  last_interrupts = interrupts;
+  last_index = index;
+  last_pc = pc;
+  last_sp = sp;
+  last_op = op;
+}
+
+void Profiler::enter(u32 bank, u16 pc, u16 sp) {
+  if (stack.size() == kMaxDepth) {
+    return;
+  }
+  u32 parent = stack.empty() ? 0 : stack.back().node;
+  u32 key = bank << 16 | pc;
+  auto [it, inserted] = children.try_emplace(
+      static_cast<u64>(parent) << 32 | key, static_cast<u32>(nodes.size()));
+  if (inserted) {
+    nodes.push_back({parent, key, 0});
+  }
+  stack.push_back({it->second, sp});
+}
+
+u64 Profiler::getCycles(u32 bank, u16 pc) const {
+  u32 index = getIndex(bank, pc);
+  return index < cycles.size() ? cycles[index] : 0;
+}
+
+bool Profiler::loadSymbols(const std::string& filename) {
+  std::ifstream fin(filename);
+  if (!fin) {
+    return false;
+  }
+  std::string line;
+  while (std::getline(fin, line)) {
+    line = line.substr(0, line.find(';'));
+    unsigned bank;
+    unsigned addr;
+    char name[256];
+    if (std::sscanf(line.c_str(), "%x:%x %255s", &bank, &addr, name) != 3 ||
+        addr > 0xffff) {
+      continue;
+    }
+    symbols[bank << 16 | addr] = name;
+  }
+  return true;
+}
+
+const std::pair<const u32, std::string>* Profiler::findSymbol(u32 bank,
+                                                              u16 pc) const {
+  auto it = symbols.upper_bound(bank << 16 | pc);
+  if (it == symbols.begin()) {
+    return nullptr;
+  }
+  --it;
+  u16 addr = it->first & 0xffff;
+  if (it->first >> 16 != bank || (addr < 0x8000) != (pc < 0x8000)) {
+    return nullptr;
+  }
+  return &*it;
+}
+
+std::string Profiler::getLabel(u32 bank, u16 pc) const {
+  const auto* symbol = findSymbol(bank, pc);
+  if (symbol == nullptr) {
+    return formatAddress(bank, pc);
+  }
+  u16 offset = pc - (symbol->first & 0xffff);
+  if (offset == 0) {
+    return symbol->second;
+  }
+  std::stringstream ss;
+  ss << symbol->second << "+0x" << std::hex << offset;
+  return ss.str();
+}
+
+void Profiler::writeReport(std::ostream& os, u32 limit) const {
+  struct Entry {
+    u64 cycles;
+    u32 bank;
+    u16 pc;
+  };
+  std::vector<Entry> entries;
+  std::map<std::string, u64> labels;
+  for (u32 i = 0; i < cycles.size(); ++i) {
+    if (cycles[i] == 0) {
+      continue;
+    }
+    u32 bank = 0;
+    u16 pc = static_cast<u16>(i + 0x8000);
+    if (i >= 0x8000) {
+      bank = (i - 0x8000) / 0x4000;
+      pc = (bank == 0 ? 0 : 0x4000) | (i & 0x3fff);
+    }
+    entries.push_back({cycles[i], bank, pc});
+    const auto* symbol = findSymbol(bank, pc);
+    labels[symbol != nullptr ? symbol->second : "(unknown)"] += cycles[i];
+  }
+
+  auto writeLine = [&](u64 n, const std::string& name) {
+    os << std::setw(12) << n << std::setw(7) << std::fixed
+       << std::setprecision(2) << 100.0 * n / std::max<u64>(total_cycles, 1)
+       << "%  " << name << "\n";
+  };
+
+  os << "Total: " << total_cycles << " cycles\n";
+  if (!symbols.empty()) {
+    os << "\nBy label:\n";
+    std::vector<std::pair<u64, std::string>> sorted;
+    for (const auto& [name, n] : labels) {
+      sorted.push_back({n, name});
+    }
+    std::sort(sorted.rbegin(), sorted.rend());
+    for (u32 i = 0; i < sorted.size() && i < limit; ++i) {
+      writeLine(sorted[i].first, sorted[i].second);
+    }
+  }
+
+  os << "\nBy address:\n";
+  std::sort(entries.begin(), entries.end(),
+            [](const Entry& a, const Entry& b) { return a.cycles > b.cycles; });
+  for (u32 i = 0; i < entries.size() && i < limit; ++i) {
+    const Entry& entry = entries[i];
+    std::string name = formatAddress(entry.bank, entry.pc);
+    if (findSymbol(entry.bank, entry.pc) != nullptr) {
+      name += "  " + getLabel(entry.bank, entry.pc);
+    }
+    writeLine(entry.cycles, name);
+  }
+}
+
+std::string Profiler::getStackName(u32 node) const {
+  if (node == 0) {
+    return "[top]";
+  }
+  const Node& n = nodes[node];
+  return getStackName(n.parent) + ";" + getLabel(n.key >> 16, n.key & 0xffff);
+}
+
+void Profiler::writeFoldedStacks(std::ostream& os) const {
+  for (u32 i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].cycles > 0) {
+      os << getStackName(i) << " " << nodes[i].cycles << "\n";
+    }
+  }
+}
+
+}  // namespace gbeml
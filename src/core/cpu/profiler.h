@@ -0,0 +1,84 @@
+#ifndef GBEML_PROFILER_H_
+#define GBEML_PROFILER_H_
+
+#include <map>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Accumulates the T-cycles spent at each (rom bank, pc), and per call stack
+// for flame graphs. Calls are entered on taken call and rst instructions and
+// on interrupt dispatch, and left when sp rises above where they started.
+class Profiler {
+ public:
+  Profiler();
+
+  // Called before each instruction. Cycles since the previous call are
+  // charged to the previous instruction. interrupts is the number of
+  // interrupts the cpu has dispatched so far.
+  void sample(u64 cycle, u32 bank, u16 pc, u16 sp, u8 op, u64 interrupts);
+
+  u64 getCycles(u32 bank, u16 pc) const;
+  u64 getTotalCycles() const { return total_cycles; }
+
+  // Loads labels from an RGBDS .sym file, with lines like "01:4000 Label".
+  bool loadSymbols(const std::string& filename);
+  // Returns the closest label at or before pc in the bank as "Label+0x12", or
+  // "01:4000" without one.
+  std::string getLabel(u32 bank, u16 pc) const;
+
+  // Writes the instructions and the labels with the most cycles, at most
+  // limit of each.
+  void writeReport(std::ostream& os, u32 limit) const;
+  // Writes one "caller;callee cycles" line per call stack, the input format
+  // of flamegraph.pl.
+  void writeFoldedStacks(std::ostream& os) const;
+
+ private:
+  struct Node {
+    u32 parent;
+    // bank << 16 | pc of the code called.
+    u32 key;
+    u64 cycles;
+  };
+  struct Frame {
+    u32 node;
+    u16 sp;
+  };
+  static constexpr u32 kMaxDepth = 256;
+
+  // Cycles of instructions outside rom by pc - 0x8000, then of rom by offset
+  // in the rom file, grown as needed.
+  std::vector<u64> cycles;
+  std::unordered_map<u64, u32> children;
+  std::vector<Node> nodes;
+  std::vector<Frame> stack;
+  std::map<u32, std::string> symbols;
+
+  u64 total_cycles = 0;
+  u64 last_cycle = 0;
+  u64 last_interrupts = 0;
+  u32 last_index = 0;
+  u16 last_pc = 0;
+  u16 last_sp = 0;
+  u8 last_op = 0;
+  bool started = false;
+
+  static u32 getIndex(u32 bank, u16 pc) {
+    return pc >= 0x8000 ? pc - 0x8000 : 0x8000 + 0x4000 * bank + (pc & 0x3fff);
+  }
+  void enter(u32 bank, u16 pc, u16 sp);
+  // Returns the closest symbol at or before pc in the same bank, or nullptr.
+  const std::pair<const u32, std::string>* findSymbol(u32 bank, u16 pc) const;
+  std::string getStackName(u32 node) const;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_PROFILER_H_
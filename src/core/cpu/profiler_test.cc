@@ -0,0 +1,78 @@
+#include "core/cpu/profiler.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace gbeml {
+
+TEST(ProfilerTest, chargesCyclesToInstructions) {
+  Profiler profiler;
+  profiler.sample(0, 1, 0x4000, 0xfffe, 0x00, 0);
+  profiler.sample(4, 1, 0x4001, 0xfffe, 0x00, 0);
+  profiler.sample(16, 2, 0x4000, 0xfffe, 0x00, 0);
+  profiler.sample(20, 0, 0xc000, 0xfffe, 0x00, 0);
+
+  EXPECT_EQ(4, profiler.getCycles(1, 0x4000));
+  EXPECT_EQ(12, profiler.getCycles(1, 0x4001));
+  EXPECT_EQ(4, profiler.getCycles(2, 0x4000));
+  EXPECT_EQ(0, profiler.getCycles(0, 0xc000));
+  EXPECT_EQ(20, profiler.getTotalCycles());
+}
+
+TEST(ProfilerTest, loadSymbols) {
+  std::string filename = testing::TempDir() + "profiler_test.sym";
+  {
+    std::ofstream fout(filename);
+    fout << "; File generated by rgblink\n"
+         << "00:0150 Start\n"
+         << "01:4000 Func\n"
+         << "01:4010 Func.loop ; comment\n"
+         << "00:c000 wBuffer\n";
+  }
+  Profiler profiler;
+  ASSERT_TRUE(profiler.loadSymbols(filename));
+  std::remove(filename.c_str());
+
+  EXPECT_EQ("Start", profiler.getLabel(0, 0x0150));
+  EXPECT_EQ("Start+0x3", profiler.getLabel(0, 0x0153));
+  EXPECT_EQ("Func.loop+0x2", profiler.getLabel(1, 0x4012));
+  EXPECT_EQ("02:4012", profiler.getLabel(2, 0x4012));
+  EXPECT_EQ("00:0100", profiler.getLabel(0, 0x0100));
+  EXPECT_EQ("00:8000", profiler.getLabel(0, 0x8000));
+  EXPECT_EQ("wBuffer+0x10", profiler.getLabel(0, 0xc010));
+  EXPECT_FALSE(profiler.loadSymbols(filename));
+}
+
+TEST(ProfilerTest, foldedStacks) {
+  Profiler profiler;
+  // call $4000 from $0150, then rst $38 and an interrupt inside it.
+  profiler.sample(0, 0, 0x0150, 0xfffe, 0xcd, 0);
+  profiler.sample(24, 1, 0x4000, 0xfffc, 0xff, 0);
+  profiler.sample(40, 0, 0x0038, 0xfffa, 0x00, 0);
+  profiler.sample(44, 0, 0x0039, 0xfffa, 0xc9, 0);
+  profiler.sample(60, 1, 0x4001, 0xfffc, 0x00, 0);
+  profiler.sample(64, 0, 0x0040, 0xfffa, 0xd9, 1);
+  profiler.sample(88, 1, 0x4001, 0xfffc, 0xc9, 1);
+  profiler.sample(104, 0, 0x0153, 0xfffe, 0x00, 1);
+  profiler.sample(108, 0, 0x0154, 0xfffe, 0x00, 1);
+
+  std::stringstream ss;
+  profiler.writeFoldedStacks(ss);
+  EXPECT_EQ(
+      "[top] 28\n"
+      "[top];01:4000 36\n"
+      "[top];01:4000;00:0038 20\n"
+      "[top];01:4000;00:0040 24\n",
+      ss.str());
+
+  std::stringstream report;
+  profiler.writeReport(report, 2);
+  EXPECT_NE(std::string::npos, report.str().find("Total: 108 cycles"));
+  EXPECT_NE(std::string::npos, report.str().find("00:0040"));
+}
+
+}  // namespace gbeml
@@ -0,0 +1,373 @@
+#include "core/cpu/recompiler.h"
+
+#include <iomanip>
+#include <sstream>
+
+#include "core/cpu/aot.h"
+#include "core/cpu/decoder.h"
+
+namespace gbeml {
+
+namespace {
+
+const char* kRegisterNames[] = {"r.b", "r.c", "r.d",    "r.e",
+                                "r.h", "r.l", "(hl)", "r.a"};
+const char* kPairNames[] = {"bc", "de", "hl", "sp"};
+const char* kAluNames[] = {"add_a", "adc_a", "sub_a", "sbc_a",
+                           "and_a", "xor_a", "or_a",  "cp_a"};
+const char* kRotateNames[] = {"rlc", "rrc", "rl",   "rr",
+                              "sla", "sra", "swap", "srl"};
+const char* kConditions[] = {"(r.f & 0x80) == 0", "(r.f & 0x80) != 0",
+                             "(r.f & 0x10) == 0", "(r.f & 0x10) != 0"};
+
+std::string hex(u64 value, int width) {
+  std::ostringstream out;
+  out << "0x" << std::hex << std::setw(width) << std::setfill('0') << value;
+  return out.str();
+}
+
+std::string readRegister(u8 r) {
+  return r == 6 ? "read(c, r.hl())" : kRegisterNames[r];
+}
+
+std::string writeRegister(u8 r, const std::string& value) {
+  return r == 6 ? "write(c, r.hl(), " + value + ");"
+                : std::string(kRegisterNames[r]) + " = " + value + ";";
+}
+
+std::string readPair(u8 p) {
+  return p == 3 ? "r.sp" : std::string("r.") + kPairNames[p] + "()";
+}
+
+std::string writePair(u8 p, const std::string& value) {
+  return p == 3 ? "r.sp = " + value + ";"
+                : std::string("r.set_") + kPairNames[p] + "(" + value + ");";
+}
+
+}  // namespace
+
+Recompiler::Recompiler(const Rom& rom_) : rom(rom_) {}
+
+std::vector<CodeLocation> Recompiler::findBlockStarts() const {
+  return CodeAnalysis(rom).getBlockStarts();
+}
+
+std::vector<RecompiledBlock> Recompiler::recompile() const {
+  std::vector<RecompiledBlock> blocks;
+  for (const CodeLocation& location : findBlockStarts()) {
+    RecompiledBlock block{location.bank, location.addr, 0, 0, {}};
+    // Rom offset of address 0 of the region the block is in.
+    u32 base = location.addr <= 0x3fff ? 0 : 0x4000 * (location.bank - 1);
+    u32 limit = location.addr <= 0x3fff ? 0x4000 : 0x8000;
+    u32 pc = location.addr;
+    bool ends = false;
+    while (!ends) {
+      u8 op = rom.read(base + pc);
+      u8 length = getInstructionLength(op);
+      if (pc + length > limit || base + pc + length > rom.getRomSize()) {
+        break;
+      }
+      u8 code[3] = {op, 0, 0};
+      for (u8 i = 1; i < length; ++i) {
+        code[i] = rom.read(base + pc + i);
+      }
+      if (!emitInstruction(static_cast<u16>(pc), code, &block, &ends)) {
+        break;
+      }
+      pc += length;
+    }
+    if (block.instructions == 0) {
+      continue;
+    }
+    block.length = static_cast<u16>(pc - location.addr);
+    if (!ends) {
+      block.lines.push_back("      leave(c, " + hex(pc, 4) + ");");
+      block.lines.push_back("      return;");
+    }
+    blocks.push_back(std::move(block));
+  }
+  return blocks;
+}
+
+std::string Recompiler::generate(
+    const std::vector<RecompiledBlock>& blocks) const {
+  std::ostringstream out;
+  out << "// Generated by gbeml_recompile. Do not edit.\n"
+      << "\n"
+      << "#include \"core/cpu/aot_ops.h\"\n"
+      << "\n"
+      << "namespace {\n"
+      << "\n"
+      << "using namespace gbeml;\n"
+      << "using namespace gbeml::aot;\n";
+  for (const RecompiledBlock& block : blocks) {
+    out << "\n"
+        << "void block_" << block.bank << "_" << hex(block.addr, 4)
+        << "(AotContext& c) {\n"
+        << "  Registers& r = *c.regs;\n"
+        << "  switch (r.pc) {\n";
+    for (const std::string& line : block.lines) {
+      out << line << "\n";
+    }
+    out << "  }\n"
+        << "}\n";
+  }
+  out << "\n"
+      << "}  // namespace\n"
+      << "\n"
+      << "extern \"C\" const gbeml::AotBlock gbeml_aot_blocks[] = {\n";
+  for (const RecompiledBlock& block : blocks) {
+    out << "    {" << block.bank << ", " << hex(block.addr, 4) << ", "
+        << block.length << ", block_" << block.bank << "_"
+        << hex(block.addr, 4) << "},\n";
+  }
+  if (blocks.empty()) {
+    out << "    {0, 0, 0, nullptr},\n";
+  }
+  out << "};\n"
+      << "extern \"C\" const gbeml::u64 gbeml_aot_num_blocks = "
+      << blocks.size() << ";\n"
+      << "extern \"C\" const gbeml::u64 gbeml_aot_rom_hash = "
+      << hex(AotLibrary::calcRomHash(rom), 16) << ";\n";
+  return out.str();
+}
+
+bool Recompiler::emitInstruction(u16 pc, const u8* code,
+                                 RecompiledBlock* block, bool* ends) const {
+  u8 op = code[0];
+  u8 x = op >> 6;
+  u8 y = (op >> 3) & 7;
+  u8 z = op & 7;
+  u8 p = y >> 1;
+  bool q = y & 1;
+  u8 length = getInstructionLength(op);
+  u16 word = concat(code[2], code[1]);
+  std::string at = hex(pc, 4);
+  std::string next = hex(static_cast<u16>(pc + length), 4);
+  std::string n8 = hex(code[1], 2);
+  std::string n16 = hex(word, 4);
+
+  // The memory the instruction accesses, checked before it runs.
+  std::vector<std::string> addrs;
+  bool write = false;
+  std::vector<std::string> statements;
+  // Control flow: the condition if any, the target and what runs when taken.
+  bool jumps = false;
+  i32 condition = -1;
+  std::string target;
+
+  if (op == 0x00) {
+  } else if (op == 0x08) {
+    addrs = {n16, hex(static_cast<u16>(word + 1), 4)};
+    write = true;
+    statements.push_back("writeWord(c, " + n16 + ", r.sp);");
+  } else if (op == 0x18 || (x == 0 && z == 0 && y >= 4)) {
+    jumps = true;
+    condition = op == 0x18 ? -1 : y - 4;
+    target = hex(static_cast<u16>(pc + 2 + static_cast<i8>(code[1])), 4);
+  } else if (x == 0 && z == 1) {
+    statements.push_back(q ? "add_hl(r, " + readPair(p) + ");"
+                           : writePair(p, n16));
+  } else if (x == 0 && z == 2) {
+    std::string addr = p == 0 ? "r.bc()" : p == 1 ? "r.de()" : "r.hl()";
+    addrs = {addr};
+    write = !q;
+    statements.push_back(q ? "r.a = read(c, " + addr + ");"
+                           : "write(c, " + addr + ", r.a);");
+    if (p >= 2) {
+      statements.push_back(p == 2 ? "r.set_hl(r.hl() + 1);"
+                                  : "r.set_hl(r.hl() - 1);");
+    }
+  } else if (x == 0 && z == 3) {
+    statements.push_back(
+        p == 3 ? (q ? "r.sp--;" : "r.sp++;")
+               : writePair(p, readPair(p) + (q ? " - 1" : " + 1")));
+  } else if (x == 0 && (z == 4 || z == 5)) {
+    const char* name = z == 4 ? "inc" : "dec";
+    if (y == 6) {
+      addrs = {"r.hl()"};
+      write = true;
+      statements.push_back(std::string("{ u8 v = read(c, r.hl()); ") + name +
+                           "(r, v); write(c, r.hl(), v); }");
+    } else {
+      statements.push_back(std::string(name) + "(r, " + kRegisterNames[y] +
+                           ");");
+    }
+  } else if (x == 0 && z == 6) {
+    if (y == 6) {
+      addrs = {"r.hl()"};
+      write = true;
+    }
+    statements.push_back(writeRegister(y, n8));
+  } else if (x == 0 && z == 7) {
+    const char* names[] = {"rlca", "rrca", "rla", "rra",
+                           "daa",  "cpl",  "scf", "ccf"};
+    statements.push_back(std::string(names[y]) + "(r);");
+  } else if (x == 1 && op != 0x76) {
+    if (y == 6 || z == 6) {
+      addrs = {"r.hl()"};
+      write = y == 6;
+    }
+    statements.push_back(writeRegister(y, readRegister(z)));
+  } else if (x == 2) {
+    if (z == 6) {
+      addrs = {"r.hl()"};
+    }
+    statements.push_back(std::string(kAluNames[y]) + "(r, " +
+                         readRegister(z) + ");");
+  } else if (x == 3 && z == 0 && y < 4) {
+    jumps = true;
+    condition = y;
+    addrs = {"r.sp", "r.sp + 1"};
+    target = "pop(c)";
+  } else if (op == 0xe0 || op == 0xf0) {
+    std::string addr = hex(0xff00 | code[1], 4);
+    addrs = {addr};
+    write = op == 0xe0;
+    statements.push_back(op == 0xe0 ? "write(c, " + addr + ", r.a);"
+                                    : "r.a = read(c, " + addr + ");");
+  } else if (op == 0xe8) {
+    statements.push_back("r.sp = add_sp(r, " + n8 + ");");
+  } else if (op == 0xf8) {
+    statements.push_back("r.set_hl(add_sp(r, " + n8 + "));");
+  } else if (x == 3 && z == 1 && !q) {
+    addrs = {"r.sp", "r.sp + 1"};
+    statements.push_back(p == 3 ? "r.set_af(pop(c));"
+                                : writePair(p, "pop(c)"));
+  } else if (op == 0xc9 || op == 0xd9) {
+    jumps = true;
+    addrs = {"r.sp", "r.sp + 1"};
+    target = "pop(c)";
+    if (op == 0xd9) {
+      statements.push_back("c.ime = true;");
+    }
+  } else if (op == 0xe9) {
+    jumps = true;
+    target = "r.hl()";
+  } else if (op == 0xf9) {
+    statements.push_back("r.sp = r.hl();");
+  } else if ((x == 3 && z == 2 && y < 4) || op == 0xc3) {
+    jumps = true;
+    condition = op == 0xc3 ? -1 : y;
+    target = n16;
+  } else if (op == 0xe2 || op == 0xf2) {
+    addrs = {"0xff00 + r.c"};
+    write = op == 0xe2;
+    statements.push_back(op == 0xe2 ? "write(c, 0xff00 + r.c, r.a);"
+                                    : "r.a = read(c, 0xff00 + r.c);");
+  } else if (op == 0xea || op == 0xfa) {
+    addrs = {n16};
+    write = op == 0xea;
+    statements.push_back(op == 0xea ? "write(c, " + n16 + ", r.a);"
+                                    : "r.a = read(c, " + n16 + ");");
+  } else if (op == 0xcb) {
+    u8 cb = code[1];
+    u8 cx = cb >> 6;
+    u8 cy = (cb >> 3) & 7;
+    u8 cz = cb & 7;
+    if (cz == 6) {
+      addrs = {"r.hl()"};
+      write = cx != 1;
+    }
+    if (cx == 0) {
+      statements.push_back(writeRegister(
+          cz, std::string(kRotateNames[cy]) + "(r, " + readRegister(cz) +
+                  ")"));
+    } else if (cx == 1) {
+      statements.push_back("bit(r, " + std::to_string(cy) + ", " +
+                           readRegister(cz) + ");");
+    } else {
+      u8 mask = static_cast<u8>(1 << cy);
+      statements.push_back(writeRegister(
+          cz, readRegister(cz) +
+                  (cx == 2 ? " & " + hex(static_cast<u8>(~mask), 2)
+                           : " | " + hex(mask, 2))));
+    }
+  } else if (op == 0xf3 || op == 0xfb) {
+    statements.push_back(op == 0xf3 ? "c.ime = false;" : "c.ime = true;");
+    if (op == 0xfb) {
+      // Interrupts may be pending already.
+      statements.push_back("c.stop = true;");
+    }
+  } else if ((x == 3 && z == 4 && y < 4) || op == 0xcd) {
+    jumps = true;
+    condition = op == 0xcd ? -1 : y;
+    addrs = {"r.sp - 2", "r.sp - 1"};
+    write = true;
+    statements.push_back("push(c, " + next + ");");
+    target = n16;
+  } else if (x == 3 && z == 5 && !q) {
+    addrs = {"r.sp - 2", "r.sp - 1"};
+    write = true;
+    statements.push_back("push(c, " +
+                         (p == 3 ? "concat(r.a, r.f) & 0xfff0"
+                                 : readPair(p)) +
+                         ");");
+  } else if (x == 3 && z == 6) {
+    statements.push_back(std::string(kAluNames[y]) + "(r, " + n8 + ");");
+  } else if (x == 3 && z == 7) {
+    jumps = true;
+    addrs = {"r.sp - 2", "r.sp - 1"};
+    write = true;
+    statements.push_back("push(c, " + next + ");");
+    target = hex(y * 8, 4);
+  } else {
+    // halt, stop and the unused opcodes.
+    return false;
+  }
+
+  std::vector<std::string>& lines = block->lines;
+  if (block->instructions > 0) {
+    lines.push_back("      [[fallthrough]];");
+  }
+  lines.push_back("    case " + at + ":");
+  lines.push_back("      if (!begin(c, " + at + ")) return;");
+  std::string check;
+  if (!addrs.empty()) {
+    check = "if (!access(c, " + at;
+    for (const std::string& addr : addrs) {
+      check += ", " + addr;
+    }
+    check += write ? ", true)) return;" : ", false)) return;";
+  }
+  block->instructions++;
+
+  u32 cycles = getInstructionCycles(op, code[1], false);
+  if (!jumps) {
+    if (!check.empty()) {
+      lines.push_back("      " + check);
+    }
+    for (const std::string& statement : statements) {
+      lines.push_back("      " + statement);
+    }
+    lines.push_back("      retire(c, " + std::to_string(cycles) + ");");
+    return true;
+  }
+
+  *ends = true;
+  std::string indent = condition < 0 ? "      " : "        ";
+  if (condition >= 0) {
+    lines.push_back(std::string("      if (") + kConditions[condition] +
+                    ") {");
+  }
+  if (!check.empty()) {
+    lines.push_back(indent + check);
+  }
+  for (const std::string& statement : statements) {
+    lines.push_back(indent + statement);
+  }
+  lines.push_back(indent + "r.pc = " + target + ";");
+  lines.push_back(indent + "retire(c, " +
+                  std::to_string(getInstructionCycles(op, code[1], true)) + ");");
+  if (condition >= 0) {
+    lines.push_back("      } else {");
+    lines.push_back("        r.pc = " + next + ";");
+    lines.push_back("        retire(c, " + std::to_string(cycles) + ");");
+    lines.push_back("      }");
+  }
+  lines.push_back("      c.end = " + next + ";");
+  lines.push_back("      return;");
+  return true;
+}
+
+}  // namespace gbeml
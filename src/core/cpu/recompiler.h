@@ -0,0 +1,55 @@
+#ifndef GBEML_RECOMPILER_H_
+#define GBEML_RECOMPILER_H_
+
+#include <string>
+#include <vector>
+
+#include "core/cpu/code_analysis.h"
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// A block as C++ lines on AotContext& c and Registers& r: the cases of a
+// switch on the pc, one per instruction, so that the code can be entered at
+// any of them.
+struct RecompiledBlock {
+  u32 bank;
+  u16 addr;
+  // Size and number of the instructions recompiled.
+  u16 length;
+  u16 instructions;
+  std::vector<std::string> lines;
+};
+
+// Finds the code reachable from the entry points of a rom and generates C++
+// for it, to be built into a shared library and loaded with AotLibrary.
+//
+// Each block is recompiled up to the control flow instruction that ends it,
+// with memory accesses through the callbacks of AotContext and the cycles of
+// each instruction as the interpreter counts them. Blocks are keyed by the rom
+// bank they are in, so switchable banks are covered wherever the analysis
+// follows the bank mapped (see CodeAnalysis). halt, stop and the unused
+// opcodes end the code and are left to the interpreter.
+class Recompiler {
+ public:
+  explicit Recompiler(const Rom& rom_);
+
+  // The entry points, jump, call and rst targets and the instructions after
+  // control flow.
+  std::vector<CodeLocation> findBlockStarts() const;
+  std::vector<RecompiledBlock> recompile() const;
+  std::string generate(const std::vector<RecompiledBlock>& blocks) const;
+
+ private:
+  const Rom& rom;
+
+  // Appends the case for the instruction at pc to the block, or returns false
+  // if it is not recompiled. Sets ends after control flow.
+  bool emitInstruction(u16 pc, const u8* code, RecompiledBlock* block,
+                       bool* ends) const;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_RECOMPILER_H_
@@ -0,0 +1,166 @@
+#include "core/cpu/recompiler.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include "core/cpu/aot.h"
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+namespace {
+
+Rom makeRom(u8 cartridge_type) {
+  std::vector<u8> data(0x8000);
+  data[0x147] = cartridge_type;
+  data[0x148] = 0x00;
+  // nop; jp 0x0150
+  std::vector<u8> entry = {0x00, 0xc3, 0x50, 0x01};
+  std::copy(entry.begin(), entry.end(), data.begin() + 0x100);
+  // loop: ld a, 0x12; inc b; add a, b; ld (hl), a; jr nz, loop;
+  // call 0x4000; halt; jr -2
+  std::vector<u8> main = {0x3e, 0x12, 0x04, 0x80, 0x77, 0x20, 0xf9,
+                          0xcd, 0x00, 0x40, 0x76, 0x18, 0xfe};
+  std::copy(main.begin(), main.end(), data.begin() + 0x150);
+  // cpl; ret
+  data[0x4000] = 0x2f;
+  data[0x4001] = 0xc9;
+
+  Rom rom;
+  rom.load(data);
+  return rom;
+}
+
+bool contains(const std::vector<CodeLocation>& v, u32 bank, u16 addr) {
+  return std::find(v.begin(), v.end(), CodeLocation{bank, addr}) != v.end();
+}
+
+}  // namespace
+
+TEST(RecompilerTest, findBlockStarts) {
+  Rom rom = makeRom(0x00);
+  Recompiler recompiler(rom);
+  std::vector<CodeLocation> starts = recompiler.findBlockStarts();
+
+  for (u16 addr : {0x0100, 0x0150, 0x0157, 0x015a, 0x015b}) {
+    EXPECT_TRUE(contains(starts, 0, addr)) << std::hex << addr;
+  }
+  EXPECT_TRUE(contains(starts, 1, 0x4000));
+  EXPECT_FALSE(contains(starts, 0, 0x0152));
+  EXPECT_FALSE(contains(starts, 1, 0x4002));
+}
+
+TEST(RecompilerTest, findBlockStarts_mbcCoversSwitchableBank) {
+  Rom rom = makeRom(0x01);
+  Recompiler recompiler(rom);
+  std::vector<CodeLocation> starts = recompiler.findBlockStarts();
+
+  EXPECT_TRUE(contains(starts, 0, 0x0150));
+  EXPECT_TRUE(contains(starts, 1, 0x4000));
+}
+
+TEST(RecompilerTest, recompile) {
+  Rom rom = makeRom(0x00);
+  Recompiler recompiler(rom);
+  std::vector<RecompiledBlock> blocks = recompiler.recompile();
+
+  auto block = std::find_if(blocks.begin(), blocks.end(), [](const auto& b) {
+    return b.addr == 0x0150;
+  });
+  ASSERT_NE(blocks.end(), block);
+  EXPECT_EQ(0, block->bank);
+  // Up to and including jr nz.
+  EXPECT_EQ(7, block->length);
+  EXPECT_EQ(5, block->instructions);
+  std::vector<std::string> lines = {
+      "    case 0x0150:",
+      "      if (!begin(c, 0x0150)) return;",
+      "      r.a = 0x12;",
+      "      retire(c, 8);",
+      "      [[fallthrough]];",
+      "    case 0x0152:",
+      "      if (!begin(c, 0x0152)) return;",
+      "      inc(r, r.b);",
+      "      retire(c, 4);",
+      "      [[fallthrough]];",
+      "    case 0x0153:",
+      "      if (!begin(c, 0x0153)) return;",
+      "      add_a(r, r.b);",
+      "      retire(c, 4);",
+      "      [[fallthrough]];",
+      "    case 0x0154:",
+      "      if (!begin(c, 0x0154)) return;",
+      "      if (!access(c, 0x0154, r.hl(), true)) return;",
+      "      write(c, r.hl(), r.a);",
+      "      retire(c, 8);",
+      "      [[fallthrough]];",
+      "    case 0x0155:",
+      "      if (!begin(c, 0x0155)) return;",
+      "      if ((r.f & 0x80) == 0) {",
+      "        r.pc = 0x0150;",
+      "        retire(c, 12);",
+      "      } else {",
+      "        r.pc = 0x0157;",
+      "        retire(c, 8);",
+      "      }",
+      "      c.end = 0x0157;",
+      "      return;"};
+  EXPECT_EQ(lines, block->lines);
+
+  // halt is left to the interpreter.
+  for (const RecompiledBlock& b : blocks) {
+    EXPECT_NE(0x015a, b.addr);
+  }
+}
+
+TEST(RecompilerTest, recompile_mbcCoversSwitchableBank) {
+  Rom rom = makeRom(0x01);
+  Recompiler recompiler(rom);
+  std::vector<RecompiledBlock> blocks = recompiler.recompile();
+
+  auto block = std::find_if(blocks.begin(), blocks.end(), [](const auto& b) {
+    return b.bank == 1 && b.addr == 0x4000;
+  });
+  ASSERT_NE(blocks.end(), block);
+  EXPECT_EQ(2, block->length);
+  EXPECT_EQ(2, block->instructions);
+}
+
+TEST(RecompilerTest, generate) {
+  Rom rom = makeRom(0x00);
+  Recompiler recompiler(rom);
+  std::string code = recompiler.generate(recompiler.recompile());
+
+  EXPECT_NE(std::string::npos,
+            code.find("void block_1_0x4000(AotContext& c) {\n"
+                      "  Registers& r = *c.regs;\n"
+                      "  switch (r.pc) {\n"
+                      "    case 0x4000:\n"
+                      "      if (!begin(c, 0x4000)) return;\n"
+                      "      cpl(r);\n"
+                      "      retire(c, 4);\n"
+                      "      [[fallthrough]];\n"
+                      "    case 0x4001:\n"
+                      "      if (!begin(c, 0x4001)) return;\n"
+                      "      if (!access(c, 0x4001, r.sp, r.sp + 1, false)) "
+                      "return;\n"
+                      "      r.pc = pop(c);\n"
+                      "      retire(c, 16);\n"
+                      "      c.end = 0x4002;\n"
+                      "      return;\n"
+                      "  }\n"
+                      "}\n"));
+  EXPECT_NE(std::string::npos,
+            code.find("    {1, 0x4000, 2, block_1_0x4000},\n"));
+  std::ostringstream hash;
+  hash << "gbeml_aot_rom_hash = 0x" << std::hex << std::setw(16)
+       << std::setfill('0') << AotLibrary::calcRomHash(rom) << ";\n";
+  EXPECT_NE(std::string::npos, code.find(hash.str()));
+}
+
+}  // namespace gbeml
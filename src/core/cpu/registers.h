@@ -0,0 +1,53 @@
+#ifndef GBEML_REGISTERS_H_
+#define GBEML_REGISTERS_H_
+
+#include <type_traits>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Register file of the cpu. It is kept as plain data so that the whole cpu
+// state can be copied with memcpy.
+struct Registers {
+  u8 a = 0;
+  u8 f = 0;
+  u8 b = 0;
+  u8 c = 0;
+  u8 d = 0;
+  u8 e = 0;
+  u8 h = 0;
+  u8 l = 0;
+  u16 sp = 0;
+  u16 pc = 0;
+
+  bool operator==(const Registers&) const = default;
+
+  u16 af() const { return concat(a, f); }
+  u16 bc() const { return concat(b, c); }
+  u16 de() const { return concat(d, e); }
+  u16 hl() const { return concat(h, l); }
+
+  void set_af(u16 n) {
+    a = n >> 8;
+    f = n & 0xff;
+  }
+  void set_bc(u16 n) {
+    b = n >> 8;
+    c = n & 0xff;
+  }
+  void set_de(u16 n) {
+    d = n >> 8;
+    e = n & 0xff;
+  }
+  void set_hl(u16 n) {
+    h = n >> 8;
+    l = n & 0xff;
+  }
+};
+
+static_assert(std::is_trivially_copyable_v<Registers>);
+
+}  // namespace gbeml
+
+#endif  // GBEML_REGISTERS_H_
@@ -0,0 +1,36 @@
+#include "core/cpu/registers.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+namespace gbeml {
+
+TEST(RegistersTest, pairs) {
+  Registers regs;
+  regs.b = 0x12;
+  regs.c = 0x34;
+  EXPECT_EQ(0x1234, regs.bc());
+
+  regs.set_hl(0xabcd);
+  EXPECT_EQ(0xab, regs.h);
+  EXPECT_EQ(0xcd, regs.l);
+  EXPECT_EQ(0xabcd, regs.hl());
+}
+
+TEST(RegistersTest, copy) {
+  Registers regs;
+  regs.set_af(0x01b0);
+  regs.set_de(0x00d8);
+  regs.sp = 0xfffe;
+  regs.pc = 0x0100;
+
+  Registers copied;
+  std::memcpy(&copied, &regs, sizeof(Registers));
+  EXPECT_EQ(0x01b0, copied.af());
+  EXPECT_EQ(0x00d8, copied.de());
+  EXPECT_EQ(0xfffe, copied.sp);
+  EXPECT_EQ(0x0100, copied.pc);
+}
+
+}  // namespace gbeml
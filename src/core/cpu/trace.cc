@@ -0,0 +1,102 @@
+#include "core/cpu/trace.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+namespace gbeml {
+
+namespace {
+
+struct TraceHeader {
+  char magic[4];
+  u32 version;
+  u32 entry_size;
+  u32 unused;
+  u64 count;
+};
+
+bool writeAll(int fd, const void* data, std::size_t size) {
+  const char* p = static_cast<const char*>(data);
+  while (size > 0) {
+    ssize_t n = ::write(fd, p, size);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    size -= n;
+  }
+  return true;
+}
+
+}  // namespace
+
+TraceBuffer::TraceBuffer(u32 capacity)
+    : entries(std::bit_ceil(std::max(capacity, 1u))),
+      mask(entries.size() - 1) {}
+
+std::vector<TraceEntry> TraceBuffer::getEntries() const {
+  u64 size = std::min<u64>(next, entries.size());
+  std::vector<TraceEntry> result;
+  result.reserve(size);
+  for (u64 i = next - size; i < next; ++i) {
+    result.push_back(entries[i & mask]);
+  }
+  return result;
+}
+
+bool TraceBuffer::dump(int fd) const {
+  u64 size = std::min<u64>(next, entries.size());
+  TraceHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.entry_size = sizeof(TraceEntry);
+  header.count = size;
+  if (!writeAll(fd, &header, sizeof(header))) {
+    return false;
+  }
+
+  // The oldest kept entry is at next, unless the buffer has not wrapped.
+  u64 start = (next - size) & mask;
+  u64 first = std::min<u64>(size, entries.size() - start);
+  return writeAll(fd, &entries[start], first * sizeof(TraceEntry)) &&
+         writeAll(fd, &entries[0], (size - first) * sizeof(TraceEntry));
+}
+
+bool TraceBuffer::save(const std::string& filename) const {
+  int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  bool ok = dump(fd);
+  return ::close(fd) == 0 && ok;
+}
+
+bool TraceBuffer::load(const std::string& filename,
+                       std::vector<TraceEntry>* entries) {
+  std::ifstream fin(filename, std::ios::binary | std::ios::ate);
+  std::streamoff size = fin.tellg();
+  fin.seekg(0);
+  TraceHeader header;
+  if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.entry_size != sizeof(TraceEntry)) {
+    return false;
+  }
+  // A truncated or corrupt file may claim more entries than it holds. Divided
+  // rather than multiplied, so that a large count cannot overflow.
+  if (header.count >
+      (static_cast<u64>(size) - sizeof(header)) / sizeof(TraceEntry)) {
+    return false;
+  }
+  entries->resize(header.count);
+  return static_cast<bool>(
+      fin.read(reinterpret_cast<char*>(entries->data()),
+               header.count * sizeof(TraceEntry)));
+}
+
+}  // namespace gbeml
@@ -0,0 +1,63 @@
+#ifndef GBEML_TRACE_H_
+#define GBEML_TRACE_H_
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "core/cpu/registers.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// The state of the cpu when it starts an instruction. Dumps store entries as
+// they are in memory.
+struct TraceEntry {
+  // T-cycles since the cpu was created.
+  u64 cycle;
+  Registers regs;
+  // Rom bank mapped at regs.pc, 0 outside rom.
+  u16 bank;
+  // The bytes of the instruction, padded with zeros.
+  u8 code[3];
+  u8 ime;
+  u8 unused[4];
+};
+
+static_assert(sizeof(TraceEntry) == 32);
+static_assert(std::is_trivially_copyable_v<TraceEntry>);
+
+// Keeps the last entries recorded in a preallocated ring buffer.
+class TraceBuffer {
+ public:
+  static constexpr char kMagic[4] = {'G', 'B', 'T', 'R'};
+  static constexpr u32 kVersion = 1;
+
+  // capacity is rounded up to a power of two.
+  explicit TraceBuffer(u32 capacity);
+
+  void record(const TraceEntry& entry) { entries[next++ & mask] = entry; }
+
+  u32 getCapacity() const { return mask + 1; }
+  // Number of entries recorded in total, including overwritten ones.
+  u64 getRecorded() const { return next; }
+  // Returns the kept entries, oldest first.
+  std::vector<TraceEntry> getEntries() const;
+  void clear() { next = 0; }
+
+  // Writes a header and the kept entries, oldest first, with write(2) only,
+  // so that it can be called from a signal handler.
+  bool dump(int fd) const;
+  bool save(const std::string& filename) const;
+  static bool load(const std::string& filename,
+                   std::vector<TraceEntry>* entries);
+
+ private:
+  std::vector<TraceEntry> entries;
+  u64 mask;
+  u64 next = 0;
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_TRACE_H_
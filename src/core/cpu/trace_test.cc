@@ -0,0 +1,152 @@
+#include "core/cpu/trace.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/cpu/cpu.h"
+#include "core/cpu/profiler.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+
+namespace gbeml {
+
+class TraceBus : public Bus {
+ public:
+  u8 read(u16 addr) const override {
+    reads++;
+    return memory[addr];
+  }
+  u8 peek(u16 addr) const override { return memory[addr]; }
+  void write(u16 addr, u8 value) override { memory[addr] = value; }
+  u32 getRomBank(u16 addr) const override { return addr / 0x4000; }
+  void tick() override {}
+  void advance(u64) override {}
+  u64 getCyclesUntilChange(u16) const override { return 0; }
+
+  std::vector<u8> memory = std::vector<u8>(0x10000);
+  mutable u32 reads = 0;
+};
+
+TraceEntry makeEntry(u64 cycle) {
+  TraceEntry entry = {};
+  entry.cycle = cycle;
+  return entry;
+}
+
+TEST(TraceBufferTest, keepsLastEntries) {
+  TraceBuffer trace(3);
+  EXPECT_EQ(4, trace.getCapacity());
+
+  for (u64 i = 0; i < 6; ++i) {
+    trace.record(makeEntry(i));
+  }
+  EXPECT_EQ(6, trace.getRecorded());
+  std::vector<TraceEntry> entries = trace.getEntries();
+  ASSERT_EQ(4, entries.size());
+  for (u64 i = 0; i < 4; ++i) {
+    EXPECT_EQ(i + 2, entries[i].cycle);
+  }
+}
+
+TEST(TraceBufferTest, saveAndLoad) {
+  TraceBuffer trace(4);
+  for (u64 i = 0; i < 5; ++i) {
+    trace.record(makeEntry(i));
+  }
+  std::string filename = testing::TempDir() + "trace_test.trace";
+  ASSERT_TRUE(trace.save(filename));
+
+  std::vector<TraceEntry> entries;
+  ASSERT_TRUE(TraceBuffer::load(filename, &entries));
+  std::remove(filename.c_str());
+  ASSERT_EQ(4, entries.size());
+  for (u64 i = 0; i < 4; ++i) {
+    EXPECT_EQ(i + 1, entries[i].cycle);
+  }
+  EXPECT_FALSE(TraceBuffer::load(filename, &entries));
+}
+
+TEST(TraceBufferTest, load_rejectsCountBeyondFile) {
+  TraceBuffer trace(4);
+  trace.record(makeEntry(0));
+  std::string filename = testing::TempDir() + "trace_test_count.trace";
+  ASSERT_TRUE(trace.save(filename));
+
+  // The count follows the magic, the version, the entry size and padding.
+  auto writeCount = [&filename](u64 count) {
+    std::fstream file(filename,
+                      std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(16);
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+  };
+  std::vector<TraceEntry> entries;
+  writeCount(u64{1} << 40);
+  EXPECT_FALSE(TraceBuffer::load(filename, &entries));
+  EXPECT_TRUE(entries.empty());
+  writeCount(2);
+  EXPECT_FALSE(TraceBuffer::load(filename, &entries));
+  writeCount(1);
+  EXPECT_TRUE(TraceBuffer::load(filename, &entries));
+  std::remove(filename.c_str());
+}
+
+TEST(TraceBufferTest, cpuRecordsInstructions) {
+  TraceBus bus;
+  InterruptControllerImpl ic;
+  // ld bc, $1234; inc a; nop
+  bus.memory = {0x01, 0x34, 0x12, 0x3c, 0x00};
+  bus.memory.resize(0x10000);
+
+  TraceBuffer trace(8);
+  Cpu cpu(&bus, &ic);
+  cpu.setTrace(&trace);
+  for (int i = 0; i < 3; ++i) {
+    cpu.step();
+  }
+
+  std::vector<TraceEntry> entries = trace.getEntries();
+  ASSERT_EQ(3, entries.size());
+  EXPECT_EQ(0, entries[0].cycle);
+  EXPECT_EQ(0, entries[0].regs.pc);
+  EXPECT_EQ(0x01, entries[0].code[0]);
+  EXPECT_EQ(0x34, entries[0].code[1]);
+  EXPECT_EQ(0x12, entries[0].code[2]);
+  EXPECT_EQ(12, entries[1].cycle);
+  EXPECT_EQ(3, entries[1].regs.pc);
+  EXPECT_EQ(0x1234, entries[1].regs.bc());
+  EXPECT_EQ(0x3c, entries[1].code[0]);
+  EXPECT_EQ(0, entries[1].code[1]);
+  EXPECT_EQ(16, entries[2].cycle);
+  EXPECT_EQ(1, entries[2].regs.a);
+  EXPECT_EQ(20, cpu.getCycles());
+}
+
+TEST(TraceBufferTest, cpuPeeksInstructions) {
+  // ld bc, $1234; inc a; nop
+  std::vector<u8> code = {0x01, 0x34, 0x12, 0x3c, 0x00};
+  code.resize(0x10000);
+  InterruptControllerImpl ic;
+
+  TraceBus plain_bus;
+  plain_bus.memory = code;
+  Cpu plain(&plain_bus, &ic);
+  TraceBus bus;
+  bus.memory = code;
+  TraceBuffer trace(8);
+  Profiler profiler;
+  Cpu cpu(&bus, &ic);
+  cpu.setTrace(&trace);
+  cpu.setProfiler(&profiler);
+  for (int i = 0; i < 3; ++i) {
+    plain.step();
+    cpu.step();
+  }
+
+  EXPECT_EQ(3, trace.getRecorded());
+  EXPECT_EQ(plain_bus.reads, bus.reads);
+}
+
+}  // namespace gbeml
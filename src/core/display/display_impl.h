@@ -5,7 +5,7 @@
 
 namespace gbeml {
 
-class DisplayImpl : public Display {
+class DisplayImpl final : public Display {
  public:
   void render(u8 x, u8 y, Color pixel) override;
   u32* getBuffer() override;
@@ -1,23 +1,211 @@
 #include "gameboy.h"
 
-#include "core/bus/bus_impl.h"
-#include "core/display/display_impl.h"
-#include "core/graphics/ppu_impl.h"
-#include "core/interrupt/interrupt_controller_impl.h"
-#include "core/joypad/joypad_impl.h"
-#include "core/memory/ram_impl.h"
-#include "core/timer/timer_impl.h"
+#include <algorithm>
+#include <numeric>
+
+#include "core/log/logging.h"
 
 namespace gbeml {
 
 void GameBoy::tick() {
+  if (cpu->isInstrumented()) {
+    tickAs<true>();
+  } else {
+    tickAs<false>();
+  }
+}
+
+u64 GameBoy::tickMCycle() {
+  return cpu->isInstrumented() ? tickMCycleAs<true>() : tickMCycleAs<false>();
+}
+
+u64 GameBoy::step() {
+  return cpu->isInstrumented() ? stepAs<true>() : stepAs<false>();
+}
+
+template <bool Instrumented>
+void GameBoy::tickAs() {
   timer->tick();
-  cpu->tick();
+  cpu->tickAs<Instrumented>();
+  // The cycles the cpu runs past the first count towards the next cycle of
+  // the others, for getCyclesUntilInterrupt().
+  for (u32 i = 1; i < options.cpu_clock_multiplier; ++i) {
+    overclock_cycles = i;
+    cpu->tickAs<Instrumented>();
+  }
+  overclock_cycles = 0;
   ppu->tick();
   bus->tick();
 }
 
+template <bool Instrumented>
+u64 GameBoy::tickMCycleAs() {
+  timer->advance(4);
+  cpu->advanceAs<Instrumented>(4 * options.cpu_clock_multiplier);
+  ppu->advance(4);
+  bus->advance(4);
+  return 4;
+}
+
+template <bool Instrumented>
+u64 GameBoy::stepAs() {
+  if (options.cpu_clock_multiplier > 1) {
+    // The other components catch up on whole cycles of theirs, and the rest
+    // is carried over to the next instruction.
+    overclock_cycles += cpu->stepAs<Instrumented>();
+    u64 n = overclock_cycles / options.cpu_clock_multiplier;
+    overclock_cycles %= options.cpu_clock_multiplier;
+    timer->advance(n);
+    ppu->advance(n);
+    bus->advance(n);
+    return n;
+  }
+
+  // The timer is ticked first so that the cpu sees the same timer state as
+  // in tick(). The cpu only looks at the other components when it starts the
+  // next instruction, so the rest of the cycles can be caught up in bulk.
+  timer->tick();
+  u64 cycles = cpu->stepAs<Instrumented>();
+  ppu->advance(cycles);
+  bus->advance(cycles);
+  if (cycles > 1) {
+    timer->advance(cycles - 1);
+  }
+  return cycles;
+}
+
+void GameBoy::advance(u64 n) {
+  if (cpu->isInstrumented()) {
+    advanceAs<true>(n);
+  } else {
+    advanceAs<false>(n);
+  }
+}
+
+template <bool Instrumented>
+void GameBoy::advanceAs(u64 n) {
+  if (options.accuracy == Accuracy::TCycle) {
+    for (u64 i = 0; i < n;) {
+      u64 skipped = skip(n - i);
+      if (skipped > 0) {
+        i += skipped;
+        continue;
+      }
+      tickAs<Instrumented>();
+      i++;
+    }
+    return;
+  }
+
+  while (overrun_cycles < n) {
+    u64 skipped = skip(n - overrun_cycles);
+    if (skipped > 0) {
+      overrun_cycles += skipped;
+    } else if (options.accuracy == Accuracy::MCycle) {
+      overrun_cycles += tickMCycleAs<Instrumented>();
+    } else {
+      overrun_cycles += stepAs<Instrumented>();
+    }
+  }
+  overrun_cycles -= n;
+}
+
+u64 GameBoy::getCyclesUntilInterrupt() const {
+  u64 n = std::min(timer->getCyclesUntilInterrupt(),
+                   ppu->getCyclesUntilInterrupt());
+  u64 multiplier = options.cpu_clock_multiplier;
+  if (n > UINT64_MAX / multiplier) {
+    return UINT64_MAX;
+  }
+  // The cpu cycles carried over count towards the next cycle of the others.
+  return n * multiplier - std::min(n * multiplier, overclock_cycles);
+}
+
+u64 GameBoy::skip(u64 limit) {
+  u64 n = fastForward(limit);
+  return n > 0 ? n : skipIdleLoop(limit);
+}
+
+u64 GameBoy::fastForward(u64 limit) {
+  if (!options.fast_forward_halt || !cpu->isHalted() || cpu->isStalled() ||
+      ic->getPendingInterrupts() != 0) {
+    return 0;
+  }
+
+  // The cycle that signals the interrupt runs normally, so that the cpu sees
+  // it in the same cycle as without fast-forwarding.
+  u64 n = std::min({timer->getCyclesUntilInterrupt(),
+                    ppu->getCyclesUntilInterrupt(), limit + 1}) -
+          1;
+  if (n == 0) {
+    return 0;
+  }
+  timer->advance(n);
+  ppu->advance(n);
+  bus->advance(n);
+  cpu->skipHalted(n * options.cpu_clock_multiplier);
+  return n;
+}
+
+u64 GameBoy::skipIdleLoop(u64 limit) {
+  const IdleLoop* loop = cpu->getIdleLoop();
+  if (loop == nullptr || cpu->hasBreakpoints() ||
+      ic->getPendingInterrupts() != 0) {
+    return 0;
+  }
+
+  // A value may have changed after the previous iteration read it. The values
+  // polled change monotonically and not twice within an iteration, so if they
+  // are the same as at the start of that iteration, so were the reads.
+  IdleValues values = {};
+  u8 num_values = 0;
+  u64 until = std::min(timer->getCyclesUntilInterrupt(),
+                       ppu->getCyclesUntilInterrupt());
+  // Peeked, so that sampling has no side effects such as coverage marks.
+  auto sample = [&](u16 addr) {
+    values[num_values++] = bus->peek(addr);
+    until = std::min(until, bus->getCyclesUntilChange(addr));
+  };
+  for (u8 i = 0; i < loop->num_addrs; ++i) {
+    sample(loop->addrs[i]);
+  }
+  if (loop->polls_hl) {
+    sample(cpu->get_hl());
+  }
+  u64 retired = cpu->getRetiredInstructions();
+  bool repeated = loop == idle_loop && values == idle_values &&
+                  retired == idle_retired + loop->instructions;
+  idle_loop = loop;
+  idle_values = values;
+  idle_retired = retired;
+  if (!repeated || until == 0) {
+    return 0;
+  }
+
+  // Reads in the skipped iterations must happen before the change. The loop
+  // runs on the cpu clock, so with a multiplier only whole cycles of the
+  // others are skipped.
+  u64 multiplier = options.cpu_clock_multiplier;
+  u64 iterations = std::min(until - 1, limit) * multiplier / loop->cycles;
+  u64 step = multiplier / std::gcd<u64, u64>(multiplier, loop->cycles);
+  iterations -= iterations % step;
+  if (iterations == 0) {
+    return 0;
+  }
+  u64 n = iterations * loop->cycles / multiplier;
+  timer->advance(n);
+  ppu->advance(n);
+  bus->advance(n);
+  cpu->skipIdleLoop(iterations);
+  idle_retired = cpu->getRetiredInstructions();
+  return n;
+}
+
 bool GameBoy::init(const std::string& filename) {
+  if (options.cpu_clock_multiplier == 0) {
+    LOG(ERROR) << "The cpu clock multiplier must be at least 1." << std::endl;
+    return false;
+  }
   display = new DisplayImpl();
   ic = new InterruptControllerImpl(0xe1, 0x00);
   timer = new TimerImpl(ic, 0xab, 0x00, 0x00, 0xf8);
@@ -44,8 +232,19 @@ bool GameBoy::init(const std::string& filename) {
   oam = new RamImpl(160);
 
   ppu = new PpuImpl(display, vram, oam, ic);
+  ppu->setScanlineRendering(options.accuracy == Accuracy::Instruction);
   bus = new BusImpl(mbc, wram, hram, ppu, timer, ic, joypad);
+  joypad->registerIo(bus->getIoTable());
+  timer->registerIo(bus->getIoTable());
+  ic->registerIo(bus->getIoTable());
+  ppu->registerIo(bus->getIoTable());
+  bus->setCpuClockMultiplier(options.cpu_clock_multiplier);
   cpu = new Cpu(bus, ic);
+  if (options.coverage) {
+    coverage = new Coverage(rom->getRomSize());
+    bus->setCoverage(coverage);
+    cpu->setCoverage(coverage);
+  }
 
   cpu->set_a(0x01);
   cpu->set_f(0x80);
@@ -57,7 +256,37 @@ bool GameBoy::init(const std::string& filename) {
   cpu->set_l(0x4d);
   cpu->set_pc(0x0100);
   cpu->set_sp(0xfffe);
-  cpu->setBreakpoint(breakpoint);
+  cpu->setLazyFlags(options.lazy_flags);
+  cpu->setAluBackend(options.alu_tables ? AluBackend::Table
+                                        : AluBackend::Logic);
+  cpu->setBlockCache(options.block_cache);
+  cpu->setJit(options.jit || options.jit_differential,
+              options.jit_differential);
+  cpu->setIdleLoopDetection(options.skip_idle_loops);
+  if (!options.aot_library.empty()) {
+    aot = new AotLibrary();
+    if (!aot->load(options.aot_library)) {
+      return false;
+    }
+    if (aot->getRomHash() != AotLibrary::calcRomHash(*rom)) {
+      LOG(ERROR) << options.aot_library << " was generated for another rom."
+                 << std::endl;
+      return false;
+    }
+    cpu->setAot(aot);
+  }
+  cpu->setInterruptLimit([this] { return getCyclesUntilInterrupt(); });
+  if (options.code_analysis != nullptr &&
+      options.code_analysis->getRomHash() != AotLibrary::calcRomHash(*rom)) {
+    LOG(ERROR) << "The code analysis is for another rom." << std::endl;
+    return false;
+  }
+  if (options.code_analysis == nullptr && options.analyze_rom) {
+    options.code_analysis = std::make_shared<const CodeAnalysis>(*rom);
+  }
+  if (options.code_analysis != nullptr) {
+    cpu->prefillBlockCache(*options.code_analysis, *rom);
+  }
 
   ppu->writeLcdc(0x91);
   ppu->writeLcdStat(0x81);
@@ -75,6 +304,16 @@ bool GameBoy::init(const std::string& filename) {
 
 Display* GameBoy::getDisplay() const { return display; }
 
+Cpu* GameBoy::getCpu() const { return cpu; }
+
+Joypad* GameBoy::getJoypad() const { return joypad; }
+
+Coverage* GameBoy::getCoverage() const { return coverage; }
+
+const CodeAnalysis* GameBoy::getCodeAnalysis() const {
+  return options.code_analysis.get();
+}
+
 void GameBoy::press(JoypadButton button) { joypad->press(button); }
 
 void GameBoy::release(JoypadButton button) { joypad->release(button); }
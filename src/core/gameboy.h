@@ -1,46 +1,144 @@
 #ifndef GBEML_GAMEBOY_H_
 #define GBEML_GAMEBOY_H_
 
+#include <array>
+#include <memory>
 #include <string>
 
-#include "core/bus/bus.h"
+#include "core/bus/bus_impl.h"
+#include "core/cpu/aot.h"
+#include "core/cpu/code_analysis.h"
 #include "core/cpu/cpu.h"
-#include "core/display/display.h"
-#include "core/graphics/ppu.h"
-#include "core/interrupt/interrupt_controller.h"
-#include "core/joypad/joypad.h"
+#include "core/display/display_impl.h"
+#include "core/graphics/ppu_impl.h"
+#include "core/interrupt/interrupt_controller_impl.h"
+#include "core/joypad/joypad_impl.h"
+#include "core/memory/coverage.h"
 #include "core/memory/mbc.h"
-#include "core/memory/ram.h"
+#include "core/memory/ram_impl.h"
 #include "core/memory/rom.h"
-#include "core/timer/timer.h"
+#include "core/timer/timer_impl.h"
 
 namespace gbeml {
 
+enum class Accuracy {
+  // All components are interleaved every T-cycle.
+  TCycle,
+  // All components are interleaved every M-cycle (4 T-cycles), so the cpu
+  // sees the timer and the ppu as of M-cycle boundaries.
+  MCycle,
+  // The cpu runs an instruction at a time and the other components catch up
+  // after it. The ppu renders whole lines, see
+  // PpuImpl::setScanlineRendering().
+  Instruction,
+};
+
+struct GameBoyOptions {
+  Accuracy accuracy = Accuracy::TCycle;
+  // Materialize cpu flags only when they are read.
+  bool lazy_flags = false;
+  // Look up alu results and flags in precomputed tables.
+  bool alu_tables = false;
+  // Fetch instructions from decoded copies of the code.
+  bool block_cache = false;
+  // Translate hot code to native code where supported (Linux x86-64).
+  bool jit = false;
+  // Check every translated run against the interpreter.
+  bool jit_differential = false;
+  // While the cpu is halted, advance the other components in bulk up to the
+  // next cycle that may signal an interrupt.
+  bool fast_forward_halt = true;
+  // Cpu cycles per cycle of the timer, the ppu and the rest, to give games
+  // that lag more time per frame. 1 is the real speed.
+  u32 cpu_clock_multiplier = 1;
+  // Skip iterations of loops that poll registers or memory for a change, up
+  // to the next cycle where the value may change.
+  bool skip_idle_loops = false;
+  // Record the rom bytes executed and read, see getCoverage().
+  bool coverage = false;
+  // Shared library built from the output of gbeml_recompile for the rom.
+  std::string aot_library;
+  // Find the reachable code of the rom when it is loaded and decode it into
+  // the block cache, if enabled, instead of on first use.
+  bool analyze_rom = false;
+  // An analysis of the rom to use instead of running one, so that instances
+  // of the same rom can share it.
+  std::shared_ptr<const CodeAnalysis> code_analysis;
+};
+
 class GameBoy {
  public:
-  GameBoy(i32 breakpoint_) : breakpoint(breakpoint_) {}
+  explicit GameBoy(GameBoyOptions options_ = {}) : options(options_) {}
   void tick();
+  // Runs all components for an M-cycle and returns 4.
+  u64 tickMCycle();
+  u64 step();
+  // Runs for n T-cycles. Unless the accuracy is TCycle, the last M-cycle or
+  // instruction may run past n, and the excess is deducted from the next
+  // call. Breakpoints, traces and profilers set while it runs take effect
+  // from the next call.
+  void advance(u64 n);
   bool init(const std::string& filename);
   Display* getDisplay() const;
+  Cpu* getCpu() const;
+  Joypad* getJoypad() const;
+  // nullptr unless the coverage option is set.
+  Coverage* getCoverage() const;
+  // nullptr unless the analyze_rom or code_analysis option is set.
+  const CodeAnalysis* getCodeAnalysis() const;
   void press(JoypadButton button);
   void release(JoypadButton button);
 
  private:
-  Display* display;
-  Bus* bus;
+  // The components are held by their final types so that the calls of the
+  // main loop are direct. The interfaces are for the unit tests.
+  DisplayImpl* display;
+  BusImpl* bus;
   Cpu* cpu;
-  Ppu* ppu;
+  PpuImpl* ppu;
   Mbc* mbc;
   Rom* rom;
-  Ram* hram;
-  Ram* wram;
-  Ram* vram;
-  Ram* oam;
-  InterruptController* ic;
-  Timer* timer;
-  Joypad* joypad;
-
-  i32 breakpoint;
+  RamImpl* hram;
+  RamImpl* wram;
+  RamImpl* vram;
+  RamImpl* oam;
+  InterruptControllerImpl* ic;
+  TimerImpl* timer;
+  JoypadImpl* joypad;
+  AotLibrary* aot = nullptr;
+  Coverage* coverage = nullptr;
+
+  GameBoyOptions options;
+  u64 overrun_cycles = 0;
+  // Cpu cycles the other components have yet to catch up on, less than
+  // cpu_clock_multiplier. With T-cycle accuracy, the cycles the cpu has run
+  // in the current cycle of the others.
+  u64 overclock_cycles = 0;
+  // The idle loop, the values it polls and the retired instruction count
+  // when the cpu last started an iteration of it. The values are those at
+  // addrs, then at hl, with the rest zero.
+  using IdleValues = std::array<u8, IdleLoop::kMaxAddrs + 1>;
+  const IdleLoop* idle_loop = nullptr;
+  IdleValues idle_values = {};
+  u64 idle_retired = 0;
+
+  // The loops with the instrumentation of the cpu resolved at compile time.
+  template <bool Instrumented>
+  void tickAs();
+  template <bool Instrumented>
+  u64 tickMCycleAs();
+  template <bool Instrumented>
+  u64 stepAs();
+  template <bool Instrumented>
+  void advanceAs(u64 n);
+
+  // Lower bound on the cpu cycles until the timer or the ppu may signal an
+  // interrupt.
+  u64 getCyclesUntilInterrupt() const;
+  // Each returns the number of cycles skipped, at most limit.
+  u64 skip(u64 limit);
+  u64 fastForward(u64 limit);
+  u64 skipIdleLoop(u64 limit);
 };
 
 }  // namespace gbeml
@@ -0,0 +1,66 @@
+#include "core/gameboy.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+namespace {
+
+// Writes a 32 KiB rom without an mbc that jumps to code at 0x0150.
+std::string writeRom(const std::string& name, const std::vector<u8>& code) {
+  std::vector<u8> data(0x8000);
+  data[0x0100] = 0x00;  // nop
+  data[0x0101] = 0xc3;  // jp $0150
+  data[0x0102] = 0x50;
+  data[0x0103] = 0x01;
+  u8 checksum = 0;
+  for (u16 i = 0x134; i <= 0x14c; ++i) {
+    checksum = checksum - data[i] - 1;
+  }
+  data[0x014d] = checksum;
+  for (u16 i = 0; i < code.size(); ++i) {
+    data[0x0150 + i] = code[i];
+  }
+
+  std::string filename = testing::TempDir() + name;
+  std::ofstream fout(filename, std::ios::binary);
+  fout.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+  return filename;
+}
+
+}  // namespace
+
+TEST(GameBoyTest, oamDmaBlocksFetchesInEveryMode) {
+  // ld a,$c0; ldh ($46),a; 40 x inc b; jr -2. Dma from wram blocks the rom,
+  // so the incs are fetched as the bytes dma transfers, which are nops.
+  std::vector<u8> code = {0x3e, 0xc0, 0xe0, 0x46};
+  code.insert(code.end(), 40, 0x04);
+  code.insert(code.end(), {0x18, 0xfe});
+  std::string filename = writeRom("gameboy_test_dma.gb", code);
+
+  std::vector<GameBoyOptions> modes(3);
+  modes[1].block_cache = true;
+  modes[2].jit = true;
+  for (Accuracy accuracy : {Accuracy::TCycle, Accuracy::Instruction}) {
+    for (GameBoyOptions options : modes) {
+      options.accuracy = accuracy;
+      GameBoy gb(options);
+      ASSERT_TRUE(gb.init(filename));
+      gb.advance(70224);
+      EXPECT_EQ(0, gb.getCpu()->get_b())
+          << "accuracy " << static_cast<int>(accuracy) << ", block cache "
+          << options.block_cache << ", jit " << options.jit;
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+}  // namespace gbeml
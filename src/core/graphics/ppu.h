@@ -1,6 +1,7 @@
 #ifndef GBEML_PPU_H_
 #define GBEML_PPU_H_
 
+#include <functional>
 #include <queue>
 #include <vector>
 
@@ -13,10 +14,23 @@ class Ppu {
   virtual ~Ppu() {}
 
   virtual void tick() = 0;
+  // Equivalent to calling tick() n times.
+  virtual void advance(u64 n) = 0;
+  // Lower bound on the number of tick() calls up to and including the next
+  // one that may signal an interrupt.
+  virtual u64 getCyclesUntilInterrupt() const = 0;
+  // Lower bound on the number of tick() calls up to and including the next
+  // one that may change STAT or LY.
+  virtual u64 getCyclesUntilRegisterChange() const = 0;
   virtual void init() = 0;
 
   virtual u8 readVram(u16 addr) const = 0;
   virtual u8 readOam(u16 addr) const = 0;
+  // Returns vram for direct access while the cpu may access it, or nullptr.
+  virtual u8* getCpuVram() { return nullptr; }
+  // Calls listener whenever what getCpuVram() returns may change.
+  virtual void setAccessListener(
+      [[maybe_unused]] std::function<void()> listener) {}
 
   virtual u8 readLcdc() const = 0;
   virtual u8 readLcdStat() const = 0;
@@ -32,6 +46,9 @@ class Ppu {
 
   virtual void writeVram(u16 addr, u8 value) = 0;
   virtual void writeOam(u16 addr, u8 value) = 0;
+  // Writes the 160 bytes of an oam dma transfer, which the ppu mode does not
+  // block.
+  virtual void writeOamDma(const u8* data) = 0;
 
   virtual void writeLcdc(u8 value) = 0;
   virtual void writeLcdStat(u8 value) = 0;
@@ -1,28 +1,119 @@
 #include "core/graphics/ppu_impl.h"
 
+#include <algorithm>
+#include <array>
+#include <utility>
+
 #include "core/log/logging.h"
 
 namespace gbeml {
 
+void PpuImpl::registerIo(IoTable* io) {
+  io->add(0xff40, [this] { return readLcdc(); },
+          [this](u8 value) { writeLcdc(value); });
+  io->add(0xff41, [this] { return readLcdStat(); },
+          [this](u8 value) { writeLcdStat(value); }, 0x80);
+  io->add(0xff42, [this] { return readScy(); },
+          [this](u8 value) { writeScy(value); });
+  io->add(0xff43, [this] { return readScx(); },
+          [this](u8 value) { writeScx(value); });
+  io->add(0xff44, [this] { return readLy(); },
+          [this](u8 value) { writeLy(value); });
+  io->add(0xff45, [this] { return readLyc(); },
+          [this](u8 value) { writeLyc(value); });
+  io->add(0xff47, [this] { return readBgp(); },
+          [this](u8 value) { writeBgp(value); });
+  io->add(0xff48, [this] { return readObp0(); },
+          [this](u8 value) { writeObp0(value); });
+  io->add(0xff49, [this] { return readObp1(); },
+          [this](u8 value) { writeObp1(value); });
+  io->add(0xff4a, [this] { return readWy(); },
+          [this](u8 value) { writeWy(value); });
+  io->add(0xff4b, [this] { return readWx(); },
+          [this](u8 value) { writeWx(value); });
+}
+
 void PpuImpl::tick() {
   if (!lcdc.isLcdEnabled()) {
     return;
   }
 
+  if (!scanline_rendering) {
+    switch (mode) {
+      case PpuMode::DrawingBackground:
+      case PpuMode::DrawingWindow:
+        draw();
+        break;
+      case PpuMode::OamScan:
+        scanOam();
+        break;
+      case PpuMode::HBlank:
+      case PpuMode::VBlank:
+        break;
+    }
+  }
+
+  moveNext();
+}
+
+void PpuImpl::advance(u64 n) {
+  if (!lcdc.isLcdEnabled()) {
+    return;
+  }
+
+  while (n > 0) {
+    // In HBlank and VBlank nothing but the cycle counter changes until the
+    // end of the line, so those cycles are skipped at once. With scanline
+    // rendering, the same holds until the end of every mode.
+    bool drawing = mode == PpuMode::DrawingBackground ||
+                   mode == PpuMode::DrawingWindow;
+    if (mode == PpuMode::HBlank || (mode == PpuMode::VBlank && ly != 0) ||
+        (scanline_rendering && mode != PpuMode::VBlank)) {
+      u64 end = 456;
+      if (scanline_rendering && mode == PpuMode::OamScan) {
+        end = 80;
+      } else if (scanline_rendering && drawing) {
+        end = 252;
+      }
+      u64 idle = std::min<u64>(n, end - 1 - cycles % 456);
+      cycles += idle;
+      n -= idle;
+      if (n == 0) {
+        break;
+      }
+    }
+    PpuImpl::tick();
+    n--;
+  }
+}
+
+u64 PpuImpl::getCyclesUntilInterrupt() const {
+  if (!lcdc.isLcdEnabled()) {
+    return UINT64_MAX;
+  }
+  // Interrupts are only signaled when a line starts, and during VBlank only
+  // when the next frame starts.
+  if (mode == PpuMode::VBlank) {
+    return 456 * 154 - cycles;
+  }
+  return 456 - cycles % 456;
+}
+
+u64 PpuImpl::getCyclesUntilRegisterChange() const {
+  if (!lcdc.isLcdEnabled()) {
+    return UINT64_MAX;
+  }
   switch (mode) {
-    case PpuMode::DrawingBackground:
-    case PpuMode::DrawingWindow:
-      draw();
-      break;
-    case PpuMode::OamScan:
-      scanOam();
-      break;
     case PpuMode::HBlank:
     case PpuMode::VBlank:
-      break;
+      return 456 - cycles % 456;
+    case PpuMode::OamScan:
+      return 80 - cycles % 456;
+    default:
+      // Drawing ends after a variable number of cycles, unless lines are
+      // rendered at once.
+      return scanline_rendering ? 252 - cycles % 456 : 1;
   }
-
-  moveNext();
 }
 
 void PpuImpl::moveNext() {
@@ -37,10 +128,20 @@ void PpuImpl::moveNext() {
   switch (mode) {
     case PpuMode::OamScan:
       if (cycles % 456 == 80) {
-        enterDrawingBackground();
+        if (scanline_rendering) {
+          enterDrawingLine();
+        } else {
+          enterDrawingBackground();
+        }
       }
       break;
     case PpuMode::DrawingBackground:
+      if (scanline_rendering) {
+        if (cycles % 456 == 252) {
+          enterHBlank();
+        }
+        break;
+      }
       if (shifter_x == 160) {
         enterHBlank();
         break;
@@ -228,6 +329,7 @@ void PpuImpl::init() {
 
 void PpuImpl::enterOamScan() {
   mode = PpuMode::OamScan;
+  updateAccess();
   stalls = 0;
   if (lcd_stat.isOamScanInterruptEnabled()) {
     ic->signalLcdStat();
@@ -243,6 +345,7 @@ void PpuImpl::enterOamScan() {
 
 void PpuImpl::enterDrawingBackground() {
   mode = PpuMode::DrawingBackground;
+  updateAccess();
   stalls = 12;
   shifter_x = 0;
   pixel_fetcher.reset();
@@ -252,6 +355,7 @@ void PpuImpl::enterDrawingBackground() {
 
 void PpuImpl::enterHBlank() {
   mode = PpuMode::HBlank;
+  updateAccess();
   while (background_fifo.size() > 0) {
     background_fifo.pop();
   }
@@ -263,6 +367,7 @@ void PpuImpl::enterHBlank() {
 
 void PpuImpl::enterVBlank() {
   mode = PpuMode::VBlank;
+  updateAccess();
   ic->signalVBlank();
   if (lcd_stat.isVBlankInterruptEnabled()) {
     ic->signalLcdStat();
@@ -290,6 +395,80 @@ void PpuImpl::enterDrawingWindow() {
   stalls += 6;
 }
 
+void PpuImpl::enterDrawingLine() {
+  mode = PpuMode::DrawingBackground;
+  updateAccess();
+  stalls = 0;
+  while (oam_counter < 160 && sprite_buffer.size() < 10) {
+    scanOam();
+  }
+  stalls = 0;
+  renderLine();
+}
+
+void PpuImpl::renderLine() {
+  // Sprites are fetched as the pixel fifo reaches them, and pixels already in
+  // the sprite fifo take priority over the ones fetched later.
+  std::vector<SpritePixel> sprite_pixels(160,
+                                         SpritePixel(Color::Transparent, true));
+  std::array<bool, 160> has_sprite = {};
+  for (u8 x = 0; x < 160 && !sprite_buffer.empty(); ++x) {
+    shifter_x = x;
+    initiateSpriteFetch();
+    if (visible_sprites.empty()) {
+      continue;
+    }
+    std::vector<SpritePixel> pixels =
+        pixel_fetcher.fetchSpritePixels(x, ly, visible_sprites);
+    visible_sprites.clear();
+    for (u8 i = 0; i < 8 && x + i < 160; ++i) {
+      if (!has_sprite[x + i]) {
+        has_sprite[x + i] = true;
+        sprite_pixels[x + i] = pixels[i];
+      }
+    }
+  }
+
+  std::array<Color, 160> line;
+  bool window = lcdc.isWindowEnabled() && is_window_visible_vertically &&
+                wx < 167;
+  i16 window_x = window ? wx - 7 : 160;
+  u8 fine_x = scx % 8;
+  pixel_fetcher.reset();
+  for (i16 x = -fine_x; x < std::min<i16>(window_x, 160); x += 8) {
+    Tile tile = pixel_fetcher.fetchBackgroundPixels(scx, scy, ly);
+    for (i16 i = 0; i < 8; ++i) {
+      if (x + i >= 0 && x + i < std::min<i16>(window_x, 160)) {
+        line[x + i] = tile.getAt(i);
+      }
+    }
+  }
+  if (window) {
+    window_line_counter++;
+    pixel_fetcher.reset();
+    for (i16 x = window_x; x < 160; x += 8) {
+      Tile tile = pixel_fetcher.fetchWindowPixels(window_line_counter - 1);
+      for (i16 i = 0; i < 8; ++i) {
+        if (x + i >= 0 && x + i < 160) {
+          line[x + i] = tile.getAt(i);
+        }
+      }
+    }
+  }
+
+  for (u8 x = 0; x < 160; ++x) {
+    Color color = lcdc.isBackgroundEnabled() ? line[x] : Color::White;
+    const SpritePixel& sprite_pixel = sprite_pixels[x];
+    if (sprite_pixel.getColor() != Color::Transparent &&
+        (!sprite_pixel.isBackgroundOverSprite() || color == Color::White) &&
+        lcdc.isSpriteEnabled()) {
+      color = sprite_pixel.getColor();
+    }
+    display->render(x, ly, color);
+  }
+  shifter_x = 160;
+}
+
 u8 PpuImpl::readVram(u16 addr) const {
   if (!lcdc.isLcdEnabled()) {
     return vram->read(addr);
@@ -306,6 +485,30 @@ u8 PpuImpl::readVram(u16 addr) const {
   }
 }
 
+u8* PpuImpl::getCpuVram() {
+  return isVramAccessible() ? vram->getData() : nullptr;
+}
+
+void PpuImpl::setAccessListener(std::function<void()> listener) {
+  access_listener = std::move(listener);
+  vram_accessible = isVramAccessible();
+}
+
+bool PpuImpl::isVramAccessible() const {
+  return !lcdc.isLcdEnabled() || (mode != PpuMode::DrawingBackground &&
+                                  mode != PpuMode::DrawingWindow);
+}
+
+void PpuImpl::updateAccess() {
+  bool accessible = isVramAccessible();
+  if (accessible != vram_accessible) {
+    vram_accessible = accessible;
+    if (access_listener) {
+      access_listener();
+    }
+  }
+}
+
 u8 PpuImpl::readOam(u16 addr) const {
   if (!lcdc.isLcdEnabled()) {
     return oam->read(addr);
@@ -399,7 +602,21 @@ void PpuImpl::writeOam(u16 addr, u8 value) {
   }
 }
 
-void PpuImpl::writeLcdc(u8 value) { lcdc.write(value); }
+void PpuImpl::writeOamDma(const u8* data) {
+  u8* dst = oam->getData();
+  if (dst != nullptr) {
+    std::copy(data, data + 160, dst);
+    return;
+  }
+  for (u16 addr = 0; addr < 160; ++addr) {
+    oam->write(addr, data[addr]);
+  }
+}
+
+void PpuImpl::writeLcdc(u8 value) {
+  lcdc.write(value);
+  updateAccess();
+}
 
 void PpuImpl::writeLcdStat(u8 value) { lcd_stat.write(value); }
 
@@ -423,4 +640,8 @@ void PpuImpl::writeObp1(u8 value) { obp1.write(value); }
 
 PpuMode PpuImpl::getMode() { return mode; }
 
+void PpuImpl::setScanlineRendering(bool enabled) {
+  scanline_rendering = enabled;
+}
+
 }  // namespace gbeml
@@ -1,9 +1,11 @@
 #ifndef GBEML_PPU_IMPL_H_
 #define GBEML_PPU_IMPL_H_
 
+#include <functional>
 #include <queue>
 #include <vector>
 
+#include "core/bus/io_table.h"
 #include "core/display/display.h"
 #include "core/graphics/color.h"
 #include "core/graphics/fetcher.h"
@@ -27,7 +29,7 @@ enum class PpuMode {
   DrawingWindow
 };
 
-class PpuImpl : public Ppu {
+class PpuImpl final : public Ppu {
  public:
   PpuImpl(Display* display_, Ram* vram_, Ram* oam_, InterruptController* ic_)
       : display(display_),
@@ -42,10 +44,15 @@ class PpuImpl : public Ppu {
         pixel_fetcher(*vram, lcdc, bgp, obp0, obp1) {}
 
   void tick() override;
+  void advance(u64 n) override;
+  u64 getCyclesUntilInterrupt() const override;
+  u64 getCyclesUntilRegisterChange() const override;
   void init() override;
 
   u8 readVram(u16 addr) const override;
   u8 readOam(u16 addr) const override;
+  u8* getCpuVram() override;
+  void setAccessListener(std::function<void()> listener) override;
 
   u8 readLcdc() const override;
   u8 readLcdStat() const override;
@@ -61,6 +68,7 @@ class PpuImpl : public Ppu {
 
   void writeVram(u16 addr, u8 value) override;
   void writeOam(u16 addr, u8 value) override;
+  void writeOamDma(const u8* data) override;
 
   void writeLcdc(u8 value) override;
   void writeLcdStat(u8 value) override;
@@ -74,7 +82,14 @@ class PpuImpl : public Ppu {
   void writeObp0(u8 value) override;
   void writeObp1(u8 value) override;
 
+  // Adds the lcd registers but DMA.
+  void registerIo(IoTable* io);
+
   PpuMode getMode();
+  // Renders each line at once when drawing starts, instead of a pixel per
+  // cycle, and gives OAM scan and drawing fixed lengths of 80 and 172 cycles.
+  // Register writes during a line take effect on the next line.
+  void setScanlineRendering(bool enabled);
 
  private:
   Display* display;
@@ -112,6 +127,10 @@ class PpuImpl : public Ppu {
   u8 num_unused_pixels = 0;
   u64 cycles = 0;
   bool is_window_visible_vertically = false;
+  bool scanline_rendering = false;
+  std::function<void()> access_listener;
+  // Whether the cpu could access vram when access_listener was last called.
+  bool vram_accessible = true;
 
   void draw();
   void fetchBackgroundPixels();
@@ -129,6 +148,11 @@ class PpuImpl : public Ppu {
   void enterVBlank();
   void enterDrawingBackground();
   void enterDrawingWindow();
+  void enterDrawingLine();
+  bool isVramAccessible() const;
+  // Calls access_listener if the cpu gained or lost access to vram.
+  void updateAccess();
+  void renderLine();
 };
 
 }  // namespace gbeml
@@ -7,6 +7,7 @@
 #include "core/graphics/color.h"
 #include "core/interrupt/interrupt_controller_impl.h"
 #include "core/memory/ram.h"
+#include "core/memory/ram_impl.h"
 #include "core/types/types.h"
 
 namespace gbeml {
@@ -29,6 +30,16 @@ class MockOam : public Ram {
   MOCK_CONST_METHOD1(read, u8(u16 addr));
 };
 
+class FakeDisplay : public Display {
+ public:
+  void render(u8 x, u8 y, Color pixel) override {
+    pixels[y * 160 + x] = pixel;
+  }
+  u32* getBuffer() override { return nullptr; }
+
+  std::vector<Color> pixels = std::vector<Color>(160 * 144, Color::Transparent);
+};
+
 TEST(PpuTest, moveNext) {
   MockDisplay display;
   MockVRam vram;
@@ -173,4 +184,152 @@ TEST(PpuTest, drawSprite) {
   ppu.tick();
 }
 
+TEST(PpuTest, advance_matchesTick) {
+  MockDisplay display;
+  MockVRam vram;
+  MockOam oam;
+  InterruptControllerImpl ticked_ic;
+  InterruptControllerImpl advanced_ic;
+  PpuImpl ticked(&display, &vram, &oam, &ticked_ic);
+  PpuImpl advanced(&display, &vram, &oam, &advanced_ic);
+
+  EXPECT_CALL(display, render(testing::_, testing::_, testing::_))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(vram, read(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(oam, read(testing::_)).Times(testing::AnyNumber());
+
+  for (PpuImpl* ppu : {&ticked, &advanced}) {
+    ppu->writeLy(0);
+    ppu->writeLcdc(0b10000001);
+    ppu->writeLcdStat(0b01111000);
+    ppu->init();
+  }
+
+  for (u64 i = 0; i < 2 * 456 * 154;) {
+    u64 n = 1 + i % 23;
+    for (u64 j = 0; j < n; ++j) {
+      ticked.tick();
+    }
+    advanced.advance(n);
+    i += n;
+
+    ASSERT_EQ(ticked.getMode(), advanced.getMode());
+    ASSERT_EQ(ticked.readLy(), advanced.readLy());
+    ASSERT_EQ(ticked_ic.readInterruptFlag(), advanced_ic.readInterruptFlag());
+  }
+}
+
+TEST(PpuTest, scanlineRendering_matchesFifo) {
+  RamImpl vram(8 * 1024);
+  RamImpl oam(160);
+  u32 seed = 1;
+  for (u16 i = 0; i < 8 * 1024; ++i) {
+    seed = seed * 1103515245 + 12345;
+    vram.write(i, seed >> 16);
+  }
+  // Overlapping sprites, some clipped at the left and top edges.
+  for (u16 i = 0; i < 40; ++i) {
+    oam.write(4 * i, 8 + 13 * i % 150);
+    oam.write(4 * i + 1, 5 * i % 170);
+    oam.write(4 * i + 2, 7 * i);
+    oam.write(4 * i + 3, (i % 4) << 5 | (i % 3 == 0 ? 0x80 : 0) | (i & 0x10));
+  }
+
+  for (u8 wx : {0, 3, 7, 50, 166, 167}) {
+    for (u8 lcdc : {0b11110011, 0b11010111, 0b10100010}) {
+      FakeDisplay fifo_display;
+      FakeDisplay scanline_display;
+      InterruptControllerImpl fifo_ic;
+      InterruptControllerImpl scanline_ic;
+      PpuImpl fifo(&fifo_display, &vram, &oam, &fifo_ic);
+      PpuImpl scanline(&scanline_display, &vram, &oam, &scanline_ic);
+      scanline.setScanlineRendering(true);
+      for (PpuImpl* ppu : {&fifo, &scanline}) {
+        ppu->writeLy(0);
+        ppu->writeLcdc(lcdc);
+        ppu->writeScx(13);
+        ppu->writeScy(250);
+        ppu->writeWx(wx);
+        ppu->writeWy(20);
+        ppu->writeBgp(0b11100100);
+        ppu->writeObp0(0b00011011);
+        ppu->writeObp1(0b11100100);
+        ppu->init();
+      }
+
+      for (u64 i = 0; i < 2 * 456 * 154; ++i) {
+        fifo.tick();
+        scanline.tick();
+        ASSERT_EQ(fifo.readLy(), scanline.readLy());
+      }
+      ASSERT_EQ(fifo_display.pixels, scanline_display.pixels)
+          << "wx=" << int(wx) << " lcdc=" << int(lcdc);
+    }
+  }
+}
+
+TEST(PpuTest, scanlineRendering_advanceMatchesTick) {
+  RamImpl vram(8 * 1024);
+  RamImpl oam(160);
+  FakeDisplay display;
+  InterruptControllerImpl ticked_ic;
+  InterruptControllerImpl advanced_ic;
+  PpuImpl ticked(&display, &vram, &oam, &ticked_ic);
+  PpuImpl advanced(&display, &vram, &oam, &advanced_ic);
+
+  for (PpuImpl* ppu : {&ticked, &advanced}) {
+    ppu->setScanlineRendering(true);
+    ppu->writeLy(0);
+    ppu->writeLcdc(0b10000001);
+    ppu->writeLcdStat(0b01111000);
+    ppu->init();
+  }
+
+  for (u64 i = 0; i < 2 * 456 * 154;) {
+    u64 n = 1 + i % 23;
+    for (u64 j = 0; j < n; ++j) {
+      ticked.tick();
+    }
+    advanced.advance(n);
+    i += n;
+
+    ASSERT_EQ(ticked.getMode(), advanced.getMode());
+    ASSERT_EQ(ticked.readLy(), advanced.readLy());
+    ASSERT_EQ(ticked_ic.readInterruptFlag(), advanced_ic.readInterruptFlag());
+    if (ticked.getMode() == PpuMode::DrawingBackground) {
+      ASSERT_EQ(252 - i % 456, ticked.getCyclesUntilRegisterChange());
+    }
+  }
+}
+
+TEST(PpuTest, getCyclesUntilInterrupt) {
+  MockDisplay display;
+  MockVRam vram;
+  MockOam oam;
+  InterruptControllerImpl ic;
+  PpuImpl ppu(&display, &vram, &oam, &ic);
+
+  EXPECT_CALL(display, render(testing::_, testing::_, testing::_))
+      .Times(testing::AnyNumber());
+  EXPECT_CALL(vram, read(testing::_)).Times(testing::AnyNumber());
+  EXPECT_CALL(oam, read(testing::_)).Times(testing::AnyNumber());
+
+  ppu.writeLy(0);
+  ppu.writeLyc(100);
+  ppu.writeLcdc(0b10000001);
+  ppu.writeLcdStat(0b01111000);
+  ppu.init();
+
+  for (u64 i = 0; i < 2 * 456 * 154;) {
+    u64 n = ppu.getCyclesUntilInterrupt();
+    ic.writeInterruptFlag(0);
+    for (u64 j = 1; j < n; ++j) {
+      ppu.tick();
+      ASSERT_EQ(0, ic.readInterruptFlag() & 0b00011) << i + j;
+    }
+    ppu.tick();
+    i += n;
+  }
+}
+
 }  // namespace gbeml
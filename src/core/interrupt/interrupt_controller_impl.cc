@@ -2,12 +2,18 @@
 
 namespace gbeml {
 
+void InterruptControllerImpl::registerIo(IoTable* io) {
+  io->add(0xff0f, [this] { return readInterruptFlag(); },
+          [this](u8 value) { writeInterruptFlag(value); }, 0xe0);
+}
+
 u8 InterruptControllerImpl::readInterruptFlag() const {
   return interrupt_flag.get();
 }
 
 void InterruptControllerImpl::writeInterruptFlag(u8 value) {
   interrupt_flag.set(value);
+  updatePending();
 }
 
 u8 InterruptControllerImpl::readInterruptEnable() const {
@@ -16,51 +22,85 @@ u8 InterruptControllerImpl::readInterruptEnable() const {
 
 void InterruptControllerImpl::writeInterruptEnable(u8 value) {
   interrupt_enable.set(value);
+  updatePending();
 }
 
-void InterruptControllerImpl::signalVBlank() { interrupt_flag.setAt(0, true); }
+void InterruptControllerImpl::signalVBlank() {
+  interrupt_flag.setAt(0, true);
+  updatePending();
+}
 
-void InterruptControllerImpl::signalLcdStat() { interrupt_flag.setAt(1, true); }
+void InterruptControllerImpl::signalLcdStat() {
+  interrupt_flag.setAt(1, true);
+  updatePending();
+}
 
-void InterruptControllerImpl::signalTimer() { interrupt_flag.setAt(2, true); }
+void InterruptControllerImpl::signalTimer() {
+  interrupt_flag.setAt(2, true);
+  updatePending();
+}
 
-void InterruptControllerImpl::signalSerial() { interrupt_flag.setAt(3, true); }
+void InterruptControllerImpl::signalSerial() {
+  interrupt_flag.setAt(3, true);
+  updatePending();
+}
 
-void InterruptControllerImpl::signalJoypad() { interrupt_flag.setAt(4, true); }
+void InterruptControllerImpl::signalJoypad() {
+  interrupt_flag.setAt(4, true);
+  updatePending();
+}
 
-void InterruptControllerImpl::clearVBlank() { interrupt_flag.setAt(0, false); }
+void InterruptControllerImpl::clearVBlank() {
+  interrupt_flag.setAt(0, false);
+  updatePending();
+}
 
-void InterruptControllerImpl::clearLcdStat() { interrupt_flag.setAt(1, false); }
+void InterruptControllerImpl::clearLcdStat() {
+  interrupt_flag.setAt(1, false);
+  updatePending();
+}
 
-void InterruptControllerImpl::clearTimer() { interrupt_flag.setAt(2, false); }
+void InterruptControllerImpl::clearTimer() {
+  interrupt_flag.setAt(2, false);
+  updatePending();
+}
 
-void InterruptControllerImpl::clearSerial() { interrupt_flag.setAt(3, false); }
+void InterruptControllerImpl::clearSerial() {
+  interrupt_flag.setAt(3, false);
+  updatePending();
+}
 
-void InterruptControllerImpl::clearJoypad() { interrupt_flag.setAt(4, false); }
+void InterruptControllerImpl::clearJoypad() {
+  interrupt_flag.setAt(4, false);
+  updatePending();
+}
 
 bool InterruptControllerImpl::isVBlankRequested() {
-  return interrupt_flag.getAt(0) && interrupt_enable.getAt(0);
+  return pending >> 0 & 1;
 }
 
 bool InterruptControllerImpl::isLcdStatRequested() {
-  return interrupt_flag.getAt(1) && interrupt_enable.getAt(1);
+  return pending >> 1 & 1;
 }
 
 bool InterruptControllerImpl::isTimerRequested() {
-  return interrupt_flag.getAt(2) && interrupt_enable.getAt(2);
+  return pending >> 2 & 1;
 }
 
 bool InterruptControllerImpl::isSerialRequested() {
-  return interrupt_flag.getAt(3) && interrupt_enable.getAt(3);
+  return pending >> 3 & 1;
 }
 
 bool InterruptControllerImpl::isJoypadRequested() {
-  return interrupt_flag.getAt(4) && interrupt_enable.getAt(4);
+  return pending >> 4 & 1;
 }
 
 bool InterruptControllerImpl::isInterruptRequested() {
-  return isVBlankRequested() || isLcdStatRequested() || isTimerRequested() ||
-         isSerialRequested() || isJoypadRequested();
+  return pending != 0;
+}
+
+void InterruptControllerImpl::updatePending() {
+  pending = interrupt_flag.get() & interrupt_enable.get() & 0x1f;
 }
 
 }  // namespace gbeml
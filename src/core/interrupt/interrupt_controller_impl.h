@@ -1,17 +1,20 @@
 #ifndef GBEML_INTERRUPT_CONTROLLER_IMPL_H_
 #define GBEML_INTERRUPT_CONTROLLER_IMPL_H_
 
+#include "core/bus/io_table.h"
 #include "core/interrupt/interrupt_controller.h"
 #include "core/register/register.h"
 #include "core/types/types.h"
 
 namespace gbeml {
 
-class InterruptControllerImpl : public InterruptController {
+class InterruptControllerImpl final : public InterruptController {
  public:
   InterruptControllerImpl() : interrupt_flag(), interrupt_enable() {}
   InterruptControllerImpl(u8 interrupt_flag_, u8 interrupt_enable_)
-      : interrupt_flag(interrupt_flag_), interrupt_enable(interrupt_enable_) {}
+      : interrupt_flag(interrupt_flag_), interrupt_enable(interrupt_enable_) {
+    updatePending();
+  }
 
   virtual u8 readInterruptFlag() const override;
   virtual void writeInterruptFlag(u8 value) override;
@@ -19,6 +22,9 @@ class InterruptControllerImpl : public InterruptController {
   virtual u8 readInterruptEnable() const override;
   virtual void writeInterruptEnable(u8 value) override;
 
+  // Adds IF. IE at 0xffff is outside the io block.
+  void registerIo(IoTable* io);
+
   virtual void signalVBlank() override;
   virtual void signalLcdStat() override;
   virtual void signalTimer() override;
@@ -39,9 +45,16 @@ class InterruptControllerImpl : public InterruptController {
 
   virtual bool isInterruptRequested() override;
 
+  // IF & IE & 0x1f, kept up to date so that the cpu can check it on every
+  // cycle. Bit 0 (VBlank) has the highest priority.
+  u8 getPendingInterrupts() const { return pending; }
+
  private:
   Register interrupt_flag;
   Register interrupt_enable;
+  u8 pending = 0;
+
+  void updatePending();
 };
 
 }  // namespace gbeml
@@ -65,4 +65,21 @@ TEST(InterruptControllerImplTest, isJoypadRequested) {
   EXPECT_EQ(true, ic.isJoypadRequested());
 }
 
+TEST(InterruptControllerImplTest, getPendingInterrupts) {
+  InterruptControllerImpl ic(0xe1, 0x00);
+  EXPECT_EQ(0x00, ic.getPendingInterrupts());
+
+  ic.writeInterruptEnable(0xff);
+  EXPECT_EQ(0x01, ic.getPendingInterrupts());
+  ic.signalTimer();
+  EXPECT_EQ(0x05, ic.getPendingInterrupts());
+  ic.clearVBlank();
+  EXPECT_EQ(0x04, ic.getPendingInterrupts());
+  ic.writeInterruptEnable(0x03);
+  EXPECT_EQ(0x00, ic.getPendingInterrupts());
+  ic.writeInterruptFlag(0xff);
+  EXPECT_EQ(0x03, ic.getPendingInterrupts());
+  EXPECT_TRUE(ic.isInterruptRequested());
+}
+
 }  // namespace gbeml
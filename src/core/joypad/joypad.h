@@ -20,6 +20,10 @@ class Joypad {
 
   virtual void press(JoypadButton button) = 0;
   virtual void release(JoypadButton button) = 0;
+
+  // Number of writes selecting the buttons to read. Games make them when
+  // they poll the joypad, so a frame without any is a lag frame.
+  virtual u64 getPollCount() const = 0;
 };
 
 }  // namespace gbeml
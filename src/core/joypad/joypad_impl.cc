@@ -2,6 +2,11 @@
 
 namespace gbeml {
 
+void JoypadImpl::registerIo(IoTable* io) {
+  io->add(0xff00, [this] { return read(); },
+          [this](u8 value) { write(value); }, 0xc0);
+}
+
 u8 JoypadImpl::read() const {
   switch (mode) {
     case JoypadMode::Action:
@@ -12,6 +17,7 @@ u8 JoypadImpl::read() const {
 }
 
 void JoypadImpl::write(u8 value) {
+  polls++;
   if ((value & 0b00100000) == 0) {
     mode = JoypadMode::Action;
   } else {
@@ -19,6 +25,8 @@ void JoypadImpl::write(u8 value) {
   }
 }
 
+u64 JoypadImpl::getPollCount() const { return polls; }
+
 void JoypadImpl::press(JoypadButton button) {
   switch (button) {
     case JoypadButton::Start:
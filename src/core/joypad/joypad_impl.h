@@ -1,11 +1,12 @@
 #ifndef GBEML_JOYPAD_IMPL_H_
 #define GBEML_JOYPAD_IMPL_H_
 
+#include "core/bus/io_table.h"
 #include "core/joypad/joypad.h"
 
 namespace gbeml {
 
-class JoypadImpl : public Joypad {
+class JoypadImpl final : public Joypad {
  public:
   JoypadImpl(InterruptController* ic_)
       : ic(ic_), action(0xff), direction(0xff), mode(JoypadMode::Action){};
@@ -16,11 +17,17 @@ class JoypadImpl : public Joypad {
   void press(JoypadButton button);
   void release(JoypadButton button);
 
+  u64 getPollCount() const;
+
+  // Adds P1.
+  void registerIo(IoTable* io);
+
  private:
   InterruptController* ic;
   Register action;
   Register direction;
   JoypadMode mode;
+  u64 polls = 0;
 };
 
 }  // namespace gbeml
@@ -3,6 +3,7 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include "core/bus/io_table.h"
 #include "core/interrupt/interrupt_controller.h"
 #include "core/joypad/joypad.h"
 
@@ -94,4 +95,30 @@ TEST(JoypadImplTest, pressDirection) {
   EXPECT_EQ(0b11101111, joypad_impl.read());
 }
 
+TEST(JoypadImplTest, getPollCount) {
+  MockInterruptController ic;
+  JoypadImpl joypad_impl(&ic);
+
+  EXPECT_EQ(0, joypad_impl.getPollCount());
+  joypad_impl.write(0b00100000);
+  joypad_impl.read();
+  joypad_impl.write(0b00010000);
+  joypad_impl.read();
+  EXPECT_EQ(2, joypad_impl.getPollCount());
+}
+
+TEST(JoypadImplTest, registerIo) {
+  MockInterruptController ic;
+  EXPECT_CALL(ic, signalJoypad()).Times(testing::AnyNumber());
+
+  JoypadImpl joypad_impl(&ic);
+  IoTable io;
+  joypad_impl.registerIo(&io);
+
+  io.write(0xff00, 0b00100000);
+  joypad_impl.press(JoypadButton::Down);
+  EXPECT_EQ(0b11100111, io.read(0xff00));
+  EXPECT_EQ(1, joypad_impl.getPollCount());
+}
+
 }  // namespace gbeml
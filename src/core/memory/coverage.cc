@@ -0,0 +1,110 @@
+#include "core/memory/coverage.h"
+
+#include <bit>
+#include <cstring>
+#include <fstream>
+
+namespace gbeml {
+
+namespace {
+
+struct CoverageHeader {
+  char magic[4];
+  u32 version;
+  u32 rom_size;
+  u32 unused;
+};
+
+u32 count(const std::vector<u64>& bits) {
+  u32 n = 0;
+  for (u64 word : bits) {
+    n += std::popcount(word);
+  }
+  return n;
+}
+
+template <typename Covered>
+void writeRanges(std::ostream& os, u32 rom_size, Covered covered) {
+  os << "[";
+  bool first = true;
+  for (u32 i = 0; i < rom_size;) {
+    if (!covered(i)) {
+      i++;
+      continue;
+    }
+    u32 start = i;
+    while (i < rom_size && covered(i)) {
+      i++;
+    }
+    os << (first ? "" : ", ") << "[" << start << ", " << i - 1 << "]";
+    first = false;
+  }
+  os << "]";
+}
+
+}  // namespace
+
+Coverage::Coverage(u32 rom_size_)
+    : rom_size(rom_size_),
+      executed((rom_size_ + 63) / 64),
+      read((rom_size_ + 63) / 64) {}
+
+u32 Coverage::getExecutedCount() const { return count(executed); }
+
+u32 Coverage::getReadCount() const { return count(read); }
+
+bool Coverage::merge(const Coverage& other) {
+  if (other.rom_size != rom_size) {
+    return false;
+  }
+  for (std::size_t i = 0; i < executed.size(); ++i) {
+    executed[i] |= other.executed[i];
+    read[i] |= other.read[i];
+  }
+  return true;
+}
+
+bool Coverage::save(const std::string& filename) const {
+  std::ofstream fout(filename, std::ios::binary);
+  CoverageHeader header = {};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.rom_size = rom_size;
+  fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  fout.write(reinterpret_cast<const char*>(executed.data()),
+             executed.size() * sizeof(u64));
+  fout.write(reinterpret_cast<const char*>(read.data()),
+             read.size() * sizeof(u64));
+  return static_cast<bool>(fout);
+}
+
+bool Coverage::load(const std::string& filename, Coverage* coverage) {
+  std::ifstream fin(filename, std::ios::binary);
+  CoverageHeader header;
+  if (!fin.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion) {
+    return false;
+  }
+  *coverage = Coverage(header.rom_size);
+  fin.read(reinterpret_cast<char*>(coverage->executed.data()),
+           coverage->executed.size() * sizeof(u64));
+  fin.read(reinterpret_cast<char*>(coverage->read.data()),
+           coverage->read.size() * sizeof(u64));
+  return static_cast<bool>(fin);
+}
+
+void Coverage::writeJson(std::ostream& os) const {
+  os << "{\"rom_size\": " << rom_size
+     << ", \"executed_count\": " << getExecutedCount()
+     << ", \"read_count\": " << getReadCount() << ",\n \"executed\": ";
+  writeRanges(os, rom_size, [this](u32 i) { return isExecuted(i); });
+  os << ",\n \"read\": ";
+  writeRanges(os, rom_size, [this](u32 i) { return isRead(i); });
+  os << ",\n \"data\": ";
+  writeRanges(os, rom_size,
+              [this](u32 i) { return isRead(i) && !isExecuted(i); });
+  os << "}\n";
+}
+
+}  // namespace gbeml
@@ -0,0 +1,63 @@
+#ifndef GBEML_COVERAGE_H_
+#define GBEML_COVERAGE_H_
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "core/types/types.h"
+
+namespace gbeml {
+
+// Bitmaps of the rom bytes executed and read, indexed by offset in the rom
+// file, so that bank n covers [0x4000 * n, 0x4000 * (n + 1)). Reads include
+// instruction fetches that go through the bus rather than the block cache.
+class Coverage {
+ public:
+  static constexpr char kMagic[4] = {'G', 'B', 'C', 'V'};
+  static constexpr u32 kVersion = 1;
+
+  explicit Coverage(u32 rom_size);
+
+  static u32 getRomAddress(u32 bank, u16 addr) {
+    return 0x4000 * bank + (addr & 0x3fff);
+  }
+
+  void markExecuted(u32 rom_addr) { mark(&executed, rom_addr); }
+  void markRead(u32 rom_addr) { mark(&read, rom_addr); }
+  bool isExecuted(u32 rom_addr) const { return test(executed, rom_addr); }
+  bool isRead(u32 rom_addr) const { return test(read, rom_addr); }
+
+  u32 getRomSize() const { return rom_size; }
+  u32 getExecutedCount() const;
+  u32 getReadCount() const;
+
+  // Adds the bytes covered in other, which must be for a rom of the same
+  // size.
+  bool merge(const Coverage& other);
+
+  bool save(const std::string& filename) const;
+  static bool load(const std::string& filename, Coverage* coverage);
+  // Writes the sizes, the counts and the covered ranges as
+  // {"executed": [[first, last], ...], ...}. "data" is the bytes read but
+  // never executed.
+  void writeJson(std::ostream& os) const;
+
+ private:
+  u32 rom_size;
+  std::vector<u64> executed;
+  std::vector<u64> read;
+
+  static void mark(std::vector<u64>* bits, u32 i) {
+    if (i / 64 < bits->size()) {
+      (*bits)[i / 64] |= u64{1} << (i % 64);
+    }
+  }
+  static bool test(const std::vector<u64>& bits, u32 i) {
+    return i / 64 < bits.size() && (bits[i / 64] >> (i % 64) & 1);
+  }
+};
+
+}  // namespace gbeml
+
+#endif  // GBEML_COVERAGE_H_
@@ -0,0 +1,76 @@
+#include "core/memory/coverage.h"
+
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <sstream>
+#include <string>
+
+namespace gbeml {
+
+TEST(CoverageTest, mark) {
+  Coverage coverage(0x8000);
+  coverage.markExecuted(Coverage::getRomAddress(1, 0x4010));
+  coverage.markRead(Coverage::getRomAddress(0, 0x0150));
+  coverage.markRead(0x8000);
+
+  EXPECT_TRUE(coverage.isExecuted(0x4010));
+  EXPECT_FALSE(coverage.isExecuted(0x0010));
+  EXPECT_TRUE(coverage.isRead(0x0150));
+  EXPECT_FALSE(coverage.isRead(0x8000));
+  EXPECT_EQ(1, coverage.getExecutedCount());
+  EXPECT_EQ(1, coverage.getReadCount());
+}
+
+TEST(CoverageTest, merge) {
+  Coverage a(0x8000);
+  Coverage b(0x8000);
+  a.markExecuted(1);
+  b.markExecuted(2);
+  b.markRead(3);
+  EXPECT_TRUE(a.merge(b));
+  EXPECT_TRUE(a.isExecuted(1));
+  EXPECT_TRUE(a.isExecuted(2));
+  EXPECT_TRUE(a.isRead(3));
+
+  Coverage c(0x10000);
+  EXPECT_FALSE(a.merge(c));
+}
+
+TEST(CoverageTest, saveAndLoad) {
+  Coverage coverage(0x8000);
+  coverage.markExecuted(0x7fff);
+  coverage.markRead(0x100);
+  std::string filename = testing::TempDir() + "coverage_test.cov";
+  ASSERT_TRUE(coverage.save(filename));
+
+  Coverage loaded(0);
+  ASSERT_TRUE(Coverage::load(filename, &loaded));
+  std::remove(filename.c_str());
+  EXPECT_EQ(0x8000, loaded.getRomSize());
+  EXPECT_TRUE(loaded.isExecuted(0x7fff));
+  EXPECT_TRUE(loaded.isRead(0x100));
+  EXPECT_EQ(1, loaded.getExecutedCount());
+  EXPECT_FALSE(Coverage::load(filename, &loaded));
+}
+
+TEST(CoverageTest, writeJson) {
+  Coverage coverage(0x100);
+  for (u32 i = 0x10; i <= 0x12; ++i) {
+    coverage.markExecuted(i);
+    coverage.markRead(i);
+  }
+  coverage.markExecuted(0x20);
+  coverage.markRead(0x30);
+
+  std::stringstream ss;
+  coverage.writeJson(ss);
+  EXPECT_EQ(
+      "{\"rom_size\": 256, \"executed_count\": 4, \"read_count\": 4,\n"
+      " \"executed\": [[16, 18], [32, 32]],\n"
+      " \"read\": [[16, 18], [48, 48]],\n"
+      " \"data\": [[48, 48]]}\n",
+      ss.str());
+}
+
+}  // namespace gbeml
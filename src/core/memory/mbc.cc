@@ -6,7 +6,7 @@
 
 namespace gbeml {
 
-u8 RomOnly::readRom(const u16 addr) const { return rom.read(addr); }
+u8 RomOnly::readRom(const u16 addr) const { return readRomData(addr); }
 
 u8 RomOnly::readRam(const u16 addr) const {
   DCHECK(addr < ram.size());
@@ -20,18 +20,17 @@ void RomOnly::writeRom([[maybe_unused]] const u16 addr,
 
 void RomOnly::writeRam(const u16 addr, const u8 value) { ram[addr] = value; }
 
-u8 Mbc1::readRom(const u16 addr) const {
-  return rom.read(calcRomAddress(addr));
-}
+u32 RomOnly::getRomBank(const u16 addr) const { return addr / 0x4000; }
+
+u8 Mbc1::readRom(const u16 addr) const { return readRomData(addr); }
 
 u8 Mbc1::readRam(const u16 addr) const {
-  if (!enable_ram) {
+  if (ram_bank_ptr == nullptr) {
     DLOG(WARNING) << "Ram disabled." << std::endl;
     return 0x00;
   }
-  u64 ram_addr = calcRamAddress(addr);
-  DCHECK(ram_addr < ram.size());
-  return ram[ram_addr];
+  DCHECK(calcRamAddress(addr) < ram.size());
+  return ram_bank_ptr[addr];
 }
 
 void Mbc1::writeRom(const u16 addr, const u8 value) {
@@ -52,35 +51,43 @@ void Mbc1::writeRom(const u16 addr, const u8 value) {
       mode = BankingMode::SimpleRomBankingMode;
     }
   }
+  mapBanks();
 }
 
 void Mbc1::writeRam(const u16 addr, const u8 value) {
-  if (!enable_ram) {
+  if (ram_bank_ptr == nullptr) {
     DLOG(WARNING) << "Ram disabled." << std::endl;
     return;
   }
-  u64 ram_addr = calcRamAddress(addr);
-  DCHECK(ram_addr < ram.size());
-  ram[ram_addr] = value;
+  DCHECK(calcRamAddress(addr) < ram.size());
+  ram_bank_ptr[addr] = value;
 }
 
-u16 Mbc1::calcRomAddress(const u16 addr) const {
+u32 Mbc1::getRomBank(const u16 addr) const {
+  // The bank number wraps around the banks the rom has, so the upper bits
+  // only select banks on roms of 1 MiB or more.
   if (addr <= 0x3fff) {
-    if (mode == BankingMode::RamBankingMode && is_large_rom) {
-      u16 bank_number = static_cast<u16>(ram_bank_number << 5);
-      return 0x4000 * bank_number + addr;
+    if (mode == BankingMode::RamBankingMode) {
+      return (static_cast<u32>(ram_bank_number) << 5) % num_rom_banks;
     } else {
-      return addr;
+      return 0;
     }
   } else {
-    u16 bank_number = static_cast<u16>(ram_bank_number << 5) + rom_bank_number;
+    u32 bank_number =
+        (static_cast<u32>(ram_bank_number) << 5) + rom_bank_number;
     if (rom_bank_number == 0) {
       bank_number++;
     }
-    return 0x4000 * bank_number + addr - 0x4000;
+    return bank_number % num_rom_banks;
   }
 }
 
+void Mbc1::mapBanks() {
+  rom_bank0_ptr = rom.getBank(getRomBank(0x0000));
+  rom_bankn_ptr = rom.getBank(getRomBank(0x4000));
+  ram_bank_ptr = enable_ram ? ram.data() + calcRamAddress(0x0000) : nullptr;
+}
+
 u64 Mbc1::calcRamAddress(const u16 addr) const {
   u64 base = 0;
   if (mode == BankingMode::RamBankingMode && is_large_ram) {
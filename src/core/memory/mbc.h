@@ -1,6 +1,7 @@
 #ifndef GBEML_MBC_H_
 #define GBEML_MBC_H_
 
+#include <algorithm>
 #include <array>
 
 #include "core/memory/rom.h"
@@ -18,16 +19,42 @@ class Mbc {
   virtual u8 readRam(const u16 addr) const = 0;
   virtual void writeRom(const u16 addr, const u8 value) = 0;
   virtual void writeRam(const u16 addr, const u8 value) = 0;
+  // Returns the number of the rom bank mapped at addr.
+  virtual u32 getRomBank(const u16 addr) const = 0;
+  // Returns the rom bank mapped at addr for direct reads, or nullptr.
+  const u8* getRomData(const u16 addr) const {
+    return addr <= 0x3fff ? rom_bank0_ptr : rom_bankn_ptr;
+  }
+  // Returns the ram bank mapped from 0xa000 for direct access, or nullptr
+  // while the ram is disabled.
+  u8* getRamData() const { return ram_bank_ptr; }
+
+ protected:
+  // Set by implementations whenever a bank register or the banking mode
+  // changes.
+  const u8* rom_bank0_ptr = nullptr;
+  const u8* rom_bankn_ptr = nullptr;
+  u8* ram_bank_ptr = nullptr;
+
+  u8 readRomData(const u16 addr) const {
+    const u8* bank = getRomData(addr);
+    return bank != nullptr ? bank[addr & 0x3fff] : 0xff;
+  }
 };
 
 class RomOnly : public Mbc {
  public:
-  RomOnly(const Rom& rom_) : rom(rom_) {}
+  RomOnly(const Rom& rom_) : rom(rom_) {
+    rom_bank0_ptr = rom.getBank(0);
+    rom_bankn_ptr = rom.getBank(1);
+    ram_bank_ptr = ram.data();
+  }
 
   u8 readRom(const u16 addr) const override;
   u8 readRam(const u16 addr) const override;
   void writeRom(const u16 addr, const u8 value) override;
   void writeRam(const u16 addr, const u8 value) override;
+  u32 getRomBank(const u16 addr) const override;
 
  private:
   const Rom& rom;
@@ -36,31 +63,31 @@ class RomOnly : public Mbc {
 
 class Mbc1 : public Mbc {
  public:
-  Mbc1(const Rom& rom_) : rom(rom_) {
-    if (rom.getRomSize() >= (1 << 30)) {
-      is_large_rom = true;
-    }
+  Mbc1(const Rom& rom_)
+      : rom(rom_), num_rom_banks(std::max(rom.getRomSize() / 0x4000, 1u)) {
     if (rom.getRamSize() > 8 * 1024) {
       is_large_ram = true;
     }
+    mapBanks();
   }
 
   u8 readRom(const u16 addr) const override;
   u8 readRam(const u16 addr) const override;
   void writeRom(const u16 addr, const u8 value) override;
   void writeRam(const u16 addr, const u8 value) override;
+  u32 getRomBank(const u16 addr) const override;
 
  private:
-  u16 calcRomAddress(const u16 addr) const;
+  void mapBanks();
   u64 calcRamAddress(const u16 addr) const;
   const Rom& rom;
+  u32 num_rom_banks;
   std::array<u8, 128 * 1024> ram;
   bool enable_ram = false;
   u8 rom_bank_number = 1;
   u8 ram_bank_number = 0;
   BankingMode mode = BankingMode::SimpleRomBankingMode;
   bool is_large_ram = false;
-  bool is_large_rom = false;
 };
 
 }  // namespace gbeml
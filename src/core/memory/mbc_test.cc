@@ -0,0 +1,97 @@
+#include "core/memory/mbc.h"
+
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "core/memory/rom.h"
+#include "core/types/types.h"
+
+namespace gbeml {
+
+namespace {
+
+// A rom with the given size and cartridge type codes, whose bank n holds n at
+// offset 0x123.
+Rom makeRom(u8 type, u8 rom_size, u32 num_banks) {
+  std::vector<u8> data(0x4000 * num_banks);
+  data[0x147] = type;
+  data[0x148] = rom_size;
+  data[0x149] = 0x03;
+  for (u32 bank = 1; bank < num_banks; ++bank) {
+    data[0x4000 * bank + 0x123] = static_cast<u8>(bank);
+  }
+  Rom rom;
+  rom.load(data);
+  return rom;
+}
+
+}  // namespace
+
+TEST(MbcTest, romOnly) {
+  Rom rom = makeRom(0x00, 0x00, 2);
+  RomOnly mbc(rom);
+
+  EXPECT_EQ(1, mbc.readRom(0x4123));
+  EXPECT_EQ(rom.getBank(0), mbc.getRomData(0x0000));
+  EXPECT_EQ(rom.getBank(1), mbc.getRomData(0x7fff));
+  mbc.writeRam(0x0010, 7);
+  EXPECT_EQ(7, mbc.getRamData()[0x0010]);
+}
+
+TEST(MbcTest, mbc1_switchesRomBanks) {
+  Rom rom = makeRom(0x01, 0x01, 4);
+  Mbc1 mbc(rom);
+
+  EXPECT_EQ(1, mbc.readRom(0x4123));
+  mbc.writeRom(0x2000, 2);
+  EXPECT_EQ(2, mbc.readRom(0x4123));
+  EXPECT_EQ(rom.getBank(2), mbc.getRomData(0x4000));
+  mbc.writeRom(0x2000, 0);
+  EXPECT_EQ(1, mbc.readRom(0x4123));
+  // The bank number wraps around the 4 banks.
+  mbc.writeRom(0x2000, 7);
+  EXPECT_EQ(3, mbc.getRomBank(0x4000));
+  EXPECT_EQ(3, mbc.readRom(0x4123));
+  mbc.writeRom(0x4000, 1);
+  EXPECT_EQ(3, mbc.getRomBank(0x4000));
+  EXPECT_EQ(rom.getBank(0), mbc.getRomData(0x0000));
+}
+
+TEST(MbcTest, mbc1_largeRom) {
+  Rom rom = makeRom(0x01, 0x06, 128);
+  Mbc1 mbc(rom);
+
+  mbc.writeRom(0x4000, 1);
+  mbc.writeRom(0x2000, 2);
+  EXPECT_EQ(0x22, mbc.getRomBank(0x4000));
+  EXPECT_EQ(0x22, mbc.readRom(0x4123));
+  EXPECT_EQ(0, mbc.getRomBank(0x0000));
+  mbc.writeRom(0x6000, 1);
+  EXPECT_EQ(0x20, mbc.getRomBank(0x0000));
+  EXPECT_EQ(0x20, mbc.readRom(0x0123));
+}
+
+TEST(MbcTest, mbc1_switchesRamBanks) {
+  Rom rom = makeRom(0x03, 0x01, 4);
+  Mbc1 mbc(rom);
+
+  EXPECT_EQ(nullptr, mbc.getRamData());
+  mbc.writeRom(0x0000, 0x0a);
+  ASSERT_NE(nullptr, mbc.getRamData());
+  mbc.writeRam(0x0010, 7);
+  EXPECT_EQ(7, mbc.getRamData()[0x0010]);
+
+  mbc.writeRom(0x6000, 1);
+  mbc.writeRom(0x4000, 2);
+  mbc.writeRam(0x0010, 9);
+  EXPECT_EQ(9, mbc.readRam(0x0010));
+  mbc.writeRom(0x4000, 0);
+  EXPECT_EQ(7, mbc.readRam(0x0010));
+
+  mbc.writeRom(0x0000, 0x00);
+  EXPECT_EQ(nullptr, mbc.getRamData());
+  EXPECT_EQ(0, mbc.readRam(0x0010));
+}
+
+}  // namespace gbeml
@@ -10,6 +10,8 @@ class Ram {
   virtual ~Ram() {}
   virtual u8 read(u16 addr) const = 0;
   virtual void write(u16 addr, u8 value) = 0;
+  // Returns the memory for direct access, or nullptr if there is none.
+  virtual u8* getData() { return nullptr; }
 };
 
 }  // namespace gbeml
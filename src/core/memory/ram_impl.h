@@ -8,11 +8,12 @@
 
 namespace gbeml {
 
-class RamImpl : public Ram {
+class RamImpl final : public Ram {
  public:
   RamImpl(u32 size_) : size(size_) { data.resize(size); }
   virtual u8 read(u16 addr) const override;
   virtual void write(u16 addr, u8 value) override;
+  virtual u8* getData() override { return data.data(); }
 
  private:
   u32 size;
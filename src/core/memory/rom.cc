@@ -4,10 +4,11 @@
 
 #include <cassert>
 #include <fstream>
+#include <utility>
 
 namespace gbeml {
 
-u8 Rom::read(const u16 addr) const {
+u8 Rom::read(const u32 addr) const {
   if (addr >= data.size()) {
     DCHECK(false);
     return 0x00;
@@ -15,6 +16,13 @@ u8 Rom::read(const u16 addr) const {
   return data[addr];
 }
 
+const u8 *Rom::getBank(u32 bank) const {
+  if (0x4000 * (static_cast<u64>(bank) + 1) > data.size()) {
+    return nullptr;
+  }
+  return data.data() + 0x4000 * bank;
+}
+
 void Rom::load(const std::string &filename) {
   std::ifstream fin(filename, std::ios::in | std::ios::binary);
   if (!fin) {
@@ -33,6 +41,8 @@ void Rom::load(const std::string &filename) {
   fin.close();
 }
 
+void Rom::load(std::vector<u8> data_) { data = std::move(data_); }
+
 bool Rom::isValid() {
   if (data.size() < 336) {
     DCHECK(false);
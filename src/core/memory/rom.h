@@ -12,8 +12,12 @@ enum class CartridgeType { RomOnly, Mbc1 };
 
 class Rom {
  public:
-  u8 read(const u16 addr) const;
+  // Reads the byte at the offset in the rom file.
+  u8 read(const u32 addr) const;
+  // Returns the 16 KiB of the bank, or nullptr if the rom has no such bank.
+  const u8 *getBank(u32 bank) const;
   void load(const std::string &filename);
+  void load(std::vector<u8> data_);
   bool isValid();
   u32 getRomSize() const;
   u32 getRamSize() const;
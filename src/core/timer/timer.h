@@ -11,6 +11,14 @@ class Timer {
   virtual ~Timer() {}
 
   virtual void tick() = 0;
+  // Equivalent to calling tick() n times.
+  virtual void advance(u64 n) = 0;
+  // Lower bound on the number of tick() calls up to and including the next
+  // one that may signal an interrupt.
+  virtual u64 getCyclesUntilInterrupt() const = 0;
+  // Lower bound on the number of tick() calls up to and including the next
+  // one that may change DIV or TIMA.
+  virtual u64 getCyclesUntilRegisterChange() const = 0;
 
   virtual u8 readDivider() const = 0;
   virtual u8 readCounter() const = 0;
@@ -1,14 +1,74 @@
 #include "core/timer/timer_impl.h"
 
+#include <algorithm>
+
 #include "core/log/logging.h"
 
 namespace gbeml {
 
+void TimerImpl::registerIo(IoTable* io) {
+  io->add(0xff04, [this] { return readDivider(); },
+          [this](u8) { resetDivider(); });
+  io->add(0xff05, [this] { return readCounter(); },
+          [this](u8 value) { writeCounter(value); });
+  io->add(0xff06, [this] { return readModulo(); },
+          [this](u8 value) { writeModulo(value); });
+  io->add(0xff07, [this] { return readControl(); },
+          [this](u8 value) { writeControl(value); }, 0xf8);
+}
+
 void TimerImpl::tick() {
   tickDivider();
   tickCounter();
 }
 
+void TimerImpl::advance(u64 n) {
+  u64 increments = (div_cycles + n) / 256 - div_cycles / 256;
+  div_cycles += n;
+  div.set(div.get() + increments);
+
+  if (!tac.getAt(2)) {
+    return;
+  }
+  // Without an overflow the counter only needs its increments added. A
+  // pending reload signals on the next tick, so it is always ticked.
+  if (n < getCyclesUntilInterrupt()) {
+    u64 period = getCounterPeriod();
+    tima.set(static_cast<u8>(tima.get() + (tima_cycles + n) / period -
+                             tima_cycles / period));
+    tima_cycles += n;
+    return;
+  }
+  for (u64 i = 0; i < n; ++i) {
+    tickCounter();
+  }
+}
+
+u64 TimerImpl::getCyclesUntilInterrupt() const {
+  if (!tac.getAt(2)) {
+    return UINT64_MAX;
+  }
+  // A zero counter reloads and signals on every tick, which with a zero
+  // modulo repeats until the counter is written.
+  if (tima.get() == 0) {
+    return 1;
+  }
+  u64 period = getCounterPeriod();
+  return period - tima_cycles % period + (0xff - tima.get()) * period;
+}
+
+u64 TimerImpl::getCyclesUntilRegisterChange() const {
+  u64 divider = 256 - div_cycles % 256;
+  if (!tac.getAt(2)) {
+    return divider;
+  }
+  if (tima.get() == 0 && tma.get() != 0) {
+    return 1;
+  }
+  u64 period = getCounterPeriod();
+  return std::min(divider, period - tima_cycles % period);
+}
+
 void TimerImpl::tickDivider() {
   if (++div_cycles % 256 == 0) {
     div.increment();
@@ -21,30 +81,8 @@ void TimerImpl::tickCounter() {
   }
 
   tima_cycles++;
-  switch (tac.slice(0, 1)) {
-    case 0:
-      if (tima_cycles % 1024 == 0) {
-        tima.increment();
-      }
-      break;
-    case 1:
-      if (tima_cycles % 16 == 0) {
-        tima.increment();
-      }
-      break;
-    case 2:
-      if (tima_cycles % 64 == 0) {
-        tima.increment();
-      }
-      break;
-    case 3:
-      if (tima_cycles % 256 == 0) {
-        tima.increment();
-      }
-      break;
-    default:
-      DCHECK(false);
-      break;
+  if (tima_cycles % getCounterPeriod() == 0) {
+    tima.increment();
   }
 
   if (tima.get() == 0) {
@@ -53,6 +91,19 @@ void TimerImpl::tickCounter() {
   }
 }
 
+u64 TimerImpl::getCounterPeriod() const {
+  switch (tac.slice(0, 1)) {
+    case 0:
+      return 1024;
+    case 1:
+      return 16;
+    case 2:
+      return 64;
+    default:
+      return 256;
+  }
+}
+
 u8 TimerImpl::readDivider() const { return div.get(); }
 
 u8 TimerImpl::readCounter() const { return tima.get(); }
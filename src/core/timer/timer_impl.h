@@ -1,17 +1,21 @@
 #ifndef GBEML_TIMER_IMPL_H_
 #define GBEML_TIMER_IMPL_H_
 
+#include "core/bus/io_table.h"
 #include "core/interrupt/interrupt_controller.h"
 #include "core/timer/timer.h"
 
 namespace gbeml {
 
-class TimerImpl : public Timer {
+class TimerImpl final : public Timer {
  public:
   TimerImpl(InterruptController* ic_, u8 div_, u8 tima_, u8 tma_, u8 tac_)
       : ic(ic_), div(div_), tima(tima_), tma(tma_), tac(tac_) {}
 
   virtual void tick() override;
+  virtual void advance(u64 n) override;
+  virtual u64 getCyclesUntilInterrupt() const override;
+  virtual u64 getCyclesUntilRegisterChange() const override;
 
   virtual u8 readDivider() const override;
   virtual u8 readCounter() const override;
@@ -23,6 +27,9 @@ class TimerImpl : public Timer {
   virtual void writeModulo(u8 value) override;
   virtual void writeControl(u8 value) override;
 
+  // Adds DIV, TIMA, TMA and TAC.
+  void registerIo(IoTable* io);
+
   void tickDivider();
   void tickCounter();
 
@@ -35,6 +42,8 @@ class TimerImpl : public Timer {
 
   u64 div_cycles = 0;
   u64 tima_cycles = 0;
+
+  u64 getCounterPeriod() const;
 };
 
 }  // namespace gbeml
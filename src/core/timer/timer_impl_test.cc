@@ -137,4 +137,93 @@ TEST(TimerImplTest, tickCounterModulo) {
   EXPECT_EQ(0xfe, timer.readCounter());
 }
 
+TEST(TimerImplTest, advance_matchesTick) {
+  MockInterruptController ic;
+  EXPECT_CALL(ic, signalTimer()).Times(testing::AnyNumber());
+
+  TimerImpl ticked(&ic, 0, 0xf0, 0xf0, 0b00000101);
+  TimerImpl advanced(&ic, 0, 0xf0, 0xf0, 0b00000101);
+
+  for (u64 n = 1; n < 600; n += 7) {
+    for (u64 i = 0; i < n; ++i) {
+      ticked.tick();
+    }
+    advanced.advance(n);
+
+    EXPECT_EQ(ticked.readDivider(), advanced.readDivider());
+    EXPECT_EQ(ticked.readCounter(), advanced.readCounter());
+  }
+}
+
+TEST(TimerImplTest, advance_matchesTickAcrossOverflow) {
+  for (u8 tma : {0x00, 0xff}) {
+    MockInterruptController ticked_ic;
+    MockInterruptController advanced_ic;
+    u64 ticked_signals = 0;
+    u64 advanced_signals = 0;
+    EXPECT_CALL(ticked_ic, signalTimer())
+        .WillRepeatedly([&ticked_signals] { ticked_signals++; });
+    EXPECT_CALL(advanced_ic, signalTimer())
+        .WillRepeatedly([&advanced_signals] { advanced_signals++; });
+
+    TimerImpl ticked(&ticked_ic, 0, 0xfe, tma, 0b00000101);
+    TimerImpl advanced(&advanced_ic, 0, 0xfe, tma, 0b00000101);
+
+    for (u64 n = 1; n < 100; n += 7) {
+      for (u64 i = 0; i < n; ++i) {
+        ticked.tick();
+      }
+      advanced.advance(n);
+
+      EXPECT_EQ(ticked.readCounter(), advanced.readCounter())
+          << "tma " << static_cast<int>(tma) << ", n " << n;
+      EXPECT_EQ(ticked_signals, advanced_signals)
+          << "tma " << static_cast<int>(tma) << ", n " << n;
+    }
+    EXPECT_LT(0, advanced_signals);
+  }
+}
+
+TEST(TimerImplTest, getCyclesUntilInterrupt) {
+  for (u8 tac : {0b00000100, 0b00000101, 0b00000110, 0b00000111}) {
+    MockInterruptController ic;
+    TimerImpl timer(&ic, 0, 0xfd, 0xfd, tac);
+    timer.advance(5);
+
+    for (u8 i = 0; i < 3; ++i) {
+      u64 n = timer.getCyclesUntilInterrupt();
+      EXPECT_CALL(ic, signalTimer()).Times(0);
+      timer.advance(n - 1);
+      testing::Mock::VerifyAndClearExpectations(&ic);
+
+      EXPECT_CALL(ic, signalTimer()).Times(1);
+      timer.tick();
+      testing::Mock::VerifyAndClearExpectations(&ic);
+    }
+  }
+
+  MockInterruptController ic;
+  TimerImpl disabled(&ic, 0, 0, 0, 0b00000001);
+  EXPECT_EQ(UINT64_MAX, disabled.getCyclesUntilInterrupt());
+}
+
+TEST(TimerImplTest, getCyclesUntilRegisterChange) {
+  MockInterruptController ic;
+  EXPECT_CALL(ic, signalTimer()).Times(testing::AnyNumber());
+
+  for (u8 tac : {0b00000001, 0b00000100, 0b00000101}) {
+    TimerImpl timer(&ic, 0, 0, 0, tac);
+    for (u8 i = 0; i < 20; ++i) {
+      u64 n = timer.getCyclesUntilRegisterChange();
+      u8 div = timer.readDivider();
+      u8 tima = timer.readCounter();
+      timer.advance(n - 1);
+      EXPECT_EQ(div, timer.readDivider());
+      EXPECT_EQ(tima, timer.readCounter());
+      timer.tick();
+      EXPECT_TRUE(div != timer.readDivider() || tima != timer.readCounter());
+    }
+  }
+}
+
 }  // namespace gbeml
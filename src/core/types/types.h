@@ -15,7 +15,7 @@ typedef int16_t i16;
 typedef int32_t i32;
 typedef int64_t i64;
 
-u16 concat(u8 h, u8 l);
+constexpr u16 concat(u8 h, u8 l) { return static_cast<u16>(h << 8 | l); }
 
 }  // namespace gbeml
 
@@ -21,9 +21,7 @@ bool SdlWindow::init() {
 }
 
 void SdlWindow::runFrame() {
-  for (int i = 0; i < 70224; ++i) {
-    gb->tick();
-  }
+  gb->advance(70224);
 
   if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
 